@@ -0,0 +1,243 @@
+// ALU kernels. Each operation is written once and expanded for 8, 16 and 32 bits, so every instruction calls
+// the kernel for its own width and the flag code never has to switch on the operand size.
+// Kernels take the operands, update the CCR and return the result; the caller decides where it goes.
+// CMP is the exception, its flags are deferred until something looks at them (see fusion.c).
+
+#define REG8(n) (getRegRef8(n).ptr)
+#define REG16(n) (getRegRef16(n).ptr)
+#define REG32(n) (getRegRef32(n).ptr)
+
+// halfMask covers the bits below the half carry: bit 3, 11 and 27 for bytes, words and longs
+#define ALU_KERNELS(bits, signBit, halfMask) \
+static inline uint##bits##_t mov##bits(uint##bits##_t value){ /* Flags for MOV and the logic ops */ \
+	flags.N = value & signBit; \
+	flags.Z = value == 0; \
+	flags.V = 0; \
+	return value; \
+} \
+static inline uint##bits##_t add##bits(uint##bits##_t a, uint##bits##_t b){ \
+	uint##bits##_t result = a + b; \
+	flags.H = (uint32_t)(a & halfMask) + (b & halfMask) > halfMask; \
+	flags.N = result & signBit; \
+	flags.Z = result == 0; \
+	flags.V = ~(a ^ b) & (a ^ result) & signBit; /* Same sign operands, different sign result */ \
+	flags.C = result < a; \
+	return result; \
+} \
+static inline uint##bits##_t sub##bits(uint##bits##_t a, uint##bits##_t b){ \
+	uint##bits##_t result = a - b; \
+	flags.H = (b & halfMask) > (a & halfMask); \
+	flags.N = result & signBit; \
+	flags.Z = result == 0; \
+	flags.V = (a ^ b) & (a ^ result) & signBit; /* Different sign operands, result sign differs from a */ \
+	flags.C = b > a; \
+	return result; \
+} \
+static inline void cmp##bits(uint##bits##_t a, uint##bits##_t b){ /* SUB without the result, flags settled later */ \
+	deferredCompare = (struct DeferredCompare){bits, a, b}; \
+} \
+static inline uint##bits##_t inc##bits(uint##bits##_t a, uint##bits##_t amount){ /* INC and DEC leave H and C alone */ \
+	uint##bits##_t result = a + amount; \
+	flags.N = result & signBit; \
+	flags.Z = result == 0; \
+	flags.V = ~a & result & signBit; \
+	return result; \
+} \
+static inline uint##bits##_t dec##bits(uint##bits##_t a, uint##bits##_t amount){ \
+	uint##bits##_t result = a - amount; \
+	flags.N = result & signBit; \
+	flags.Z = result == 0; \
+	flags.V = a & ~result & signBit; \
+	return result; \
+} \
+static inline uint##bits##_t neg##bits(uint##bits##_t value){ \
+	return sub##bits(0, value); \
+} \
+static inline uint##bits##_t not##bits(uint##bits##_t value){ \
+	return mov##bits(~value); \
+} \
+static inline uint##bits##_t shll##bits(uint##bits##_t value){ \
+	uint##bits##_t result = mov##bits(value << 1); \
+	flags.C = value & signBit; \
+	return result; \
+} \
+static inline uint##bits##_t shal##bits(uint##bits##_t value){ /* Same as SHLL but V flags a sign change */ \
+	uint##bits##_t result = shll##bits(value); \
+	flags.V = (value ^ result) & signBit; \
+	return result; \
+} \
+static inline uint##bits##_t shlr##bits(uint##bits##_t value){ \
+	uint##bits##_t result = mov##bits(value >> 1); \
+	flags.C = value & 1; \
+	return result; \
+} \
+static inline uint##bits##_t shar##bits(uint##bits##_t value){ \
+	uint##bits##_t result = mov##bits((value >> 1) | (value & signBit)); \
+	flags.C = value & 1; \
+	return result; \
+} \
+static inline uint##bits##_t rotl##bits(uint##bits##_t value){ \
+	uint##bits##_t result = mov##bits((value << 1) | ((value & signBit) ? 1 : 0)); \
+	flags.C = value & signBit; \
+	return result; \
+} \
+static inline uint##bits##_t rotr##bits(uint##bits##_t value){ \
+	uint##bits##_t result = mov##bits((value >> 1) | ((value & 1) ? signBit : 0)); \
+	flags.C = value & 1; \
+	return result; \
+} \
+static inline uint##bits##_t rotxl##bits(uint##bits##_t value){ \
+	uint##bits##_t result = mov##bits((value << 1) | flags.C); \
+	flags.C = value & signBit; \
+	return result; \
+} \
+static inline uint##bits##_t rotxr##bits(uint##bits##_t value){ \
+	uint##bits##_t result = mov##bits((value >> 1) | (flags.C ? signBit : 0)); \
+	flags.C = value & 1; \
+	return result; \
+}
+
+ALU_KERNELS(8, 0x80, 0xF)
+ALU_KERNELS(16, 0x8000, 0xFFF)
+ALU_KERNELS(32, 0x80000000, 0xFFFFFFF)
+
+// Multiply and divide, Rs is bits wide and Rd twice that. MUL takes the low half of Rd, DIV divides all of it and leaves
+// the quotient in the low half and the remainder in the high half. MULXU leaves the flags alone, the others only set N
+// and Z, without branching: for DIV, Z is a zero divisor and N a negative divisor (DIVXU) or a negative quotient (DIVXS,
+// so -1 / 2 = 0 isn't negative, operands of different signs if the divisor is zero). A zero divisor leaves Rd as it
+// was. The host divides in 64 bits, so a quotient that doesn't fit (-0x8000 / -1, or anything over 0xFF for DIVXU.b)
+// gets cut down to its low bits instead of trapping.
+#define MULDIV_KERNELS(bits, wide) \
+static inline uint##wide##_t mulxu##bits(uint##wide##_t rd, uint##bits##_t rs){ \
+	return (uint##wide##_t)((uint##bits##_t)rd * (uint32_t)rs); \
+} \
+static inline uint##wide##_t mulxs##bits(uint##wide##_t rd, uint##bits##_t rs){ \
+	uint##wide##_t result = (uint##wide##_t)((int32_t)(int##bits##_t)rd * (int##bits##_t)rs); \
+	flags.N = result >> (wide - 1); \
+	flags.Z = result == 0; \
+	return result; \
+} \
+static inline uint##wide##_t divxu##bits(uint##wide##_t rd, uint##bits##_t rs){ \
+	uint64_t divisor = rs + (rs == 0); /* Anything but 0, the result is dropped then */ \
+	uint##wide##_t result = (uint##wide##_t)(((uint64_t)(uint##bits##_t)(rd % divisor) << bits) | (uint##bits##_t)(rd / divisor)); \
+	flags.N = rs >> (bits - 1); \
+	flags.Z = rs == 0; \
+	return rs ? result : rd; \
+} \
+static inline uint##wide##_t divxs##bits(uint##wide##_t rd, uint##bits##_t rs){ \
+	int64_t dividend = (int##wide##_t)rd; \
+	int64_t divisor = (int##bits##_t)rs + (rs == 0); \
+	uint##wide##_t result = (uint##wide##_t)(((uint64_t)(uint##bits##_t)(dividend % divisor) << bits) | (uint##bits##_t)(dividend / divisor)); \
+	flags.N = rs ? (uint##bits##_t)(dividend / divisor) >> (bits - 1) : (rd >> (wide - 1)) ^ (rs >> (bits - 1)); \
+	flags.Z = rs == 0; \
+	return rs ? result : rd; \
+}
+
+MULDIV_KERNELS(8, 16)
+MULDIV_KERNELS(16, 32)
+
+// Bit instructions. One kernel for all fourteen, on the byte and the bit number, it returns the byte with the bit
+// changed and sets C (or Z for BTST). The operation is always a constant, so each use folds down to its own case.
+// The ones that change the byte come first, the rest only read it.
+enum BitOp{
+	BIT_SET, BIT_NOT, BIT_CLR, BIT_ST, BIT_IST, // Write the byte back
+	BIT_TST, BIT_LD, BIT_ILD, BIT_AND, BIT_IAND, BIT_OR, BIT_IOR, BIT_XOR, BIT_IXOR
+};
+
+static inline uint8_t bitOp(enum BitOp op, uint8_t value, int bit){
+	bool set = (value >> bit) & 1;
+	uint8_t mask = 1 << bit;
+	switch(op){
+		case BIT_SET: return value | mask;
+		case BIT_NOT: return value ^ mask;
+		case BIT_CLR: return value & ~mask;
+		case BIT_ST: return (value & ~mask) | (flags.C << bit);
+		case BIT_IST: return (value & ~mask) | (!flags.C << bit);
+		case BIT_TST: flags.Z = !set; break;
+		case BIT_LD: flags.C = set; break;
+		case BIT_ILD: flags.C = !set; break;
+		case BIT_AND: flags.C = flags.C & set; break;
+		case BIT_IAND: flags.C = flags.C & !set; break;
+		case BIT_OR: flags.C = flags.C | set; break;
+		case BIT_IOR: flags.C = flags.C | !set; break;
+		case BIT_XOR: flags.C = flags.C ^ set; break;
+		case BIT_IXOR: flags.C = flags.C ^ !set; break;
+	}
+	return value;
+}
+
+// @ERd and @aa:8, one read and, for the ones that change the byte, one write
+static inline void bitOpMemory(enum BitOp op, uint32_t address, int bit){
+	uint8_t value = getMemory8(address);
+	if (op <= BIT_IST){
+		setMemory8(address, bitOp(op, value, bit));
+	} else{
+		bitOp(op, value, bit);
+	}
+}
+
+// Works out the flags a deferred CMP would have set
+void settleFlags(){
+	struct DeferredCompare compare = deferredCompare;
+	deferredCompare.bits = 0;
+	switch(compare.bits){
+		case 8:{ sub8(compare.a, compare.b); }break;
+		case 16:{ sub16(compare.a, compare.b); }break;
+		case 32:{ sub32(compare.a, compare.b); }break;
+	}
+}
+
+// Interpreter cases, expanded once per width inside the dispatch switch.
+// W is the width suffix of the instruction ids, the other arguments are the nibbles / immediate holding the operands.
+#define ARITHMETIC_CASES(W, bits, rs, rd) \
+	case OP_ADD_##W##_R_R:{ *REG##bits(rd) = add##bits(*REG##bits(rd), *REG##bits(rs)); }break; \
+	case OP_SUB_##W##_R_R:{ *REG##bits(rd) = sub##bits(*REG##bits(rd), *REG##bits(rs)); }break; \
+	case OP_CMP_##W##_R_R:{ cmp##bits(*REG##bits(rd), *REG##bits(rs)); }break; \
+	case OP_MOV_##W##_R_R:{ *REG##bits(rd) = mov##bits(*REG##bits(rs)); }break;
+
+#define LOGIC_CASES(W, bits, rs, rd) \
+	case OP_AND_##W##_R_R:{ *REG##bits(rd) = mov##bits(*REG##bits(rd) & *REG##bits(rs)); }break; \
+	case OP_OR_##W##_R_R:{ *REG##bits(rd) = mov##bits(*REG##bits(rd) | *REG##bits(rs)); }break; \
+	case OP_XOR_##W##_R_R:{ *REG##bits(rd) = mov##bits(*REG##bits(rd) ^ *REG##bits(rs)); }break;
+
+#define IMMEDIATE_CASES(W, bits, rd, imm) \
+	case OP_MOV_##W##_IMM:{ *REG##bits(rd) = mov##bits(imm); }break; \
+	case OP_ADD_##W##_IMM:{ *REG##bits(rd) = add##bits(*REG##bits(rd), imm); }break; \
+	case OP_CMP_##W##_IMM:{ cmp##bits(*REG##bits(rd), imm); }break; \
+	case OP_AND_##W##_IMM:{ *REG##bits(rd) = mov##bits(*REG##bits(rd) & imm); }break; \
+	case OP_OR_##W##_IMM:{ *REG##bits(rd) = mov##bits(*REG##bits(rd) | imm); }break; \
+	case OP_XOR_##W##_IMM:{ *REG##bits(rd) = mov##bits(*REG##bits(rd) ^ imm); }break;
+
+// rs and rd are for MULXU / DIVXU, srs and srd for MULXS / DIVXS, which have a prefix word
+#define MULDIV_CASES(W, bits, wide, rs, rd, srs, srd) \
+	case OP_MULXU_##W:{ *REG##wide(rd) = mulxu##bits(*REG##wide(rd), *REG##bits(rs)); }break; \
+	case OP_MULXS_##W:{ *REG##wide(srd) = mulxs##bits(*REG##wide(srd), *REG##bits(srs)); }break; \
+	case OP_DIVXU_##W:{ *REG##wide(rd) = divxu##bits(*REG##wide(rd), *REG##bits(rs)); }break; \
+	case OP_DIVXS_##W:{ *REG##wide(srd) = divxs##bits(*REG##wide(srd), *REG##bits(srs)); }break;
+
+// Bit instructions, for each of the three places the byte can be. BSET, BNOT, BCLR and BTST take the bit number from
+// a register too, the others only as an immediate (its top bit is the I of BIST, BILD... and already in the id).
+#define BIT_CASES(OP, op) \
+	case OP_##OP##_R:{ *REG8(bL) = bitOp(op, *REG8(bL), bH & 7); }break; \
+	case OP_##OP##_IND:{ bitOpMemory(op, *REG32(bH), dH & 7); }break; \
+	case OP_##OP##_ABS8:{ bitOpMemory(op, 0x00FFFF00 | b, dH & 7); }break;
+
+#define BIT_REGISTER_CASES(OP, op) \
+	case OP_##OP##_IMM_R:{ *REG8(bL) = bitOp(op, *REG8(bL), bH & 7); }break; \
+	case OP_##OP##_R_R:{ *REG8(bL) = bitOp(op, *REG8(bL), *REG8(bH) & 7); }break; \
+	case OP_##OP##_IMM_IND:{ bitOpMemory(op, *REG32(bH), dH & 7); }break; \
+	case OP_##OP##_R_IND:{ bitOpMemory(op, *REG32(bH), *REG8(dH) & 7); }break; \
+	case OP_##OP##_IMM_ABS8:{ bitOpMemory(op, 0x00FFFF00 | b, dH & 7); }break; \
+	case OP_##OP##_R_ABS8:{ bitOpMemory(op, 0x00FFFF00 | b, *REG8(dH) & 7); }break;
+
+#define UNARY_CASES(W, bits, rd) \
+	case OP_SHLL_##W:{ *REG##bits(rd) = shll##bits(*REG##bits(rd)); }break; \
+	case OP_SHAL_##W:{ *REG##bits(rd) = shal##bits(*REG##bits(rd)); }break; \
+	case OP_SHLR_##W:{ *REG##bits(rd) = shlr##bits(*REG##bits(rd)); }break; \
+	case OP_SHAR_##W:{ *REG##bits(rd) = shar##bits(*REG##bits(rd)); }break; \
+	case OP_ROTL_##W:{ *REG##bits(rd) = rotl##bits(*REG##bits(rd)); }break; \
+	case OP_ROTR_##W:{ *REG##bits(rd) = rotr##bits(*REG##bits(rd)); }break; \
+	case OP_ROTXL_##W:{ *REG##bits(rd) = rotxl##bits(*REG##bits(rd)); }break; \
+	case OP_ROTXR_##W:{ *REG##bits(rd) = rotxr##bits(*REG##bits(rd)); }break; \
+	case OP_NOT_##W:{ *REG##bits(rd) = not##bits(*REG##bits(rd)); }break; \
+	case OP_NEG_##W:{ *REG##bits(rd) = neg##bits(*REG##bits(rd)); }break;
@@ -0,0 +1,472 @@
+// Ahead of time translation. -X file.c walks the ROM's control flow from the entry point and the interrupt vectors and
+// writes it out as C, one label per basic block, all in one function. Building with -DAOT_SOURCE=\"file.c\" (cl /O2 or
+// gcc -O3) compiles it in, and runs with the same image and -q then go through it instead of the dispatch loop.
+//
+// The common instructions (register and immediate ALU ops, bit ops, MOV to and from @ERn, @aa:8, @aa:16 and
+// @(d:16, ERn), branches, BSR / JSR / JMP to fixed addresses and RTS) become straight C on the same kernels, memory
+// layer and devices the interpreter uses. Everything else is handed to executeInstruction with pc set, so nothing has
+// to be translated to work. Computed jumps (@@aa, RTS, RTE) and anything that lands outside the translated code go back
+// through a switch on pc, and code that was never found by the walk runs on the interpreter until it gets back.
+// JMP / JSR @ERn (function pointer tables, state machines) each get an inline cache instead: the last target and the
+// block it starts, so as long as the register holds the same value it costs a compare more than a direct branch.
+// Events are checked after every instruction as usual (one compare), so inputs, devices, interrupts and limits behave
+// the same and a run ends with the same state hash as an interpreted one.
+//
+// Stop addresses and breakpoints are only seen when control goes back through the switch, on a breakpoint, a watchpoint
+// or a pause the interpreter takes over for the rest of the run. A translation only runs on the image it was made from.
+//
+// Code that gets written over while it runs (self modifying, or a RAM copy) is kept right through the page bitmap in
+// main.c: the pages with translated code on them send writes down the slow path, which marks the blocks holding that
+// byte stale. A stale block goes back to the interpreter for good, every other block stays translated. Stores to any
+// other page don't pay anything for it.
+
+#define AOT_VECTORS 48 // Vector table entries to start walking from, besides the entry point
+
+// C for the instructions translated inline. Placeholders: %aL %bH %bL %dH %dL register nibbles, %b %cd %cdef
+// immediates, %A8 / %A16 absolute addresses and %D16 a displacement. These mirror the interpreter cases in main.c.
+struct AotTemplate{
+	enum InstructionId id;
+	const char* code;
+	bool memory; // Touches memory, the devices and watchpoints get a look afterwards
+};
+
+#define AOT_ARITHMETIC(W, bits, rs, rd) \
+	{OP_ADD_##W##_R_R, "*REG" #bits "(" rd ") = add" #bits "(*REG" #bits "(" rd "), *REG" #bits "(" rs "));"}, \
+	{OP_SUB_##W##_R_R, "*REG" #bits "(" rd ") = sub" #bits "(*REG" #bits "(" rd "), *REG" #bits "(" rs "));"}, \
+	{OP_CMP_##W##_R_R, "sub" #bits "(*REG" #bits "(" rd "), *REG" #bits "(" rs "));"}, \
+	{OP_MOV_##W##_R_R, "*REG" #bits "(" rd ") = mov" #bits "(*REG" #bits "(" rs "));"},
+
+#define AOT_LOGIC(W, bits, rs, rd) \
+	{OP_AND_##W##_R_R, "*REG" #bits "(" rd ") = mov" #bits "(*REG" #bits "(" rd ") & *REG" #bits "(" rs "));"}, \
+	{OP_OR_##W##_R_R, "*REG" #bits "(" rd ") = mov" #bits "(*REG" #bits "(" rd ") | *REG" #bits "(" rs "));"}, \
+	{OP_XOR_##W##_R_R, "*REG" #bits "(" rd ") = mov" #bits "(*REG" #bits "(" rd ") ^ *REG" #bits "(" rs "));"},
+
+#define AOT_IMMEDIATE(W, bits, rd, imm) \
+	{OP_MOV_##W##_IMM, "*REG" #bits "(" rd ") = mov" #bits "(" imm ");"}, \
+	{OP_ADD_##W##_IMM, "*REG" #bits "(" rd ") = add" #bits "(*REG" #bits "(" rd "), " imm ");"}, \
+	{OP_CMP_##W##_IMM, "sub" #bits "(*REG" #bits "(" rd "), " imm ");"}, \
+	{OP_AND_##W##_IMM, "*REG" #bits "(" rd ") = mov" #bits "(*REG" #bits "(" rd ") & " imm ");"}, \
+	{OP_OR_##W##_IMM, "*REG" #bits "(" rd ") = mov" #bits "(*REG" #bits "(" rd ") | " imm ");"}, \
+	{OP_XOR_##W##_IMM, "*REG" #bits "(" rd ") = mov" #bits "(*REG" #bits "(" rd ") ^ " imm ");"},
+
+#define AOT_UNARY(W, bits, rd) \
+	{OP_SHLL_##W, "*REG" #bits "(" rd ") = shll" #bits "(*REG" #bits "(" rd "));"}, \
+	{OP_SHAL_##W, "*REG" #bits "(" rd ") = shal" #bits "(*REG" #bits "(" rd "));"}, \
+	{OP_SHLR_##W, "*REG" #bits "(" rd ") = shlr" #bits "(*REG" #bits "(" rd "));"}, \
+	{OP_SHAR_##W, "*REG" #bits "(" rd ") = shar" #bits "(*REG" #bits "(" rd "));"}, \
+	{OP_ROTL_##W, "*REG" #bits "(" rd ") = rotl" #bits "(*REG" #bits "(" rd "));"}, \
+	{OP_ROTR_##W, "*REG" #bits "(" rd ") = rotr" #bits "(*REG" #bits "(" rd "));"}, \
+	{OP_ROTXL_##W, "*REG" #bits "(" rd ") = rotxl" #bits "(*REG" #bits "(" rd "));"}, \
+	{OP_ROTXR_##W, "*REG" #bits "(" rd ") = rotxr" #bits "(*REG" #bits "(" rd "));"}, \
+	{OP_NOT_##W, "*REG" #bits "(" rd ") = not" #bits "(*REG" #bits "(" rd "));"}, \
+	{OP_NEG_##W, "*REG" #bits "(" rd ") = neg" #bits "(*REG" #bits "(" rd "));"},
+
+#define AOT_BITS(OP, op) \
+	{OP_##OP##_R, "*REG8(%bL) = bitOp(" #op ", *REG8(%bL), %bH & 7);"}, \
+	{OP_##OP##_IND, "bitOpMemory(" #op ", *REG32(%bH), %dH & 7);", true}, \
+	{OP_##OP##_ABS8, "bitOpMemory(" #op ", %A8, %dH & 7);", true},
+
+#define AOT_REGISTER_BITS(OP, op) \
+	{OP_##OP##_IMM_R, "*REG8(%bL) = bitOp(" #op ", *REG8(%bL), %bH & 7);"}, \
+	{OP_##OP##_R_R, "*REG8(%bL) = bitOp(" #op ", *REG8(%bL), *REG8(%bH) & 7);"}, \
+	{OP_##OP##_IMM_IND, "bitOpMemory(" #op ", *REG32(%bH), %dH & 7);", true}, \
+	{OP_##OP##_R_IND, "bitOpMemory(" #op ", *REG32(%bH), *REG8(%dH) & 7);", true}, \
+	{OP_##OP##_IMM_ABS8, "bitOpMemory(" #op ", %A8, %dH & 7);", true}, \
+	{OP_##OP##_R_ABS8, "bitOpMemory(" #op ", %A8, *REG8(%dH) & 7);", true},
+
+static const struct AotTemplate aotTemplates[] = {
+	{OP_NOP, ""},
+	AOT_ARITHMETIC(B, 8, "%bH", "%bL")
+	AOT_ARITHMETIC(W, 16, "%bH", "%bL")
+	AOT_ARITHMETIC(L, 32, "%bH", "%bL")
+	AOT_LOGIC(B, 8, "%bH", "%bL")
+	AOT_LOGIC(W, 16, "%bH", "%bL")
+	AOT_LOGIC(L, 32, "%dH", "%dL")
+	AOT_IMMEDIATE(B, 8, "%aL", "%b")
+	AOT_IMMEDIATE(W, 16, "%bL", "%cd")
+	AOT_IMMEDIATE(L, 32, "%bL", "%cdef")
+	AOT_UNARY(B, 8, "%bL")
+	AOT_UNARY(W, 16, "%bL")
+	AOT_UNARY(L, 32, "%bL")
+	AOT_REGISTER_BITS(BSET, BIT_SET)
+	AOT_REGISTER_BITS(BNOT, BIT_NOT)
+	AOT_REGISTER_BITS(BCLR, BIT_CLR)
+	AOT_REGISTER_BITS(BTST, BIT_TST)
+	AOT_BITS(BST, BIT_ST)
+	AOT_BITS(BIST, BIT_IST)
+	AOT_BITS(BLD, BIT_LD)
+	AOT_BITS(BILD, BIT_ILD)
+	AOT_BITS(BAND, BIT_AND)
+	AOT_BITS(BIAND, BIT_IAND)
+	AOT_BITS(BOR, BIT_OR)
+	AOT_BITS(BIOR, BIT_IOR)
+	AOT_BITS(BXOR, BIT_XOR)
+	AOT_BITS(BIXOR, BIT_IXOR)
+	{OP_SUB_W_IMM, "*REG16(%bL) = sub16(*REG16(%bL), %cd);"},
+	{OP_SUB_L_IMM, "*REG32(%bL) = sub32(*REG32(%bL), %cdef);"},
+	{OP_INC_B, "*REG8(%bL) = inc8(*REG8(%bL), 1);"},
+	{OP_INC_W_1, "*REG16(%bL) = inc16(*REG16(%bL), 1);"},
+	{OP_INC_W_2, "*REG16(%bL) = inc16(*REG16(%bL), 2);"},
+	{OP_INC_L_1, "*REG32(%bL) = inc32(*REG32(%bL), 1);"},
+	{OP_INC_L_2, "*REG32(%bL) = inc32(*REG32(%bL), 2);"},
+	{OP_DEC_B, "*REG8(%bL) = dec8(*REG8(%bL), 1);"},
+	{OP_DEC_W_1, "*REG16(%bL) = dec16(*REG16(%bL), 1);"},
+	{OP_DEC_W_2, "*REG16(%bL) = dec16(*REG16(%bL), 2);"},
+	{OP_DEC_L_1, "*REG32(%bL) = dec32(*REG32(%bL), 1);"},
+	{OP_DEC_L_2, "*REG32(%bL) = dec32(*REG32(%bL), 2);"},
+	{OP_EXTU_W, "*REG16(%bL) = mov16(*REG16(%bL) & 0xFF);"},
+	{OP_EXTU_L, "*REG32(%bL) = mov32(*REG32(%bL) & 0xFFFF);"},
+	{OP_EXTS_W, "*REG16(%bL) = mov16((int8_t)*REG16(%bL));"},
+	{OP_EXTS_L, "*REG32(%bL) = mov32((int16_t)*REG32(%bL));"},
+	{OP_MULXU_B, "*REG16(%bL) = mulxu8(*REG16(%bL), *REG8(%bH));"},
+	{OP_MULXU_W, "*REG32(%bL) = mulxu16(*REG32(%bL), *REG16(%bH));"},
+	{OP_MULXS_B, "*REG16(%dL) = mulxs8(*REG16(%dL), *REG8(%dH));"},
+	{OP_MULXS_W, "*REG32(%dL) = mulxs16(*REG32(%dL), *REG16(%dH));"},
+	{OP_DIVXU_B, "*REG16(%bL) = divxu8(*REG16(%bL), *REG8(%bH));"},
+	{OP_DIVXU_W, "*REG32(%bL) = divxu16(*REG32(%bL), *REG16(%bH));"},
+	{OP_DIVXS_B, "*REG16(%dL) = divxs8(*REG16(%dL), *REG8(%dH));"},
+	{OP_DIVXS_W, "*REG32(%dL) = divxs16(*REG32(%dL), *REG16(%dH));"},
+	{OP_ADDS_1, "*REG32(%bL) += 1;"},
+	{OP_ADDS_2, "*REG32(%bL) += 2;"},
+	{OP_ADDS_4, "*REG32(%bL) += 4;"},
+	{OP_SUBS_1, "*REG32(%bL) -= 1;"},
+	{OP_SUBS_2, "*REG32(%bL) -= 2;"},
+	{OP_SUBS_4, "*REG32(%bL) -= 4;"},
+	{OP_MOV_B_ABS8_R, "*REG8(%aL) = mov8(getMemory8(%A8));", true},
+	{OP_MOV_B_R_ABS8, "setMemory8(%A8, mov8(*REG8(%aL)));", true},
+	{OP_MOV_B_ABS16_R, "*REG8(%bL) = mov8(getMemory8(%A16));", true},
+	{OP_MOV_B_R_ABS16, "setMemory8(%A16, mov8(*REG8(%bL)));", true},
+	{OP_MOV_W_ABS16_R, "*REG16(%bL) = mov16(getMemory16(%A16));", true},
+	{OP_MOV_W_R_ABS16, "setMemory16(%A16, mov16(*REG16(%bL)));", true},
+	{OP_MOV_B_IND_R, "*REG8(%bL) = mov8(getMemory8(*REG32(%bH)));", true},
+	{OP_MOV_B_R_IND, "setMemory8(*REG32(%bH), mov8(*REG8(%bL)));", true},
+	{OP_MOV_W_IND_R, "*REG16(%bL) = mov16(getMemory16(*REG32(%bH)));", true},
+	{OP_MOV_W_R_IND, "setMemory16(*REG32(%bH), mov16(*REG16(%bL)));", true},
+	{OP_MOV_L_IND_R, "*REG32(%dL) = mov32(getMemory32(*REG32(%dH)));", true},
+	{OP_MOV_L_R_IND, "setMemory32(*REG32(%dH), mov32(*REG32(%dL)));", true},
+	{OP_MOV_B_DISP16_R, "*REG8(%bL) = mov8(getMemory8(*REG32(%bH) + %D16));", true},
+	{OP_MOV_B_R_DISP16, "setMemory8(*REG32(%bH) + %D16, mov8(*REG8(%bL)));", true},
+	{OP_MOV_W_DISP16_R, "*REG16(%bL) = mov16(getMemory16(*REG32(%bH) + %D16));", true},
+	{OP_MOV_W_R_DISP16, "setMemory16(*REG32(%bH) + %D16, mov16(*REG16(%bL)));", true},
+};
+
+// Writes a template out with its placeholders filled in from the instruction bytes
+void emitTemplate(FILE* out, const char* code, const uint8_t* bytes){
+	uint16_t cd = (bytes[2] << 8) | bytes[3];
+	uint32_t cdef = ((uint32_t)cd << 16) | (bytes[4] << 8) | bytes[5];
+	while(*code){
+		if (*code != '%'){
+			fputc(*code++, out);
+			continue;
+		}
+		code++;
+		if (strncmp(code, "aL", 2) == 0){ fprintf(out, "%d", bytes[0] & 0xF); code += 2; }
+		else if (strncmp(code, "bH", 2) == 0){ fprintf(out, "%d", bytes[1] >> 4); code += 2; }
+		else if (strncmp(code, "bL", 2) == 0){ fprintf(out, "%d", bytes[1] & 0xF); code += 2; }
+		else if (strncmp(code, "dH", 2) == 0){ fprintf(out, "%d", bytes[3] >> 4); code += 2; }
+		else if (strncmp(code, "dL", 2) == 0){ fprintf(out, "%d", bytes[3] & 0xF); code += 2; }
+		else if (strncmp(code, "cdef", 4) == 0){ fprintf(out, "0x%08Xu", cdef); code += 4; }
+		else if (strncmp(code, "cd", 2) == 0){ fprintf(out, "0x%04X", cd); code += 2; }
+		else if (strncmp(code, "A16", 3) == 0){ fprintf(out, "0x%06X", (int16_t)cd & ADDRESS_MASK); code += 3; }
+		else if (strncmp(code, "A8", 2) == 0){ fprintf(out, "0x%06X", 0x00FFFF00 | bytes[1]); code += 2; }
+		else if (strncmp(code, "D16", 3) == 0){ fprintf(out, "(%d)", (int16_t)cd); code += 3; }
+		else if (*code == 'b'){ fprintf(out, "0x%02X", bytes[1]); code += 1; }
+	}
+}
+
+// Inline cache of a JMP / JSR @ERn, the last target it went to and the number of the block that starts there
+struct AotSite{
+	uint32_t target; // 0xFFFFFFFF until it's been through once, pc never gets there
+	int block;
+};
+
+// Where control goes after the instruction at at, found while walking
+struct AotFlow{
+	bool ends; // Nothing runs straight after it
+	bool fallsThrough; // The next instruction is reached (also as the return point of a call)
+	bool hasTarget;
+	uint32_t target;
+};
+
+struct AotFlow aotFlow(enum InstructionId id, uint32_t at, const uint8_t* bytes){
+	uint32_t next = at + instructionTable[id].length;
+	switch(id){
+		case OP_BRA_8:
+			return (struct AotFlow){true, false, true, (next + (int8_t)bytes[1]) & ADDRESS_MASK};
+		case OP_BRA_16:
+			return (struct AotFlow){true, false, true, (next + (int16_t)((bytes[2] << 8) | bytes[3])) & ADDRESS_MASK};
+		case OP_JMP_ABS24:
+			return (struct AotFlow){true, false, true, ((bytes[1] << 16) | (bytes[2] << 8) | bytes[3]) & ADDRESS_MASK};
+		case OP_BSR_8:
+			return (struct AotFlow){true, true, true, (next + (int8_t)bytes[1]) & ADDRESS_MASK};
+		case OP_BSR_16:
+			return (struct AotFlow){true, true, true, (next + (int16_t)((bytes[2] << 8) | bytes[3])) & ADDRESS_MASK};
+		case OP_JSR_ABS24:
+			return (struct AotFlow){true, true, true, ((bytes[1] << 16) | (bytes[2] << 8) | bytes[3]) & ADDRESS_MASK};
+		case OP_JSR_IND:
+		case OP_JSR_MEM_IND:
+		case OP_TRAPA:
+		case OP_SLEEP:
+			return (struct AotFlow){true, true};
+		case OP_RTS:
+		case OP_RTE:
+		case OP_JMP_IND:
+		case OP_JMP_MEM_IND:
+		case OP_UNKNOWN:
+			return (struct AotFlow){true, false};
+		default:
+			break;
+	}
+	if (id >= OP_BRA_8 && id <= OP_BLE_8){
+		return (struct AotFlow){false, true, true, (next + (int8_t)bytes[1]) & ADDRESS_MASK};
+	}
+	if (id >= OP_BRA_16 && id <= OP_BLE_16){
+		return (struct AotFlow){false, true, true, (next + (int16_t)((bytes[2] << 8) | bytes[3])) & ADDRESS_MASK};
+	}
+	return (struct AotFlow){false, true};
+}
+
+void emitAotJump(FILE* out, const uint8_t* leaders, int size, uint32_t target){
+	if (target < size && leaders[target]){
+		fprintf(out, "goto L_%04x;", target);
+	} else{
+		fprintf(out, "pc = 0x%04x; goto dispatch;", target);
+	}
+}
+
+// Returns false if the file can't be written
+bool translateRom(const uint8_t* image, int size, uint32_t entry, const char* romPath, const char* outPath){
+	FILE* out = fopen(outPath, "w");
+	if (!out){
+		return false;
+	}
+	const struct AotTemplate* templates[INSTRUCTION_COUNT] = {0};
+	for(int i = 0; i < sizeof(aotTemplates) / sizeof(aotTemplates[0]); i++){
+		templates[aotTemplates[i].id] = &aotTemplates[i];
+	}
+
+	// Walk: every address a block starts at is a leader, every instruction found on the way is marked as code
+	uint8_t* leaders = calloc(size, 1);
+	uint8_t* code = calloc(size, 1);
+	uint32_t* work = malloc((size + AOT_VECTORS + 1) * sizeof(uint32_t));
+	int workCount = 0;
+	work[workCount++] = entry;
+	for(int i = 0; i < AOT_VECTORS && i * 2 + 1 < size; i++){
+		work[workCount++] = (image[i * 2] << 8) | image[i * 2 + 1];
+	}
+	while(workCount){
+		uint32_t at = work[--workCount];
+		if (at >= size || (at & 1) || leaders[at]){
+			continue;
+		}
+		leaders[at] = 1;
+		if (code[at]){
+			continue; // Inside a block we've already been through, splitting it is all there is to do
+		}
+		while(at + 2 <= size){
+			enum InstructionId id = decodeInstruction(image + at);
+			if (at + instructionTable[id].length > size){
+				break;
+			}
+			code[at] = 1;
+			struct AotFlow flow = aotFlow(id, at, image + at);
+			if (flow.hasTarget && flow.target < size && !leaders[flow.target]){
+				work[workCount++] = flow.target;
+			}
+			uint32_t next = at + instructionTable[id].length;
+			if (flow.ends){
+				if (flow.fallsThrough && next < size && !leaders[next]){
+					work[workCount++] = next;
+				}
+				break;
+			}
+			at = next;
+			if (at < size && code[at]){
+				leaders[at] = 1; // Ran into code we've already been through, it starts a block of its own
+				break;
+			}
+		}
+	}
+
+	int siteCount = 0;
+	int leaderCount = 0;
+	for(uint32_t at = 0; at < size; at++){
+		enum InstructionId id = code[at] ? decodeInstruction(image + at) : OP_UNKNOWN;
+		siteCount += id == OP_JMP_IND || id == OP_JSR_IND;
+		leaderCount += leaders[at];
+	}
+	uint32_t* blockStarts = malloc((leaderCount + 1) * sizeof(uint32_t));
+	uint32_t* blockEnds = malloc((leaderCount + 1) * sizeof(uint32_t));
+
+	uint64_t hash = hashBytes(0xCBF29CE484222325ull, image, size);
+	fprintf(out, "// Translated from %s by poke -X, see aot.c. Only runs on an image with hash %016llx.\n", romPath, (unsigned long long)hash);
+	fprintf(out, "static const uint64_t aotImageHash = 0x%016llxull;\n", (unsigned long long)hash);
+	fprintf(out, "static struct AotSite aotSites[%d] = {", siteCount ? siteCount : 1);
+	for(int site = 0; site < siteCount || site == 0; site++){
+		fprintf(out, site ? ", {0xFFFFFFFF}" : "{0xFFFFFFFF}");
+	}
+	fprintf(out, "};\n");
+	fprintf(out, "static bool aotStale[%d];\n\n", leaderCount ? leaderCount : 1);
+	fprintf(out, "void runTranslated(){\n\tint block;\n\tint missedSite = -1;\n\tgoto dispatch;\n");
+	int sites = 0;
+	int blockCount = 0;
+	int translated = 0;
+	int interpreted = 0;
+	for(uint32_t leader = 0; leader < size; leader++){
+		if (!leaders[leader]){
+			continue;
+		}
+		fprintf(out, "L_%04x:\n\tAOT_BLOCK(%d, 0x%04x)\n", leader, blockCount, leader);
+		blockStarts[blockCount] = leader;
+		uint32_t at = leader;
+		while(true){
+			enum InstructionId id = decodeInstruction(image + at);
+			const uint8_t* bytes = image + at;
+			uint32_t next = at + instructionTable[id].length;
+			int states = instructionTable[id].states;
+			struct AotFlow flow = aotFlow(id, at, bytes);
+			char text[64];
+			disassembleInstruction(at, bytes, text);
+			fprintf(out, "\t// %04x %s\n\t", at, text);
+			if (templates[id]){
+				emitTemplate(out, templates[id]->code, bytes);
+				fprintf(out, templates[id]->code[0] ? " %s(%d, 0x%04x)\n" : "%s(%d, 0x%04x)\n", templates[id]->memory ? "AOT_MEMORY" : "AOT_STEP", states, next);
+				translated++;
+			} else if (flow.hasTarget && !flow.ends){ // Bcc
+				uint8_t condition = (id <= OP_BLE_8) ? (bytes[0] & 0xF) : (bytes[1] >> 4);
+				fprintf(out, "if (testCondition(%d)){ AOT_STEP(%d, 0x%04x) ", condition, states, flow.target);
+				emitAotJump(out, leaders, size, flow.target);
+				fprintf(out, " }\n\tAOT_STEP(%d, 0x%04x)\n", states, next);
+				translated++;
+			} else if (flow.hasTarget){ // BRA, JMP, BSR, JSR to a fixed address
+				if (flow.fallsThrough){
+					fprintf(out, "*SP -= 2; setMemory16(*SP, 0x%04x); ", next);
+				}
+				fprintf(out, "%s(%d, 0x%04x) ", flow.fallsThrough ? "AOT_MEMORY" : "AOT_STEP", states, flow.target);
+				emitAotJump(out, leaders, size, flow.target);
+				fprintf(out, "\n");
+				translated++;
+			} else if (id == OP_JMP_IND){
+				fprintf(out, "pc = *REG32(%d) & ADDRESS_MASK; AOT_STEP(%d, pc) AOT_INDIRECT(%d)\n", bytes[1] >> 4, states, sites++);
+				translated++;
+			} else if (id == OP_JSR_IND){
+				fprintf(out, "*SP -= 2; setMemory16(*SP, 0x%04x); pc = *REG32(%d) & ADDRESS_MASK; AOT_MEMORY(%d, pc) AOT_INDIRECT(%d)\n", next, bytes[1] >> 4, states, sites++);
+				translated++;
+			} else if (id == OP_RTS){
+				fprintf(out, "pc = getMemory16(*SP); *SP += 2; AOT_COUNT(%d) goto dispatch;\n", states);
+				translated++;
+			} else{
+				fprintf(out, "AOT_INTERPRET(0x%04x, 0x%04x)\n", at, next);
+				interpreted++;
+			}
+			if (flow.ends){
+				if (!flow.hasTarget && id != OP_RTS && id != OP_JMP_IND && id != OP_JSR_IND){
+					fprintf(out, "\tgoto dispatch;\n"); // pc is wherever the instruction left it
+				}
+				blockEnds[blockCount++] = next;
+				break;
+			}
+			at = next;
+			if (at >= size || !code[at] || leaders[at]){
+				fprintf(out, "\t");
+				emitAotJump(out, leaders, size, at);
+				fprintf(out, "\n");
+				blockEnds[blockCount++] = at;
+				break;
+			}
+		}
+	}
+	// pc to block number, then block number to label: a miss fills the cache from the first, a hit goes to the second
+	fprintf(out, "dispatch:\n\tAOT_DISPATCH()\n\tswitch(pc){\n");
+	for(uint32_t leader = 0, number = 0; leader < size; leader++){
+		if (leaders[leader]){
+			fprintf(out, "\t\tcase 0x%04x: block = %d; break;\n", leader, number++);
+		}
+	}
+	fprintf(out, "\t\tdefault: goto interpret;\n\t}\n");
+	fprintf(out, "\tif (aotStale[block]){\n\t\tgoto interpret;\n\t}\n");
+	fprintf(out, "\tif (missedSite >= 0){\n\t\taotSites[missedSite] = (struct AotSite){pc, block};\n\t\tmissedSite = -1;\n\t}\n");
+	fprintf(out, siteCount ? "jump:\n\tswitch(block){\n" : "\tswitch(block){\n"); // Only the cached sites jump here
+	for(uint32_t leader = 0, number = 0; leader < size; leader++){
+		if (leaders[leader]){
+			fprintf(out, "\t\tcase %d: goto L_%04x;\n", number++, leader);
+		}
+	}
+	fprintf(out, "\t}\ninterpret:\n\tmissedSite = -1;\n\texecuteInstruction(); // Not translated or stale, one instruction at a time until we're back\n");
+	fprintf(out, "\tsettleFlags();\n\tgoto dispatch;\n}\n\n");
+	fprintf(out, "static const int aotBlockCount = %d;\n", blockCount);
+	fprintf(out, "static const uint32_t aotBlocks[%d][2] = { // Start and end, for codeWritten\n", blockCount ? blockCount : 1);
+	for(int number = 0; number < blockCount; number++){
+		fprintf(out, "\t{0x%04x, 0x%04x},\n", blockStarts[number], blockEnds[number]);
+	}
+	fprintf(out, blockCount ? "};\n" : "\t{0, 0}\n};\n");
+	fclose(out);
+	printf("AOT - %d blocks, %d instructions translated, %d left to the interpreter, %d indirect jumps cached, written to %s\n", blockCount, translated, interpreted, siteCount, outPath);
+	free(leaders);
+	free(code);
+	free(work);
+	free(blockStarts);
+	free(blockEnds);
+	return true;
+}
+
+// Runtime side, used by the translated code. That keeps the flags up to date as it goes, so a CMP the interpreter
+// deferred gets settled as soon as the interpreter is done
+#define AOT_COUNT(states) cycles += states; instructions++;
+#define AOT_STEP(states, next) AOT_COUNT(states) if (cycles >= nextEventCycle){ pc = next; goto dispatch; }
+#define AOT_MEMORY(states, next) serviceSSU(); AOT_COUNT(states) if (cycles >= nextEventCycle || mode != RUN){ pc = next; goto dispatch; }
+// Nothing can have come due since the AOT_STEP / AOT_MEMORY before it, so a miss finds the same pc at dispatch
+#define AOT_INDIRECT(site) if (pc == aotSites[site].target){ block = aotSites[site].block; goto jump; } missedSite = site; goto dispatch;
+#define AOT_BLOCK(block, at) if (aotStale[block]){ pc = at; goto interpret; }
+#define AOT_INTERPRET(at, next) pc = at; executeInstruction(); settleFlags(); if (pc != next || cycles >= nextEventCycle || mode != RUN || stopReason){ goto dispatch; }
+#define AOT_DISPATCH() \
+	if (cycles >= nextEventCycle){ \
+		serviceEvents(); \
+		serviceSSU(); /* Inputs may have moved something it looks at, the next instruction might not call it */ \
+	} \
+	if (stopReason || mode != RUN || testBit(breakpoints, pc)){ \
+		return; /* The dispatch loop in main carries on from here */ \
+	}
+
+#ifdef AOT_SOURCE
+#include AOT_SOURCE
+#endif
+
+// Called from setMemory8Slow on a write to a page with translated code on it, with the 16 bit address. Blocks are
+// sorted and don't overlap, so the one holding the byte is the last one starting at or before it.
+void codeWritten(uint32_t address){
+#ifdef AOT_SOURCE
+	int low = 0;
+	int high = aotBlockCount - 1;
+	while(low < high){
+		int middle = (low + high + 1) / 2;
+		if (aotBlocks[middle][0] <= address){
+			low = middle;
+		} else{
+			high = middle - 1;
+		}
+	}
+	if (aotBlockCount && aotBlocks[low][0] <= address && address < aotBlocks[low][1] && !aotStale[low]){
+		aotStale[low] = true;
+		nextEventCycle = 0; // Out of the translated code at its next check, it might be in that block
+	}
+#endif
+}
+
+// Runs the translation compiled in, if there's one for this image, until the run stops or something needs the
+// interpreter. Does nothing otherwise.
+void runAheadOfTime(const uint8_t* image, int size){
+#ifdef AOT_SOURCE
+	if (trace || historyRing || coveredPcs || mode != RUN){
+		return;
+	}
+	if (hashBytes(0xCBF29CE484222325ull, image, size) != aotImageHash){
+		printf("AOT - the translation compiled in is for another image, interpreting\n");
+		return;
+	}
+	for(int block = 0; block < aotBlockCount; block++){
+		addCodePages(aotBlocks[block][0], aotBlocks[block][1]);
+	}
+	runTranslated();
+#endif
+}
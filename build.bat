@@ -1 +1,2 @@
 cl -Zi  main.c 
+cl -Zi -LD -DPOKE_BUILD -Felibpoke.dll libpoke.c
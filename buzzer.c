@@ -0,0 +1,168 @@
+// Buzzer. The speaker hangs off a Timer W output in PWM mode (FTIOB, C or D, the first one set up for PWM).
+// Nothing looks at it per instruction: a write to the timer registers works out the waveform, and every edge after
+// that is an event on the scheduler, placed at the state the compare match happens on.
+// -A file.wav renders it to 16 bit mono PCM. Each sample is the average output level over the states it spans (a box
+// filter, so the harmonics of the square wave don't fold back into the audible range) and goes through a DC blocker.
+// Samples are written in chunks as they're made and the header is rewritten after each one, so a run that gets killed
+// still leaves a valid file. Audio follows state time, a run faster than real time just gets the file sooner.
+// The timer isn't modelled at all without -A, and audio isn't rewound with the rest of the machine.
+
+#define AUDIO_RATE 44100
+#define AUDIO_CHUNK 4096 // Samples
+#define AUDIO_AMPLITUDE 12000
+
+// Timer W registers
+#define TMRW 0xF0F0 // Mode: CTS (counter start) in bit 7, PWMD / PWMC / PWMB in bits 2 - 0
+#define TCRW 0xF0F1 // Control: CCLR (clear on GRA match) in bit 7, clock select in bits 6 - 4
+#define TCNT 0xF0F6
+#define GRA 0xF0F8 // GRB, GRC and GRD follow
+#define TIMER_W_REGISTERS 16
+
+static FILE* audioFile;
+static int16_t audioChunk[AUDIO_CHUNK];
+static int audioChunkCount;
+static uint32_t audioSamples; // Written to the file so far
+static uint64_t audioCycle; // Rendered up to this state
+static uint64_t audioSampleIndex; // The sample being put together
+static uint64_t audioSampleHigh; // States the output was high for in that sample
+static double audioFilterIn;
+static double audioFilterOut;
+
+// The waveform the last register write set up. Edges are tracked as counts, buzzerBase being the count at buzzerStart.
+static bool buzzerLevel;
+static uint64_t buzzerStart;
+static uint64_t buzzerBase;
+static uint32_t buzzerPrescale;
+static uint32_t buzzerPeriod;
+static uint32_t buzzerHigh; // The output goes high at this count and low again when the period ends
+static uint64_t buzzerEdgeCount;
+static uint64_t nextBuzzerEdge = UINT64_MAX;
+
+void putLittleEndian(uint8_t* out, uint32_t value, int bytes){
+	for(int i = 0; i < bytes; i++){
+		out[i] = value >> (i * 8);
+	}
+}
+
+void writeWavHeader(){
+	uint8_t header[44];
+	memcpy(header, "RIFF", 4);
+	putLittleEndian(header + 4, 36 + audioSamples * 2, 4);
+	memcpy(header + 8, "WAVEfmt ", 8);
+	putLittleEndian(header + 16, 16, 4); // Format chunk size
+	putLittleEndian(header + 20, 1, 2); // PCM
+	putLittleEndian(header + 22, 1, 2); // Mono
+	putLittleEndian(header + 24, AUDIO_RATE, 4);
+	putLittleEndian(header + 28, AUDIO_RATE * 2, 4); // Bytes per second
+	putLittleEndian(header + 32, 2, 2); // Bytes per frame
+	putLittleEndian(header + 34, 16, 2); // Bits per sample
+	memcpy(header + 36, "data", 4);
+	putLittleEndian(header + 40, audioSamples * 2, 4);
+	fseek(audioFile, 0, SEEK_SET);
+	fwrite(header, 1, sizeof(header), audioFile);
+	fseek(audioFile, 0, SEEK_END);
+}
+
+void flushAudio(){
+	uint8_t bytes[AUDIO_CHUNK * 2];
+	for(int i = 0; i < audioChunkCount; i++){
+		putLittleEndian(bytes + i * 2, (uint16_t)audioChunk[i], 2);
+	}
+	fwrite(bytes, 2, audioChunkCount, audioFile);
+	audioSamples += audioChunkCount;
+	audioChunkCount = 0;
+	writeWavHeader();
+	fflush(audioFile);
+}
+
+uint64_t audioSampleStart(uint64_t index){
+	return index * STATES_PER_SECOND / AUDIO_RATE;
+}
+
+// Renders the output level up to the given state
+void renderAudio(uint64_t to){
+	while(audioFile && audioCycle < to){
+		uint64_t end = audioSampleStart(audioSampleIndex + 1);
+		uint64_t until = (to < end) ? to : end;
+		if (buzzerLevel){
+			audioSampleHigh += until - audioCycle;
+		}
+		audioCycle = until;
+		if (until == end){
+			double level = (double)audioSampleHigh / (end - audioSampleStart(audioSampleIndex));
+			audioFilterOut = level - audioFilterIn + 0.995 * audioFilterOut; // DC blocker
+			audioFilterIn = level;
+			audioChunk[audioChunkCount++] = (int16_t)(audioFilterOut * AUDIO_AMPLITUDE);
+			if (audioChunkCount == AUDIO_CHUNK){
+				flushAudio();
+			}
+			audioSampleIndex++;
+			audioSampleHigh = 0;
+		}
+	}
+}
+
+uint64_t buzzerEdgeCycle(uint64_t count){
+	return buzzerStart + (count - buzzerBase) * buzzerPrescale;
+}
+
+// Called on any write to the Timer W registers
+void updateBuzzer(uint16_t address){
+	renderAudio(cycles);
+	uint32_t count = (memory[TCNT] << 8) | memory[TCNT + 1];
+	if (nextBuzzerEdge != UINT64_MAX && address != TCNT && address != TCNT + 1){
+		count = (buzzerBase + (cycles - buzzerStart) / buzzerPrescale) % buzzerPeriod; // Keeps counting where it was
+	}
+	nextBuzzerEdge = UINT64_MAX;
+
+	uint8_t mode = memory[TMRW];
+	uint8_t control = memory[TCRW];
+	int clockSelect = (control >> 4) & 0x7;
+	int channel = (mode & 0x1) ? 1 : (mode & 0x2) ? 2 : (mode & 0x4) ? 3 : 0;
+	if (!(mode & 0x80) || clockSelect >= 4 || !channel){
+		return; // Stopped, on an external clock or not driving a PWM output, the pin stays where it is
+	}
+	buzzerPrescale = 1 << clockSelect;
+	buzzerPeriod = (control & 0x80) ? ((memory[GRA] << 8) | memory[GRA + 1]) + 1 : 0x10000;
+	buzzerHigh = (memory[GRA + channel * 2] << 8) | memory[GRA + channel * 2 + 1];
+	count = count % buzzerPeriod;
+	if (buzzerHigh == 0 || buzzerHigh >= buzzerPeriod){
+		buzzerLevel = buzzerHigh == 0; // 100% or 0% duty, no edges
+		return;
+	}
+	buzzerStart = cycles;
+	buzzerBase = count;
+	buzzerLevel = count >= buzzerHigh;
+	buzzerEdgeCount = (count < buzzerHigh) ? buzzerHigh : buzzerPeriod;
+	nextBuzzerEdge = buzzerEdgeCycle(buzzerEdgeCount);
+	scheduleAtCycle(nextBuzzerEdge);
+}
+
+// Called from serviceEvents, there can be several edges per instruction for high notes
+void serviceBuzzer(){
+	while(nextBuzzerEdge <= cycles){
+		renderAudio(nextBuzzerEdge);
+		buzzerLevel = (buzzerEdgeCount % buzzerPeriod) == buzzerHigh;
+		buzzerEdgeCount += buzzerLevel ? buzzerPeriod - buzzerHigh : buzzerHigh;
+		nextBuzzerEdge = buzzerEdgeCycle(buzzerEdgeCount);
+	}
+}
+
+bool startAudio(const char* path){
+	audioFile = fopen(path, "wb");
+	if (!audioFile){
+		return false;
+	}
+	writeWavHeader();
+	addDeviceRegisters(TMRW, TIMER_W_REGISTERS);
+	return true;
+}
+
+void stopAudio(){
+	if (audioFile){
+		renderAudio(cycles);
+		flushAudio();
+		fclose(audioFile);
+		audioFile = NULL;
+	}
+}
@@ -0,0 +1,254 @@
+// Control console. A thread of its own reads commands from stdin and posts them to a single producer / single consumer
+// ring, the emulator picks them up between instructions: every CONSOLE_POLL_STATES states while running (it's one more
+// deadline in nextEventCycle, the dispatch loop doesn't pay anything for it) or right away while stopped in STEP mode.
+// Stopped, or asleep with nothing else that could wake the CPU, the emulator blocks until the console thread signals.
+// A sleep that something else ends doesn't wait for the console at all, it's looked at again once that comes around.
+//   <n>: run n instructions and stop, a negative n goes back instead (see rewind.c)
+//   c: continue, p: pause, r: registers, i: instruction and state counts, m addr [count]: dump memory
+//   b addr / d addr: add / delete a breakpoint, k button 1 / k button 0: press / release a button (0 enter, 1 left,
+//   2 right), w seconds: move the real time clock forward (0 for the next midnight), q: quit
+// Buttons and warps go through inputWrite like any other input, so they get recorded.
+// Once stdin runs out STEP mode just continues, so batch runs that hit a breakpoint don't hang waiting for input.
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#define consoleLoad(p) InterlockedCompareExchange((volatile LONG*)(p), 0, 0)
+#define consoleStore(p, v) InterlockedExchange((volatile LONG*)(p), (v))
+#define consoleSleep() Sleep(1)
+#else
+#include <pthread.h>
+#include <time.h>
+#define consoleLoad(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define consoleStore(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define consoleSleep() nanosleep(&(struct timespec){0, 1000000}, NULL)
+#endif
+
+#define CONSOLE_QUEUE_SIZE 64 // Power of two
+#define CONSOLE_POLL_STATES (1 << 16)
+
+struct ConsoleCommand{
+	char kind; // 'n' for a step count, otherwise the command letter
+	int64_t value;
+	uint32_t address;
+	uint32_t count;
+};
+
+static struct ConsoleCommand consoleQueue[CONSOLE_QUEUE_SIZE];
+static volatile int32_t consoleHead; // Only written by the console thread
+static volatile int32_t consoleTail; // Only written by the emulator
+static volatile int32_t consoleClosed; // Nothing more is coming
+static bool consoleRunning;
+static uint64_t nextConsolePoll = UINT64_MAX;
+#ifdef _WIN32
+static HANDLE consoleEvent; // Auto reset
+#else
+static pthread_mutex_t consoleMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t consoleCondition = PTHREAD_COND_INITIALIZER;
+static bool consoleSignaled;
+#endif
+
+// Console thread side, wakes up the emulator if it's blocked in waitForConsoleSignal
+void signalConsole(){
+#ifdef _WIN32
+	SetEvent(consoleEvent);
+#else
+	pthread_mutex_lock(&consoleMutex);
+	consoleSignaled = true;
+	pthread_cond_signal(&consoleCondition);
+	pthread_mutex_unlock(&consoleMutex);
+#endif
+}
+
+// Emulator side, blocks until the console thread posted a command or ran out of input since the last call
+void waitForConsoleSignal(){
+#ifdef _WIN32
+	WaitForSingleObject(consoleEvent, INFINITE);
+#else
+	pthread_mutex_lock(&consoleMutex);
+	while(!consoleSignaled){
+		pthread_cond_wait(&consoleCondition, &consoleMutex);
+	}
+	consoleSignaled = false;
+	pthread_mutex_unlock(&consoleMutex);
+#endif
+}
+
+// Console thread side
+void postConsoleCommand(struct ConsoleCommand command){
+	int32_t head = consoleHead;
+	while(head - consoleLoad(&consoleTail) == CONSOLE_QUEUE_SIZE){
+		consoleSleep(); // Full, the emulator is busy with something
+	}
+	consoleQueue[head & (CONSOLE_QUEUE_SIZE - 1)] = command;
+	consoleStore(&consoleHead, head + 1);
+	signalConsole();
+}
+
+bool parseConsoleLine(const char* line, struct ConsoleCommand* command){
+	while(*line == ' ' || *line == '\t'){
+		line++;
+	}
+	char* end;
+	*command = (struct ConsoleCommand){'n', strtoll(line, &end, 0)};
+	if (end != line){
+		return true;
+	}
+	if (!*line || !strchr("cprimbdqkw", *line) || !strchr(" \t\r\n", line[1])){
+		return false;
+	}
+	command->kind = *line;
+	while(*line && *line != ' '){
+		line++;
+	}
+	command->address = strtoul(line, &end, 0);
+	command->count = strtoul(end, NULL, 0);
+	return true;
+}
+
+#ifdef _WIN32
+DWORD WINAPI consoleThread(LPVOID unused){
+#else
+void* consoleThread(void* unused){
+#endif
+	char line[256];
+	while(fgets(line, sizeof(line), stdin)){
+		struct ConsoleCommand command;
+		if (parseConsoleLine(line, &command)){
+			postConsoleCommand(command);
+		} else if (line[strspn(line, " \t\r\n")]){
+			printf("CONSOLE - unknown command %s", line);
+		}
+	}
+	consoleStore(&consoleClosed, 1);
+	signalConsole();
+	return 0;
+}
+
+void startConsole(){
+#ifdef _WIN32
+	consoleEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	consoleRunning = CreateThread(NULL, 0, consoleThread, NULL, 0, NULL) != NULL;
+#else
+	pthread_t thread;
+	consoleRunning = pthread_create(&thread, NULL, consoleThread, NULL) == 0;
+	if (consoleRunning){
+		pthread_detach(thread);
+	}
+#endif
+	nextConsolePoll = consoleRunning ? 0 : UINT64_MAX;
+}
+
+// Emulator side
+bool takeConsoleCommand(struct ConsoleCommand* command){
+	int32_t tail = consoleTail;
+	if (consoleLoad(&consoleHead) == tail){
+		return false;
+	}
+	*command = consoleQueue[tail & (CONSOLE_QUEUE_SIZE - 1)];
+	consoleStore(&consoleTail, tail + 1);
+	return true;
+}
+
+// Returns true if the command sets the emulator going again
+bool runConsoleCommand(struct ConsoleCommand* command){
+	bool debuggerAttached = mode == GDB_RUN || mode == GDB_STEP;
+	switch(command->kind){
+		case 'n':{
+			if (debuggerAttached){
+				break;
+			}
+			if (command->value >= 0){
+				mode = STEP;
+				instructionsToStep = command->value;
+				return true;
+			}
+			if (rewindBy(-command->value)){
+				instructionsToStep = 1; // Running forward in RUN mode, serviceRewind stops us at the target
+				return true;
+			}
+		}break;
+		case 'c':{
+			if (!debuggerAttached){
+				mode = RUN;
+				return true;
+			}
+		}break;
+		case 'p':{
+			if (!debuggerAttached && mode == RUN){
+				printf("PAUSE - 0x%04x after %llu instructions\n", pc, (unsigned long long)instructions);
+				printRegistersState();
+				mode = STEP;
+				instructionsToStep = 0;
+			}
+		}break;
+		case 'r':{
+			printf("0x%04x - ", pc);
+			printRegistersState();
+		}break;
+		case 'i':{
+			printf("0x%04x - %llu instructions, %llu states\n", pc, (unsigned long long)instructions, (unsigned long long)cycles);
+		}break;
+		case 'm':{
+			uint32_t count = command->count ? command->count : 16;
+			for(uint32_t i = 0; i < count; i++){
+				if (i % 16 == 0){
+					printf("%s%06x:", i ? "\n" : "", (command->address + i) & ADDRESS_MASK);
+				}
+				printf(" %02x", peekMemory8(command->address + i));
+			}
+			printf("\n");
+		}break;
+		case 'b':{
+			addBreakpoint(command->address);
+		}break;
+		case 'd':{
+			removeBreakpoint(command->address);
+			addStopBreakpoints();
+		}break;
+		case 'k':{
+			inputWrite(INPUT_BUTTON, command->address, command->count != 0);
+		}break;
+		case 'w':{
+			inputRtcWarp(command->address);
+		}break;
+		case 'q':{
+			stopReason = "quit";
+			return true;
+		}break;
+	}
+	return false;
+}
+
+// Called from serviceEvents
+void serviceConsole(){
+	if (!consoleRunning || (cycles < nextConsolePoll && nextConsolePoll - cycles <= CONSOLE_POLL_STATES)){
+		return; // Not due yet, unless a rewind took us back past the last poll
+	}
+	struct ConsoleCommand command;
+	while(takeConsoleCommand(&command)){
+		runConsoleCommand(&command);
+	}
+	nextConsolePoll = cycles + CONSOLE_POLL_STATES;
+}
+
+// Stopped in STEP mode, blocks until a command gets things going again
+void waitForConsole(){
+	if (!consoleRunning){
+		mode = RUN;
+		return;
+	}
+	struct ConsoleCommand command;
+	while(true){
+		if (takeConsoleCommand(&command)){
+			if (runConsoleCommand(&command)){
+				return;
+			}
+		} else if (consoleLoad(&consoleClosed)){
+			mode = RUN;
+			return;
+		} else{
+			waitForConsoleSignal();
+		}
+	}
+}
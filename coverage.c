@@ -0,0 +1,130 @@
+// Coverage, -C file. Records which addresses ran an instruction, which way every Bcc went and how often each handler
+// ran, then writes that out when the run stops, with the hits on handlers the interpreter doesn't implement yet (the
+// ones that end up in the default case) listed first on the console. That's the to do list, ordered by what the ROM
+// actually needs. Off by default, it's one branch per instruction while it's off.
+// The translated code is off while it's on, it would skip the recording.
+
+static uint8_t* coveredPcs; // NULL while it's off
+static uint8_t* takenBranches;
+static uint8_t* passedBranches; // Fell through
+static uint64_t handlerHits[INSTRUCTION_COUNT];
+static uint64_t unimplementedHits[INSTRUCTION_COUNT];
+static const char* coveragePath;
+
+static const char* instructionNames[INSTRUCTION_COUNT] = {
+#define INSTRUCTION(id, format, length, states, value, mask, value2, mask2) #id,
+#include "instructions.h"
+#undef INSTRUCTION
+	"UNKNOWN"
+};
+
+void enableCoverage(const char* path){
+	coveredPcs = calloc(ADDRESS_SPACE / 8, 1);
+	takenBranches = calloc(ADDRESS_SPACE / 8, 1);
+	passedBranches = calloc(ADDRESS_SPACE / 8, 1);
+	coveragePath = path;
+}
+
+// Called by executeInstruction after the instruction ran, with from the pc it ran at
+void recordCoverage(enum InstructionId id, uint32_t from, uint32_t to){
+	// Only store when the bit is new, hot loops would otherwise keep writing the same few bytes back to back
+	if (!testBit(coveredPcs, from)){
+		setBit(coveredPcs, from);
+	}
+	handlerHits[id]++;
+	if ((id >= OP_BRA_8 && id <= OP_BLE_8) || (id >= OP_BRA_16 && id <= OP_BLE_16)){
+		uint8_t* directions = (to == ((from + instructionTable[id].length) & ADDRESS_MASK)) ? passedBranches : takenBranches;
+		if (!testBit(directions, from)){
+			setBit(directions, from);
+		}
+	}
+}
+
+static uint64_t* sortedHits; // For compareHits, qsort has no context argument
+
+int compareHits(const void* a, const void* b){
+	uint64_t hitsA = sortedHits[*(const int*)a];
+	uint64_t hitsB = sortedHits[*(const int*)b];
+	return (hitsA < hitsB) - (hitsA > hitsB); // Most first
+}
+
+// Handler ids with hits, most first, returns how many
+int sortHandlers(uint64_t* hits, int* ids){
+	int count = 0;
+	for(int id = 0; id < INSTRUCTION_COUNT; id++){
+		if (hits[id]){
+			ids[count++] = id;
+		}
+	}
+	sortedHits = hits;
+	qsort(ids, count, sizeof(int), compareHits);
+	return count;
+}
+
+void writeCoverageReport(const char* romPath){
+	FILE* out = fopen(coveragePath, "w");
+	if (!out){
+		printf("Can't write coverage report %s\n", coveragePath);
+		return;
+	}
+	fprintf(out, "# Coverage of %s, %llu instructions, %llu states\n", romPath, (unsigned long long)instructions, (unsigned long long)cycles);
+
+	// Runs of instructions that all ran, back to back
+	fprintf(out, "# Code that ran, from - to (exclusive)\n");
+	uint64_t addresses = 0;
+	uint32_t rangeStart = 0;
+	uint32_t rangeEnd = 0;
+	for(uint32_t at = 0; at < ADDRESS_SPACE; at++){
+		if (!coveredPcs[at >> 3]){
+			at |= 7;
+			continue;
+		}
+		if (!testBit(coveredPcs, at)){
+			continue;
+		}
+		addresses++;
+		if (at > rangeEnd || !rangeEnd){
+			if (rangeEnd){
+				fprintf(out, "0x%06x - 0x%06x\n", rangeStart, rangeEnd);
+			}
+			rangeStart = at;
+		}
+		uint32_t end = at + instructionTable[decodeInstruction(backingMemory(at, true))].length;
+		rangeEnd = (end > rangeEnd) ? end : rangeEnd; // Code that ran at two alignments overlaps
+	}
+	if (rangeEnd){
+		fprintf(out, "0x%06x - 0x%06x\n", rangeStart, rangeEnd);
+	}
+
+	fprintf(out, "# Branches, and which ways they went\n");
+	uint64_t branches = 0;
+	uint64_t bothWays = 0;
+	for(uint32_t at = 0; at < ADDRESS_SPACE; at++){
+		if (!takenBranches[at >> 3] && !passedBranches[at >> 3]){
+			at |= 7;
+			continue;
+		}
+		bool taken = testBit(takenBranches, at);
+		bool passed = testBit(passedBranches, at);
+		if (taken || passed){
+			branches++;
+			bothWays += taken && passed;
+			fprintf(out, "0x%06x%s%s\n", at, taken ? " taken" : "", passed ? " fell-through" : "");
+		}
+	}
+
+	fprintf(out, "# Handlers, most hits first\n");
+	int ids[INSTRUCTION_COUNT];
+	int handlers = sortHandlers(handlerHits, ids);
+	for(int i = 0; i < handlers; i++){
+		fprintf(out, "%-16s %llu%s\n", instructionNames[ids[i]], (unsigned long long)handlerHits[ids[i]], unimplementedHits[ids[i]] ? " unimplemented" : "");
+	}
+	fclose(out);
+
+	int unimplemented = sortHandlers(unimplementedHits, ids);
+	printf("COVERAGE - %llu addresses ran, %llu branches (%llu both ways), %d handlers, %d of them unimplemented, report in %s\n",
+		(unsigned long long)addresses, (unsigned long long)branches, (unsigned long long)bothWays, handlers, unimplemented, coveragePath);
+	for(int i = 0; i < unimplemented; i++){
+		printf("  %-16s %llu hits\n", instructionNames[ids[i]], (unsigned long long)unimplementedHits[ids[i]]);
+	}
+}
@@ -0,0 +1,118 @@
+// Instruction decoder and disassembler, both generated from instructions.h.
+// The interpreter decodes with the same table, so what gets listed is always what gets executed.
+
+struct InstructionInfo{
+	const char* format;
+	uint8_t length; // In bytes
+	uint8_t states;
+	uint32_t value;
+	uint32_t mask;
+	uint32_t value2;
+	uint32_t mask2;
+};
+
+enum InstructionId{
+#define INSTRUCTION(id, format, length, states, value, mask, value2, mask2) OP_##id,
+#include "instructions.h"
+#undef INSTRUCTION
+	OP_UNKNOWN,
+	INSTRUCTION_COUNT
+};
+
+static const struct InstructionInfo instructionTable[INSTRUCTION_COUNT] = {
+#define INSTRUCTION(id, format, length, states, value, mask, value2, mask2) {format, length, states, value, mask, value2, mask2},
+#include "instructions.h"
+#undef INSTRUCTION
+	{"???", 2, 2, 0, 0, 0, 0}
+};
+
+// Most instructions are identified by their first word alone, so that's a single lookup.
+// The ones that need to look further (01 and 7x prefixes mostly) are marked with NEEDS_FULL_MATCH.
+#define NEEDS_FULL_MATCH 0xFFFF
+static uint16_t firstWordDecode[64 * 1024];
+
+void initDecoder(){
+	for(uint32_t word = 0; word < 64 * 1024; word++){
+		firstWordDecode[word] = OP_UNKNOWN;
+		for(int id = 0; id < OP_UNKNOWN; id++){
+			const struct InstructionInfo* info = &instructionTable[id];
+			if (((word << 16) & info->mask) == (info->value & 0xFFFF0000)){
+				firstWordDecode[word] = ((info->mask & 0xFFFF) || info->mask2) ? NEEDS_FULL_MATCH : id;
+				break;
+			}
+		}
+	}
+}
+
+uint32_t readBigEndian32(const uint8_t* bytes){
+	return ((uint32_t)bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+}
+
+enum InstructionId decodeInstruction(const uint8_t* bytes){
+	uint16_t id = firstWordDecode[(bytes[0] << 8) | bytes[1]];
+	if (id != NEEDS_FULL_MATCH){
+		return id;
+	}
+	uint32_t word0 = readBigEndian32(bytes);
+	uint32_t word1 = readBigEndian32(bytes + 4);
+	for(int i = 0; i < OP_UNKNOWN; i++){
+		const struct InstructionInfo* info = &instructionTable[i];
+		if ((word0 & info->mask) == info->value && (word1 & info->mask2) == info->value2){
+			return i;
+		}
+	}
+	return OP_UNKNOWN;
+}
+
+// Writes the instruction at address as text, returns its length in bytes
+int disassembleInstruction(uint32_t address, const uint8_t* bytes, char* out){
+	enum InstructionId id = decodeInstruction(bytes);
+	const struct InstructionInfo* info = &instructionTable[id];
+	for(const char* c = info->format; *c; c++){
+		if (*c != '%'){
+			*out++ = *c;
+			continue;
+		}
+		char kind = c[1];
+		int n = (c[2] <= '9') ? c[2] - '0' : c[2] - 'A' + 10;
+		c += 2;
+		uint8_t nibble = (n & 1) ? (bytes[n >> 1] & 0xF) : (bytes[n >> 1] >> 4);
+		int16_t disp16 = (bytes[n] << 8) | bytes[n + 1];
+		switch(kind){
+			case 'b': out += sprintf(out, "r%d%c", nibble & 0x7, (nibble & 0x8) ? 'l' : 'h'); break;
+			case 'w': out += sprintf(out, "%c%d", (nibble & 0x8) ? 'e' : 'r', nibble & 0x7); break;
+			case 'l': out += sprintf(out, "er%d", nibble & 0x7); break;
+			case 'i': out += sprintf(out, "#%d", nibble & 0x7); break;
+			case '1': out += sprintf(out, "#0x%02x", bytes[n]); break;
+			case '2': out += sprintf(out, "#0x%04x", (uint16_t)disp16); break;
+			case '4': out += sprintf(out, "#0x%08x", readBigEndian32(bytes + n)); break;
+			case 'a': out += sprintf(out, "@0x%04x:8", 0xFF00 | bytes[n]); break;
+			case 'A': out += sprintf(out, "@0x%04x:16", (uint16_t)disp16); break;
+			case 'x': out += sprintf(out, "@0x%06x:24", readBigEndian32(bytes + n - 1) & 0x00FFFFFF); break;
+			case 'd': out += sprintf(out, "0x%04x", (address + info->length + (int8_t)bytes[n]) & 0xFFFF); break;
+			case 'D': out += sprintf(out, "0x%04x", (address + info->length + disp16) & 0xFFFF); break;
+			case 's': out += sprintf(out, "%d", disp16); break;
+			case 'S': out += sprintf(out, "%d", (int32_t)(readBigEndian32(bytes + n - 1) << 8) >> 8); break;
+		}
+	}
+	*out = 0;
+	return info->length;
+}
+
+// Linear sweep over a whole image, one line per instruction
+void disassembleRom(const uint8_t* rom, int size){
+	char text[64];
+	for(int address = 0; address < size;){
+		int length = disassembleInstruction(address, rom + address, text);
+		printf("%04x  ", address);
+		for(int i = 0; i < 10; i += 2){
+			if (i < length){
+				printf("%02x%02x ", rom[address + i], rom[address + i + 1]);
+			} else{
+				printf("     ");
+			}
+		}
+		printf(" %s\n", text);
+		address += length;
+	}
+}
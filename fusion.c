@@ -0,0 +1,90 @@
+// Compare and branch fusion. Hot loops are mostly a CMP, BTST or BLD / BILD straight into a Bcc, so when nothing could get
+// in between the two (no trace, no breakpoint on the branch, no event due after the first one) the branch runs in the
+// same step and saves a trip around the main loop. CMP doesn't work its flags out at all (see cmp8 in alu.c): the Bcc
+// tests the operands directly, and they're only turned into flags when something else looks at them - getCCR, or the
+// next instruction unless it sets them all over again without reading them.
+// The lanes keep it off, they step the instructions one at a time.
+
+#define FUSE_WITH_BRANCH 0x01 // A Bcc right after this runs with it
+#define SETS_ALL_FLAGS 0x02 // H, N, Z, V and C, without reading them, so a deferred CMP can just be dropped
+#define KEEPS_FLAGS 0x04 // Doesn't touch them, or reads them through testCondition
+
+static uint8_t fusionTable[INSTRUCTION_COUNT];
+static bool fuseBranches = true;
+
+void initFusion(){
+	static const enum InstructionId compares[] = {OP_CMP_B_R_R, OP_CMP_W_R_R, OP_CMP_L_R_R, OP_CMP_B_IMM, OP_CMP_W_IMM, OP_CMP_L_IMM};
+	static const enum InstructionId bitTests[] = {
+		OP_BTST_R_R, OP_BTST_IMM_R, OP_BTST_R_IND, OP_BTST_IMM_IND, OP_BTST_R_ABS8, OP_BTST_IMM_ABS8,
+		OP_BLD_R, OP_BLD_IND, OP_BLD_ABS8, OP_BILD_R, OP_BILD_IND, OP_BILD_ABS8
+	};
+	static const enum InstructionId arithmetic[] = {
+		OP_ADD_B_R_R, OP_ADD_W_R_R, OP_ADD_L_R_R, OP_SUB_B_R_R, OP_SUB_W_R_R, OP_SUB_L_R_R,
+		OP_ADD_B_IMM, OP_ADD_W_IMM, OP_ADD_L_IMM, OP_NEG_B, OP_NEG_W, OP_NEG_L
+	};
+	static const enum InstructionId flow[] = {
+		OP_NOP, OP_BSR_8, OP_BSR_16, OP_JMP_IND, OP_JMP_ABS24, OP_JSR_IND, OP_JSR_ABS24, OP_RTS,
+		OP_ADDS_1, OP_ADDS_2, OP_ADDS_4, OP_SUBS_1, OP_SUBS_2, OP_SUBS_4, OP_MULXU_B, OP_MULXU_W,
+		OP_EEPMOV_B, OP_EEPMOV_W,
+		OP_BSET_R_R, OP_BSET_IMM_R, OP_BSET_R_IND, OP_BSET_IMM_IND, OP_BSET_R_ABS8, OP_BSET_IMM_ABS8,
+		OP_BNOT_R_R, OP_BNOT_IMM_R, OP_BNOT_R_IND, OP_BNOT_IMM_IND, OP_BNOT_R_ABS8, OP_BNOT_IMM_ABS8,
+		OP_BCLR_R_R, OP_BCLR_IMM_R, OP_BCLR_R_IND, OP_BCLR_IMM_IND, OP_BCLR_R_ABS8, OP_BCLR_IMM_ABS8
+	};
+	for(int i = 0; i < sizeof(compares) / sizeof(compares[0]); i++){
+		fusionTable[compares[i]] = FUSE_WITH_BRANCH | SETS_ALL_FLAGS;
+	}
+	for(int i = 0; i < sizeof(bitTests) / sizeof(bitTests[0]); i++){
+		fusionTable[bitTests[i]] = FUSE_WITH_BRANCH;
+	}
+	for(int i = 0; i < sizeof(arithmetic) / sizeof(arithmetic[0]); i++){
+		fusionTable[arithmetic[i]] = SETS_ALL_FLAGS;
+	}
+	for(int i = 0; i < sizeof(flow) / sizeof(flow[0]); i++){
+		fusionTable[flow[i]] = KEEPS_FLAGS;
+	}
+	for(int id = OP_BRA_8; id <= OP_BLE_8; id++){
+		fusionTable[id] = KEEPS_FLAGS;
+	}
+	for(int id = OP_BRA_16; id <= OP_BLE_16; id++){
+		fusionTable[id] = KEEPS_FLAGS;
+	}
+}
+
+// Called before an instruction runs while a CMP is still deferred
+void settleFlagsBefore(enum InstructionId id){
+	if (fusionTable[id] & SETS_ALL_FLAGS){
+		deferredCompare.bits = 0;
+	} else if (!(fusionTable[id] & KEEPS_FLAGS)){
+		settleFlags();
+	}
+}
+
+// Called by executeInstruction after a compare ran, with the pc after it. Runs the Bcc there too if it can, returns
+// the pc after that
+int fuseBranch(enum InstructionId id, int nextPc){
+	uint32_t at = nextPc & ADDRESS_MASK;
+	if (!fuseBranches || trace || historyRing || mode != RUN || stopReason || testBit(breakpoints, at) || cycles + instructionTable[id].states >= nextEventCycle){
+		return nextPc;
+	}
+	const uint8_t* branch = backingMemory(at, true);
+	enum InstructionId branchId = decodeInstruction(branch);
+	uint8_t condition;
+	int displacement;
+	if (branchId >= OP_BRA_8 && branchId <= OP_BLE_8){
+		condition = branch[0] & 0xF;
+		displacement = (int8_t)branch[1];
+	} else if (branchId >= OP_BRA_16 && branchId <= OP_BLE_16){
+		condition = branch[1] >> 4;
+		displacement = (int16_t)((branch[2] << 8) | branch[3]);
+	} else{
+		return nextPc;
+	}
+	cycles += instructionTable[branchId].states;
+	instructions++;
+	nextPc = at + instructionTable[branchId].length;
+	nextPc = testCondition(condition) ? nextPc + displacement : nextPc;
+	if (coveredPcs){
+		recordCoverage(branchId, at, nextPc & ADDRESS_MASK);
+	}
+	return nextPc;
+}
@@ -0,0 +1,389 @@
+// GDB remote serial protocol stub.
+// Listens on a local TCP port and lets gdb inspect registers and memory, set breakpoints / watchpoints, step and continue.
+// Breakpoints go into the same bitmap the dispatch loop already tests, and single stepping rides on the mode check at
+// the end of the loop, so when no debugger is attached the loop does exactly the same work as without the stub.
+//   gdb: set architecture h8300h; target remote localhost:<port>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef SOCKET Socket;
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+typedef int Socket;
+#define INVALID_SOCKET -1
+#define closesocket close
+#endif
+
+#define GDB_SIGINT 2
+#define GDB_SIGTRAP 5
+#define GDB_PACKET_SIZE 4096
+#define GDB_POLL_INTERVAL 4096 // Instructions between checks for a ctrl-c while running
+#define GDB_REGISTER_COUNT 13 // er0-er7, ccr, pc, cycles, tick, inst. All 32 bits on the H8/300H
+
+static Socket gdbSocket = INVALID_SOCKET;
+static int gdbPollCountdown;
+static uint64_t gdbResumedAt = UINT64_MAX; // Instruction count when gdb last let us go
+
+// What gdb inserted, one entry per address, so a detach takes out those and leaves the ones from -b and the console
+struct GdbPoint{
+	uint32_t address;
+	uint8_t type; // As in the Z packet
+	bool wasSet; // Already there before gdb asked for it, stays when gdb removes it
+};
+static struct GdbPoint* gdbPoints;
+static size_t gdbPointCount;
+static size_t gdbPointCapacity;
+
+static const char hexDigits[] = "0123456789abcdef";
+
+int hexValue(char c){
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+// Parses hex digits until a non hex character, leaves *text pointing at it
+uint32_t parseHex(const char** text){
+	uint32_t value = 0;
+	while(hexValue(**text) >= 0){
+		value = (value << 4) | hexValue(**text);
+		(*text)++;
+	}
+	return value;
+}
+
+char* writeHex32(char* out, uint32_t value){
+	for(int shift = 28; shift >= 0; shift -= 4){
+		*out++ = hexDigits[(value >> shift) & 0xF];
+	}
+	return out;
+}
+
+int gdbReadByte(){
+	uint8_t c;
+	if (recv(gdbSocket, (char*)&c, 1, 0) != 1){
+		return -1;
+	}
+	return c;
+}
+
+void gdbSendPacket(const char* data){
+	char buffer[GDB_PACKET_SIZE * 2 + 4];
+	uint8_t checksum = 0;
+	int length = 0;
+	buffer[length++] = '$';
+	for(const char* c = data; *c; c++){
+		buffer[length++] = *c;
+		checksum += *c;
+	}
+	buffer[length++] = '#';
+	buffer[length++] = hexDigits[checksum >> 4];
+	buffer[length++] = hexDigits[checksum & 0xF];
+	send(gdbSocket, buffer, length, 0);
+}
+
+// Blocks until a full packet arrives and acks it. Returns false if gdb went away.
+bool gdbReceivePacket(char* packet){
+	int c;
+	while(true){
+		do{
+			c = gdbReadByte();
+			if (c < 0){
+				return false;
+			}
+		} while(c != '$');
+
+		int length = 0;
+		uint8_t checksum = 0;
+		while((c = gdbReadByte()) >= 0 && c != '#'){
+			if (length < GDB_PACKET_SIZE - 1){
+				packet[length++] = c;
+			}
+			checksum += c;
+		}
+		packet[length] = 0;
+		int hi = gdbReadByte();
+		int lo = gdbReadByte();
+		if (c < 0 || hi < 0 || lo < 0){
+			return false;
+		}
+		if (((hexValue(hi) << 4) | hexValue(lo)) == checksum){
+			send(gdbSocket, "+", 1, 0);
+			return true;
+		}
+		send(gdbSocket, "-", 1, 0);
+	}
+}
+
+uint32_t gdbGetRegister(int idx){
+	if (idx < 8){
+		return *ER[idx];
+	}
+	switch(idx){
+		case 8: return getCCR();
+		case 9: return pc;
+	}
+	return 0; // cycles, tick and inst aren't tracked
+}
+
+void gdbSetRegister(int idx, uint32_t value){
+	if (idx < 8){
+		*ER[idx] = value;
+	} else if (idx == 8){
+		setCCR(value);
+	} else if (idx == 9){
+		pc = value & ADDRESS_MASK;
+	}
+}
+
+void gdbInsertPoint(uint8_t type, uint32_t address){
+	bool onRead = type != 2;
+	bool onWrite = type != 3;
+	bool wasSet = (type < 2) ? testBit(breakpoints, address) : (!onRead || testBit(readWatchpoints, address)) && (!onWrite || testBit(writeWatchpoints, address));
+	if (gdbPointCount == gdbPointCapacity){
+		gdbPointCapacity = gdbPointCapacity ? gdbPointCapacity * 2 : 64;
+		gdbPoints = realloc(gdbPoints, gdbPointCapacity * sizeof(struct GdbPoint));
+	}
+	gdbPoints[gdbPointCount++] = (struct GdbPoint){address, type, wasSet};
+	if (type < 2){
+		addBreakpoint(address);
+	} else{
+		addWatchpoint(address, onRead, onWrite);
+	}
+}
+
+void gdbRemovePoint(size_t index){
+	struct GdbPoint point = gdbPoints[index];
+	gdbPoints[index] = gdbPoints[--gdbPointCount];
+	if (point.wasSet){
+		return;
+	}
+	if (point.type < 2){
+		removeBreakpoint(point.address);
+		addStopBreakpoints();
+	} else{
+		removeWatchpoint(point.address, point.type != 2, point.type != 3);
+	}
+}
+
+void gdbDetach(){
+	closesocket(gdbSocket);
+	gdbSocket = INVALID_SOCKET;
+	while(gdbPointCount){
+		gdbRemovePoint(gdbPointCount - 1);
+	}
+	watchpointHitType = 0;
+	mode = RUN;
+}
+
+// Z/z packets: 0 software and 1 hardware breakpoints, 2 write, 3 read and 4 access watchpoints.
+void gdbBreakpointPacket(const char* packet, char* reply){
+	bool insert = packet[0] == 'Z';
+	const char* args = packet + 1;
+	uint32_t type = parseHex(&args);
+	args++;
+	uint32_t address = parseHex(&args);
+	args++;
+	uint32_t length = parseHex(&args);
+	if (type > 4){
+		reply[0] = 0;
+		return;
+	}
+	for(uint32_t i = 0; i < (type < 2 ? 1 : length); i++){
+		uint32_t at = (address + i) & ADDRESS_MASK;
+		if (insert){
+			gdbInsertPoint(type, at);
+			continue;
+		}
+		for(size_t j = 0; j < gdbPointCount; j++){
+			if (gdbPoints[j].address == at && gdbPoints[j].type == type){
+				gdbRemovePoint(j);
+				break;
+			}
+		}
+	}
+	strcpy(reply, "OK");
+}
+
+// Serves packets until gdb resumes execution
+void gdbServe(){
+	char packet[GDB_PACKET_SIZE];
+	char reply[GDB_PACKET_SIZE];
+	while(gdbReceivePacket(packet)){
+		reply[0] = 0;
+		const char* args = packet + 1;
+		switch(packet[0]){
+			case '?':{
+				sprintf(reply, "S%02x", GDB_SIGTRAP);
+			}break;
+			case 'g':{ // Read all registers, big endian
+				char* out = reply;
+				for(int i = 0; i < GDB_REGISTER_COUNT; i++){
+					out = writeHex32(out, gdbGetRegister(i));
+				}
+				*out = 0;
+			}break;
+			case 'G':{
+				for(int i = 0; i < GDB_REGISTER_COUNT && strlen(args) >= 8; i++){
+					char word[9] = {0};
+					memcpy(word, args, 8);
+					const char* digits = word;
+					gdbSetRegister(i, parseHex(&digits));
+					args += 8;
+				}
+				strcpy(reply, "OK");
+			}break;
+			case 'p':{
+				*writeHex32(reply, gdbGetRegister(parseHex(&args))) = 0;
+			}break;
+			case 'P':{
+				int idx = parseHex(&args);
+				args++;
+				gdbSetRegister(idx, parseHex(&args));
+				strcpy(reply, "OK");
+			}break;
+			case 'm':{
+				uint32_t address = parseHex(&args);
+				args++;
+				uint32_t length = parseHex(&args);
+				if (length > GDB_PACKET_SIZE / 2 - 1){
+					length = GDB_PACKET_SIZE / 2 - 1;
+				}
+				for(uint32_t i = 0; i < length; i++){
+					uint8_t value = peekMemory8(address + i);
+					reply[i * 2] = hexDigits[value >> 4];
+					reply[i * 2 + 1] = hexDigits[value & 0xF];
+				}
+				reply[length * 2] = 0;
+			}break;
+			case 'M':{
+				uint32_t address = parseHex(&args);
+				args++;
+				uint32_t length = parseHex(&args);
+				args++;
+				for(uint32_t i = 0; i < length && args[0] && args[1]; i++, args += 2){
+					pokeMemory8(address + i, (hexValue(args[0]) << 4) | hexValue(args[1]));
+				}
+				strcpy(reply, "OK");
+			}break;
+			case 'c':{
+				if (*args){
+					pc = parseHex(&args) & ADDRESS_MASK;
+				}
+				mode = GDB_RUN;
+				gdbPollCountdown = GDB_POLL_INTERVAL;
+				gdbResumedAt = instructions;
+				return;
+			}
+			case 's':{
+				if (*args){
+					pc = parseHex(&args) & ADDRESS_MASK;
+				}
+				mode = GDB_STEP;
+				gdbResumedAt = instructions;
+				return;
+			}
+			case 'Z':
+			case 'z':{
+				gdbBreakpointPacket(packet, reply);
+			}break;
+			case 'H':{ // Single threaded, any thread is fine
+				strcpy(reply, "OK");
+			}break;
+			case 'q':{
+				if (strncmp(packet, "qSupported", 10) == 0){
+					sprintf(reply, "PacketSize=%x", GDB_PACKET_SIZE);
+				} else if (strcmp(packet, "qAttached") == 0){
+					strcpy(reply, "1");
+				}
+			}break;
+			case 'D':{
+				gdbSendPacket("OK");
+				gdbDetach();
+				return;
+			}
+			case 'k':{
+				gdbDetach();
+				exit(0);
+			}
+		}
+		gdbSendPacket(reply);
+	}
+	gdbDetach(); // Connection dropped
+}
+
+// Reports why we stopped and waits for the next command
+void gdbStopped(int signal){
+	char reply[32];
+	if (watchpointHitType){
+		const char* kind = (watchpointHitType == 'w') ? "watch" : "rwatch";
+		sprintf(reply, "T%02x%s:%x;", signal, kind, watchpointHitAddress);
+		watchpointHitType = 0;
+	} else{
+		sprintf(reply, "T%02x", signal);
+	}
+	gdbSendPacket(reply);
+	gdbServe();
+}
+
+// Only called every GDB_POLL_INTERVAL instructions while attached, checks if gdb sent a ctrl-c
+void gdbPoll(){
+	gdbPollCountdown = GDB_POLL_INTERVAL;
+	fd_set readSet;
+	FD_ZERO(&readSet);
+	FD_SET(gdbSocket, &readSet);
+	struct timeval timeout = {0};
+	if (select(gdbSocket + 1, &readSet, NULL, NULL, &timeout) > 0){
+		int c = gdbReadByte();
+		if (c == 0x03){
+			gdbStopped(GDB_SIGINT);
+		} else if (c < 0){
+			gdbDetach();
+		}
+	}
+}
+
+void gdbExited(int code){
+	char reply[8];
+	sprintf(reply, "W%02x", code);
+	gdbSendPacket(reply);
+	gdbDetach();
+}
+
+// Blocks until gdb connects, execution starts stopped at the entry point
+void gdbWaitForConnection(int port){
+#ifdef _WIN32
+	WSADATA wsaData;
+	WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+	Socket listener = socket(AF_INET, SOCK_STREAM, 0);
+	int reuse = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+	struct sockaddr_in address = {0};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(port);
+	if (bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 1) != 0){
+		printf("Can't listen for gdb on port %d\n", port);
+		closesocket(listener);
+		return;
+	}
+	printf("Waiting for gdb on port %d\n", port);
+	gdbSocket = accept(listener, NULL, NULL);
+	closesocket(listener);
+	if (gdbSocket == INVALID_SOCKET){
+		return;
+	}
+	int noDelay = 1;
+	setsockopt(gdbSocket, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+	mode = GDB_STEP; // Anything but RUN, gdbServe sets the real mode
+	gdbServe();
+}
@@ -0,0 +1,78 @@
+// Hang report, -T count. Keeps the pc of the last count instructions in a ring and a shadow call stack, and prints
+// both when the watchdog expires, so a batch run that hung says where instead of running out its time budget.
+// The shadow stack follows BSR, JSR and TRAPA, and drops frames once SP is back above them, so firmware that returns
+// with its own stack tricks (or from an interrupt, which doesn't push a frame here) can't leave it out of step.
+// Off by default, it's one branch per instruction while it's off.
+
+#define SHADOW_STACK_DEPTH 256
+
+struct ShadowFrame{
+	uint32_t from; // The call instruction
+	uint32_t to;
+	uint32_t sp; // After the return address went on
+};
+
+static uint32_t* historyRing; // NULL while it's off
+static uint32_t historySize; // Power of two
+static uint64_t historyCount;
+static struct ShadowFrame shadowStack[SHADOW_STACK_DEPTH];
+static int shadowDepth;
+static int shadowDropped; // Frames that didn't fit, the outermost ones
+
+void enableHangReport(uint64_t count){
+	historySize = 1;
+	while(historySize < count && historySize < (1 << 24)){
+		historySize <<= 1;
+	}
+	historyRing = malloc(historySize * sizeof(uint32_t));
+	stopOnWatchdog = true;
+}
+
+// Called by executeInstruction after the instruction ran, with from the pc it ran at
+void recordHistory(enum InstructionId id, uint32_t from, uint32_t to){
+	historyRing[historyCount++ & (historySize - 1)] = from;
+	switch(id){
+		case OP_BSR_8:
+		case OP_BSR_16:
+		case OP_JSR_IND:
+		case OP_JSR_ABS24:
+		case OP_TRAPA:{
+			if (shadowDepth == SHADOW_STACK_DEPTH){
+				memmove(shadowStack, shadowStack + 1, (SHADOW_STACK_DEPTH - 1) * sizeof(struct ShadowFrame));
+				shadowDepth--;
+				shadowDropped++;
+			}
+			shadowStack[shadowDepth++] = (struct ShadowFrame){from, to, *SP};
+		}break;
+		case OP_RTS:
+		case OP_RTE:{
+			while(shadowDepth && shadowStack[shadowDepth - 1].sp < *SP){
+				shadowDepth--;
+			}
+		}break;
+		default:{
+		}break;
+	}
+}
+
+void printHangReport(){
+	printf("HANG - %s at 0x%04x after %llu instructions, %llu states\n", stopReason, pc, (unsigned long long)instructions, (unsigned long long)cycles);
+	if (!historyRing){
+		return;
+	}
+	uint64_t count = (historyCount < historySize) ? historyCount : historySize;
+	printf("HANG - last %llu instructions, oldest first:\n", (unsigned long long)count);
+	for(uint64_t i = historyCount - count; i < historyCount; i++){
+		uint32_t at = historyRing[i & (historySize - 1)];
+		char text[64];
+		disassembleInstruction(at, backingMemory(at, true), text);
+		printf("  %04x - %s\n", at, text);
+	}
+	printf("HANG - call stack, innermost first:\n");
+	for(int i = shadowDepth - 1; i >= 0; i--){
+		printf("  #%d 0x%04x, called from 0x%04x (SP 0x%04x)\n", shadowDepth - 1 - i, shadowStack[i].to, shadowStack[i].from, shadowStack[i].sp);
+	}
+	if (shadowDropped){
+		printf("  ... and %d older frames\n", shadowDropped);
+	}
+}
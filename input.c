@@ -0,0 +1,212 @@
+// External inputs: port pins, buttons, accelerometer registers, real time clock warps and whatever else the outside world feeds the walker.
+// Every input goes through inputWrite so it can be journaled while recording (-R file) and fed back at the
+// exact same state count while replaying one (-P file). A replay ignores live inputs, so two replays of the
+// same journal end in the same state, which stateHash() makes easy to check.
+//
+// Journal: "PKIN" followed by one record per input: states since the previous record as a LEB128 varint,
+// then device, index and value bytes. Most records end up 4 or 5 bytes long.
+
+enum InputDevice{
+	INPUT_PORT, // index is the low byte of a 0xFFxx port data register
+	INPUT_ACCEL, // index is the accelerometer register
+	INPUT_BUTTON, // index is the button (see ports.c), value 1 while it's held down
+	INPUT_RTC_WARP, // index is the unit (see rtc.c), value how many of them
+	INPUT_DEVICE_COUNT
+};
+
+static FILE* inputRecordFile;
+static uint64_t inputLastCycle;
+
+static uint8_t* replayData;
+static long replaySize;
+static long replayPosition;
+static uint64_t nextReplayCycle = UINT64_MAX;
+
+// While the rewind buffer is on, live inputs are also kept here so running forward again after a rewind sees them
+struct InputEvent{
+	uint64_t cycle;
+	uint8_t device;
+	uint8_t index;
+	uint8_t value;
+};
+static struct InputEvent* inputHistory;
+static size_t inputHistoryCount;
+static size_t inputHistoryCapacity;
+static size_t inputHistoryCursor; // Below inputHistoryCount while running forward over inputs we've already seen
+static bool keepInputHistory;
+
+void applyInput(uint8_t device, uint8_t index, uint8_t value){
+	switch(device){
+		case INPUT_PORT:{
+			setPortPins(0xFF00 | index, value);
+		}break;
+		case INPUT_ACCEL:{
+			if (index < 29){
+				accel_memory[index] = value;
+			}
+		}break;
+		case INPUT_BUTTON:{
+			setButton(index, value);
+		}break;
+		case INPUT_RTC_WARP:{
+			warpRtc(index, value);
+		}break;
+	}
+}
+
+void inputWrite(uint8_t device, uint8_t index, uint8_t value){
+	if (replayData || inputHistoryCursor < inputHistoryCount){
+		return;
+	}
+	if (inputRecordFile){
+		uint64_t delta = cycles - inputLastCycle;
+		inputLastCycle = cycles;
+		do{
+			uint8_t byte = delta & 0x7F;
+			delta >>= 7;
+			fputc(byte | (delta ? 0x80 : 0), inputRecordFile);
+		} while(delta);
+		uint8_t record[3] = {device, index, value};
+		fwrite(record, 1, 3, inputRecordFile);
+	}
+	if (keepInputHistory){
+		if (inputHistoryCount == inputHistoryCapacity){
+			inputHistoryCapacity = inputHistoryCapacity ? inputHistoryCapacity * 2 : 256;
+			inputHistory = realloc(inputHistory, inputHistoryCapacity * sizeof(struct InputEvent));
+		}
+		inputHistory[inputHistoryCount++] = (struct InputEvent){cycles, device, index, value};
+		inputHistoryCursor = inputHistoryCount;
+	}
+	applyInput(device, index, value);
+}
+
+// Moves the real time clock forward, as a few records of days, hours, minutes and seconds. 0 goes to the next midnight.
+void inputRtcWarp(uint64_t seconds){
+	if (!seconds){
+		inputWrite(INPUT_RTC_WARP, RTC_WARP_MIDNIGHT, 0);
+		return;
+	}
+	static const uint32_t unitSeconds[] = {86400, 3600, 60, 1};
+	for(int i = 0; i < 4; i++){
+		uint64_t count = seconds / unitSeconds[i];
+		seconds %= unitSeconds[i];
+		while(count){
+			uint8_t chunk = (count > 255) ? 255 : count;
+			inputWrite(INPUT_RTC_WARP, RTC_WARP_DAYS - i, chunk);
+			count -= chunk;
+		}
+	}
+}
+
+bool startInputRecord(const char* path){
+	inputRecordFile = fopen(path, "wb");
+	if (!inputRecordFile){
+		return false;
+	}
+	fwrite("PKIN", 1, 4, inputRecordFile);
+	return true;
+}
+
+// Reads the states delta of the next record, or leaves nextReplayCycle at UINT64_MAX at the end of the journal
+void readNextReplayCycle(){
+	uint64_t delta = 0;
+	int shift = 0;
+	while(replayPosition < replaySize){
+		uint8_t byte = replayData[replayPosition++];
+		delta |= (uint64_t)(byte & 0x7F) << shift;
+		shift += 7;
+		if (!(byte & 0x80)){
+			if (replayPosition + 3 <= replaySize){
+				nextReplayCycle += delta;
+				return;
+			}
+			break;
+		}
+	}
+	nextReplayCycle = UINT64_MAX;
+}
+
+bool startInputReplay(const char* path){
+	FILE* file = fopen(path, "rb");
+	if (!file){
+		return false;
+	}
+	fseek(file, 0, SEEK_END);
+	replaySize = ftell(file);
+	rewind(file);
+	replayData = malloc(replaySize + 1);
+	fread(replayData, 1, replaySize, file);
+	fclose(file);
+	if (replaySize < 4 || memcmp(replayData, "PKIN", 4) != 0){
+		free(replayData);
+		replayData = NULL;
+		return false;
+	}
+	replayPosition = 4;
+	nextReplayCycle = 0;
+	readNextReplayCycle();
+	return true;
+}
+
+// Called from serviceEvents, applies every journal record and every input from the history that's due
+void replayInputs(){
+	while(nextReplayCycle <= cycles){
+		uint8_t* record = replayData + replayPosition;
+		applyInput(record[0], record[1], record[2]);
+		replayPosition += 3;
+		readNextReplayCycle();
+	}
+	while(inputHistoryCursor < inputHistoryCount && inputHistory[inputHistoryCursor].cycle <= cycles){
+		struct InputEvent* event = &inputHistory[inputHistoryCursor++];
+		applyInput(event->device, event->index, event->value);
+	}
+}
+
+uint64_t nextInputCycle(){
+	if (inputHistoryCursor < inputHistoryCount && inputHistory[inputHistoryCursor].cycle < nextReplayCycle){
+		return inputHistory[inputHistoryCursor].cycle;
+	}
+	return nextReplayCycle;
+}
+
+void stopInputRecord(){
+	if (inputRecordFile){
+		fclose(inputRecordFile);
+		inputRecordFile = NULL;
+	}
+}
+
+// FNV-1a over everything that makes up the emulated machine
+uint64_t hashBytes(uint64_t hash, const void* data, size_t size){
+	for(size_t i = 0; i < size; i++){
+		hash = (hash ^ ((const uint8_t*)data)[i]) * 0x100000001B3ull;
+	}
+	return hash;
+}
+
+uint64_t stateHash(){
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for(int i = 0; i < 8; i++){
+		hash = hashBytes(hash, ER[i], 4);
+	}
+	uint8_t ccr = getCCR();
+	hash = hashBytes(hash, &ccr, 1);
+	hash = hashBytes(hash, &pc, sizeof(pc));
+	hash = hashBytes(hash, &cycles, sizeof(cycles));
+	for(int i = 0; i < (ADDRESS_SPACE >> BLOCK_SHIFT); i++){
+		if (blocks[i] && (i == 0 || blocks[i] != memory)){ // The on-chip memory is only hashed once
+			hash = hashBytes(hash, &i, sizeof(i));
+			hash = hashBytes(hash, blocks[i], BLOCK_SIZE);
+		}
+	}
+	hash = hashBytes(hash, accel_memory, 29);
+	hash = hashBytes(hash, ssuBuffer, sizeof(ssuBuffer));
+	hash = hashBytes(hash, ports, sizeof(ports));
+	hash = hashBytes(hash, &sleeping, sizeof(sleeping));
+	uint8_t clock[6] = {rtc.running, rtc.quarter, rtc.seconds, rtc.minutes, rtc.hours, rtc.weekday};
+	hash = hashBytes(hash, clock, sizeof(clock));
+	hash = hashBytes(hash, &rtc.nextTick, sizeof(rtc.nextTick));
+	hash = hashBytes(hash, &watchdog.control, 1);
+	hash = hashBytes(hash, &watchdog.expiry, sizeof(watchdog.expiry));
+	return hash;
+}
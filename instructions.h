@@ -0,0 +1,292 @@
+// H8/300H instruction set description. Everything that decodes or prints instructions is generated from this list.
+// INSTRUCTION(id, format, length, states, value, mask, value2, mask2)
+//   value / mask are matched against bytes 0-3 of the instruction, value2 / mask2 against bytes 4-7 (only needed by the d:24 forms).
+//   length is in bytes, states is the execution time from the manual's tables assuming on-chip memory.
+//   Earlier entries win when more than one matches.
+// Format escapes, N is a hex digit: a nibble index for registers and bit numbers, a byte index for everything else
+//   %bN r0h-r7l    %wN r0-e7    %lN er0-er7    %iN #bit (low 3 bits of the nibble)
+//   %1N #imm8      %2N #imm16   %4N #imm32
+//   %aN @aa:8      %AN @aa:16   %xN @aa:24
+//   %dN branch target with a d:8 displacement     %DN same with d:16
+//   %sN signed d:16 displacement                  %SN signed d:24 displacement
+
+INSTRUCTION(NOP,            "NOP",                      2,  2, 0x00000000, 0xFFFF0000, 0, 0)
+
+// 01 prefixed: MOV.L to and from memory, LDC/STC with memory, SLEEP, MULXS, DIVXS and the long logic ops
+INSTRUCTION(MOV_L_IND_R,    "MOV.l @%l6, %l7",          4,  8, 0x01006900, 0xFFFFFF80, 0, 0)
+INSTRUCTION(MOV_L_R_IND,    "MOV.l %l7, @%l6",          4,  8, 0x01006980, 0xFFFFFF80, 0, 0)
+INSTRUCTION(MOV_L_ABS16_R,  "MOV.l %A4, %l7",           6, 10, 0x01006B00, 0xFFFFFFF8, 0, 0)
+INSTRUCTION(MOV_L_ABS24_R,  "MOV.l %x5, %l7",           8, 12, 0x01006B20, 0xFFFFFFF8, 0, 0)
+INSTRUCTION(MOV_L_R_ABS16,  "MOV.l %l7, %A4",           6, 10, 0x01006B80, 0xFFFFFFF8, 0, 0)
+INSTRUCTION(MOV_L_R_ABS24,  "MOV.l %l7, %x5",           8, 12, 0x01006BA0, 0xFFFFFFF8, 0, 0)
+INSTRUCTION(MOV_L_POSTINC_R,"MOV.l @%l6+, %l7",         4, 10, 0x01006D00, 0xFFFFFF80, 0, 0)
+INSTRUCTION(MOV_L_R_PREDEC, "MOV.l %l7, @-%l6",         4, 10, 0x01006D80, 0xFFFFFF80, 0, 0)
+INSTRUCTION(MOV_L_DISP16_R, "MOV.l @(%s4, %l6), %l7",   6, 10, 0x01006F00, 0xFFFFFF80, 0, 0)
+INSTRUCTION(MOV_L_R_DISP16, "MOV.l %l7, @(%s4, %l6)",   6, 10, 0x01006F80, 0xFFFFFF80, 0, 0)
+INSTRUCTION(MOV_L_DISP24_R, "MOV.l @(%S7, %l6), %lB",   10, 14, 0x01007800, 0xFFFFFF8F, 0x6B200000, 0xFFF8FF00)
+INSTRUCTION(MOV_L_R_DISP24, "MOV.l %lB, @(%S7, %l6)",   10, 14, 0x01007800, 0xFFFFFF8F, 0x6BA00000, 0xFFF8FF00)
+INSTRUCTION(LDC_W_IND,      "LDC.w @%l6, ccr",          4,  6, 0x01406900, 0xFFFFFF8F, 0, 0)
+INSTRUCTION(STC_W_IND,      "STC.w ccr, @%l6",          4,  6, 0x01406980, 0xFFFFFF8F, 0, 0)
+INSTRUCTION(LDC_W_ABS16,    "LDC.w %A4, ccr",           6,  8, 0x01406B00, 0xFFFFFFFF, 0, 0)
+INSTRUCTION(LDC_W_ABS24,    "LDC.w %x5, ccr",           8, 10, 0x01406B20, 0xFFFFFFFF, 0, 0)
+INSTRUCTION(STC_W_ABS16,    "STC.w ccr, %A4",           6,  8, 0x01406B80, 0xFFFFFFFF, 0, 0)
+INSTRUCTION(STC_W_ABS24,    "STC.w ccr, %x5",           8, 10, 0x01406BA0, 0xFFFFFFFF, 0, 0)
+INSTRUCTION(LDC_W_POSTINC,  "LDC.w @%l6+, ccr",         4,  8, 0x01406D00, 0xFFFFFF8F, 0, 0)
+INSTRUCTION(STC_W_PREDEC,   "STC.w ccr, @-%l6",         4,  8, 0x01406D80, 0xFFFFFF8F, 0, 0)
+INSTRUCTION(LDC_W_DISP16,   "LDC.w @(%s4, %l6), ccr",   6,  8, 0x01406F00, 0xFFFFFF8F, 0, 0)
+INSTRUCTION(STC_W_DISP16,   "STC.w ccr, @(%s4, %l6)",   6,  8, 0x01406F80, 0xFFFFFF8F, 0, 0)
+INSTRUCTION(LDC_W_DISP24,   "LDC.w @(%S7, %l6), ccr",   10, 12, 0x01407800, 0xFFFFFF8F, 0x6B200000, 0xFFFFFF00)
+INSTRUCTION(STC_W_DISP24,   "STC.w ccr, @(%S7, %l6)",   10, 12, 0x01407800, 0xFFFFFF8F, 0x6BA00000, 0xFFFFFF00)
+INSTRUCTION(SLEEP,          "SLEEP",                    2,  2, 0x01800000, 0xFFFF0000, 0, 0)
+INSTRUCTION(MULXS_B,        "MULXS.b %b6, %w7",         4, 16, 0x01C05000, 0xFFFFFF00, 0, 0)
+INSTRUCTION(MULXS_W,        "MULXS.w %w6, %l7",         4, 24, 0x01C05200, 0xFFFFFF08, 0, 0)
+INSTRUCTION(DIVXS_B,        "DIVXS.b %b6, %w7",         4, 16, 0x01D05100, 0xFFFFFF00, 0, 0)
+INSTRUCTION(DIVXS_W,        "DIVXS.w %w6, %l7",         4, 24, 0x01D05300, 0xFFFFFF08, 0, 0)
+INSTRUCTION(OR_L_R_R,       "OR.l %l6, %l7",            4,  4, 0x01F06400, 0xFFFFFF88, 0, 0)
+INSTRUCTION(XOR_L_R_R,      "XOR.l %l6, %l7",           4,  4, 0x01F06500, 0xFFFFFF88, 0, 0)
+INSTRUCTION(AND_L_R_R,      "AND.l %l6, %l7",           4,  4, 0x01F06600, 0xFFFFFF88, 0, 0)
+
+// 0x: CCR ops, ADD, INC, ADDS, MOV between registers
+INSTRUCTION(STC_B,          "STC.b ccr, %b3",           2,  2, 0x02000000, 0xFFF00000, 0, 0)
+INSTRUCTION(LDC_B_R,        "LDC.b %b3, ccr",           2,  2, 0x03000000, 0xFFF00000, 0, 0)
+INSTRUCTION(ORC,            "ORC %11, ccr",             2,  2, 0x04000000, 0xFF000000, 0, 0)
+INSTRUCTION(XORC,           "XORC %11, ccr",            2,  2, 0x05000000, 0xFF000000, 0, 0)
+INSTRUCTION(ANDC,           "ANDC %11, ccr",            2,  2, 0x06000000, 0xFF000000, 0, 0)
+INSTRUCTION(LDC_B_IMM,      "LDC.b %11, ccr",           2,  2, 0x07000000, 0xFF000000, 0, 0)
+INSTRUCTION(ADD_B_R_R,      "ADD.b %b2, %b3",           2,  2, 0x08000000, 0xFF000000, 0, 0)
+INSTRUCTION(ADD_W_R_R,      "ADD.w %w2, %w3",           2,  2, 0x09000000, 0xFF000000, 0, 0)
+INSTRUCTION(INC_B,          "INC.b %b3",                2,  2, 0x0A000000, 0xFFF00000, 0, 0)
+INSTRUCTION(ADD_L_R_R,      "ADD.l %l2, %l3",           2,  2, 0x0A800000, 0xFF880000, 0, 0)
+INSTRUCTION(ADDS_1,         "ADDS.l #1, %l3",           2,  2, 0x0B000000, 0xFFF80000, 0, 0)
+INSTRUCTION(ADDS_2,         "ADDS.l #2, %l3",           2,  2, 0x0B800000, 0xFFF80000, 0, 0)
+INSTRUCTION(ADDS_4,         "ADDS.l #4, %l3",           2,  2, 0x0B900000, 0xFFF80000, 0, 0)
+INSTRUCTION(INC_W_1,        "INC.w #1, %w3",            2,  2, 0x0B500000, 0xFFF00000, 0, 0)
+INSTRUCTION(INC_L_1,        "INC.l #1, %l3",            2,  2, 0x0B700000, 0xFFF80000, 0, 0)
+INSTRUCTION(INC_W_2,        "INC.w #2, %w3",            2,  2, 0x0BD00000, 0xFFF00000, 0, 0)
+INSTRUCTION(INC_L_2,        "INC.l #2, %l3",            2,  2, 0x0BF00000, 0xFFF80000, 0, 0)
+INSTRUCTION(MOV_B_R_R,      "MOV.b %b2, %b3",           2,  2, 0x0C000000, 0xFF000000, 0, 0)
+INSTRUCTION(MOV_W_R_R,      "MOV.w %w2, %w3",           2,  2, 0x0D000000, 0xFF000000, 0, 0)
+INSTRUCTION(ADDX_R_R,       "ADDX %b2, %b3",            2,  2, 0x0E000000, 0xFF000000, 0, 0)
+INSTRUCTION(DAA,            "DAA %b3",                  2,  2, 0x0F000000, 0xFFF00000, 0, 0)
+INSTRUCTION(MOV_L_R_R,      "MOV.l %l2, %l3",           2,  2, 0x0F800000, 0xFF880000, 0, 0)
+
+// 1x: shifts and rotates, SUB, DEC, SUBS, CMP, NOT / NEG / EXTU / EXTS
+INSTRUCTION(SHLL_B,         "SHLL.b %b3",               2,  2, 0x10000000, 0xFFF00000, 0, 0)
+INSTRUCTION(SHLL_W,         "SHLL.w %w3",               2,  2, 0x10100000, 0xFFF00000, 0, 0)
+INSTRUCTION(SHLL_L,         "SHLL.l %l3",               2,  2, 0x10300000, 0xFFF80000, 0, 0)
+INSTRUCTION(SHAL_B,         "SHAL.b %b3",               2,  2, 0x10800000, 0xFFF00000, 0, 0)
+INSTRUCTION(SHAL_W,         "SHAL.w %w3",               2,  2, 0x10900000, 0xFFF00000, 0, 0)
+INSTRUCTION(SHAL_L,         "SHAL.l %l3",               2,  2, 0x10B00000, 0xFFF80000, 0, 0)
+INSTRUCTION(SHLR_B,         "SHLR.b %b3",               2,  2, 0x11000000, 0xFFF00000, 0, 0)
+INSTRUCTION(SHLR_W,         "SHLR.w %w3",               2,  2, 0x11100000, 0xFFF00000, 0, 0)
+INSTRUCTION(SHLR_L,         "SHLR.l %l3",               2,  2, 0x11300000, 0xFFF80000, 0, 0)
+INSTRUCTION(SHAR_B,         "SHAR.b %b3",               2,  2, 0x11800000, 0xFFF00000, 0, 0)
+INSTRUCTION(SHAR_W,         "SHAR.w %w3",               2,  2, 0x11900000, 0xFFF00000, 0, 0)
+INSTRUCTION(SHAR_L,         "SHAR.l %l3",               2,  2, 0x11B00000, 0xFFF80000, 0, 0)
+INSTRUCTION(ROTXL_B,        "ROTXL.b %b3",              2,  2, 0x12000000, 0xFFF00000, 0, 0)
+INSTRUCTION(ROTXL_W,        "ROTXL.w %w3",              2,  2, 0x12100000, 0xFFF00000, 0, 0)
+INSTRUCTION(ROTXL_L,        "ROTXL.l %l3",              2,  2, 0x12300000, 0xFFF80000, 0, 0)
+INSTRUCTION(ROTL_B,         "ROTL.b %b3",               2,  2, 0x12800000, 0xFFF00000, 0, 0)
+INSTRUCTION(ROTL_W,         "ROTL.w %w3",               2,  2, 0x12900000, 0xFFF00000, 0, 0)
+INSTRUCTION(ROTL_L,         "ROTL.l %l3",               2,  2, 0x12B00000, 0xFFF80000, 0, 0)
+INSTRUCTION(ROTXR_B,        "ROTXR.b %b3",              2,  2, 0x13000000, 0xFFF00000, 0, 0)
+INSTRUCTION(ROTXR_W,        "ROTXR.w %w3",              2,  2, 0x13100000, 0xFFF00000, 0, 0)
+INSTRUCTION(ROTXR_L,        "ROTXR.l %l3",              2,  2, 0x13300000, 0xFFF80000, 0, 0)
+INSTRUCTION(ROTR_B,         "ROTR.b %b3",               2,  2, 0x13800000, 0xFFF00000, 0, 0)
+INSTRUCTION(ROTR_W,         "ROTR.w %w3",               2,  2, 0x13900000, 0xFFF00000, 0, 0)
+INSTRUCTION(ROTR_L,         "ROTR.l %l3",               2,  2, 0x13B00000, 0xFFF80000, 0, 0)
+INSTRUCTION(OR_B_R_R,       "OR.b %b2, %b3",            2,  2, 0x14000000, 0xFF000000, 0, 0)
+INSTRUCTION(XOR_B_R_R,      "XOR.b %b2, %b3",           2,  2, 0x15000000, 0xFF000000, 0, 0)
+INSTRUCTION(AND_B_R_R,      "AND.b %b2, %b3",           2,  2, 0x16000000, 0xFF000000, 0, 0)
+INSTRUCTION(NOT_B,          "NOT.b %b3",                2,  2, 0x17000000, 0xFFF00000, 0, 0)
+INSTRUCTION(NOT_W,          "NOT.w %w3",                2,  2, 0x17100000, 0xFFF00000, 0, 0)
+INSTRUCTION(NOT_L,          "NOT.l %l3",                2,  2, 0x17300000, 0xFFF80000, 0, 0)
+INSTRUCTION(EXTU_W,         "EXTU.w %w3",               2,  2, 0x17500000, 0xFFF00000, 0, 0)
+INSTRUCTION(EXTU_L,         "EXTU.l %l3",               2,  2, 0x17700000, 0xFFF80000, 0, 0)
+INSTRUCTION(NEG_B,          "NEG.b %b3",                2,  2, 0x17800000, 0xFFF00000, 0, 0)
+INSTRUCTION(NEG_W,          "NEG.w %w3",                2,  2, 0x17900000, 0xFFF00000, 0, 0)
+INSTRUCTION(NEG_L,          "NEG.l %l3",                2,  2, 0x17B00000, 0xFFF80000, 0, 0)
+INSTRUCTION(EXTS_W,         "EXTS.w %w3",               2,  2, 0x17D00000, 0xFFF00000, 0, 0)
+INSTRUCTION(EXTS_L,         "EXTS.l %l3",               2,  2, 0x17F00000, 0xFFF80000, 0, 0)
+INSTRUCTION(SUB_B_R_R,      "SUB.b %b2, %b3",           2,  2, 0x18000000, 0xFF000000, 0, 0)
+INSTRUCTION(SUB_W_R_R,      "SUB.w %w2, %w3",           2,  2, 0x19000000, 0xFF000000, 0, 0)
+INSTRUCTION(DEC_B,          "DEC.b %b3",                2,  2, 0x1A000000, 0xFFF00000, 0, 0)
+INSTRUCTION(SUB_L_R_R,      "SUB.l %l2, %l3",           2,  2, 0x1A800000, 0xFF880000, 0, 0)
+INSTRUCTION(SUBS_1,         "SUBS.l #1, %l3",           2,  2, 0x1B000000, 0xFFF80000, 0, 0)
+INSTRUCTION(SUBS_2,         "SUBS.l #2, %l3",           2,  2, 0x1B800000, 0xFFF80000, 0, 0)
+INSTRUCTION(SUBS_4,         "SUBS.l #4, %l3",           2,  2, 0x1B900000, 0xFFF80000, 0, 0)
+INSTRUCTION(DEC_W_1,        "DEC.w #1, %w3",            2,  2, 0x1B500000, 0xFFF00000, 0, 0)
+INSTRUCTION(DEC_L_1,        "DEC.l #1, %l3",            2,  2, 0x1B700000, 0xFFF80000, 0, 0)
+INSTRUCTION(DEC_W_2,        "DEC.w #2, %w3",            2,  2, 0x1BD00000, 0xFFF00000, 0, 0)
+INSTRUCTION(DEC_L_2,        "DEC.l #2, %l3",            2,  2, 0x1BF00000, 0xFFF80000, 0, 0)
+INSTRUCTION(CMP_B_R_R,      "CMP.b %b2, %b3",           2,  2, 0x1C000000, 0xFF000000, 0, 0)
+INSTRUCTION(CMP_W_R_R,      "CMP.w %w2, %w3",           2,  2, 0x1D000000, 0xFF000000, 0, 0)
+INSTRUCTION(SUBX_R_R,       "SUBX %b2, %b3",            2,  2, 0x1E000000, 0xFF000000, 0, 0)
+INSTRUCTION(DAS,            "DAS %b3",                  2,  2, 0x1F000000, 0xFFF00000, 0, 0)
+INSTRUCTION(CMP_L_R_R,      "CMP.l %l2, %l3",           2,  2, 0x1F800000, 0xFF880000, 0, 0)
+
+// 2x / 3x: MOV.B with @aa:8
+INSTRUCTION(MOV_B_ABS8_R,   "MOV.b %a1, %b1",           2,  4, 0x20000000, 0xF0000000, 0, 0)
+INSTRUCTION(MOV_B_R_ABS8,   "MOV.b %b1, %a1",           2,  4, 0x30000000, 0xF0000000, 0, 0)
+
+// 4x: Bcc d:8
+INSTRUCTION(BRA_8,          "BRA %d1",                  2,  4, 0x40000000, 0xFF000000, 0, 0)
+INSTRUCTION(BRN_8,          "BRN %d1",                  2,  4, 0x41000000, 0xFF000000, 0, 0)
+INSTRUCTION(BHI_8,          "BHI %d1",                  2,  4, 0x42000000, 0xFF000000, 0, 0)
+INSTRUCTION(BLS_8,          "BLS %d1",                  2,  4, 0x43000000, 0xFF000000, 0, 0)
+INSTRUCTION(BCC_8,          "BCC %d1",                  2,  4, 0x44000000, 0xFF000000, 0, 0)
+INSTRUCTION(BCS_8,          "BCS %d1",                  2,  4, 0x45000000, 0xFF000000, 0, 0)
+INSTRUCTION(BNE_8,          "BNE %d1",                  2,  4, 0x46000000, 0xFF000000, 0, 0)
+INSTRUCTION(BEQ_8,          "BEQ %d1",                  2,  4, 0x47000000, 0xFF000000, 0, 0)
+INSTRUCTION(BVC_8,          "BVC %d1",                  2,  4, 0x48000000, 0xFF000000, 0, 0)
+INSTRUCTION(BVS_8,          "BVS %d1",                  2,  4, 0x49000000, 0xFF000000, 0, 0)
+INSTRUCTION(BPL_8,          "BPL %d1",                  2,  4, 0x4A000000, 0xFF000000, 0, 0)
+INSTRUCTION(BMI_8,          "BMI %d1",                  2,  4, 0x4B000000, 0xFF000000, 0, 0)
+INSTRUCTION(BGE_8,          "BGE %d1",                  2,  4, 0x4C000000, 0xFF000000, 0, 0)
+INSTRUCTION(BLT_8,          "BLT %d1",                  2,  4, 0x4D000000, 0xFF000000, 0, 0)
+INSTRUCTION(BGT_8,          "BGT %d1",                  2,  4, 0x4E000000, 0xFF000000, 0, 0)
+INSTRUCTION(BLE_8,          "BLE %d1",                  2,  4, 0x4F000000, 0xFF000000, 0, 0)
+
+// 5x: MULXU, DIVXU, subroutines, Bcc d:16, jumps
+INSTRUCTION(MULXU_B,        "MULXU.b %b2, %w3",         2, 14, 0x50000000, 0xFF000000, 0, 0)
+INSTRUCTION(DIVXU_B,        "DIVXU.b %b2, %w3",         2, 14, 0x51000000, 0xFF000000, 0, 0)
+INSTRUCTION(MULXU_W,        "MULXU.w %w2, %l3",         2, 22, 0x52000000, 0xFF080000, 0, 0)
+INSTRUCTION(DIVXU_W,        "DIVXU.w %w2, %l3",         2, 22, 0x53000000, 0xFF080000, 0, 0)
+INSTRUCTION(RTS,            "RTS",                      2,  8, 0x54700000, 0xFFFF0000, 0, 0)
+INSTRUCTION(BSR_8,          "BSR %d1",                  2,  6, 0x55000000, 0xFF000000, 0, 0)
+INSTRUCTION(RTE,            "RTE",                      2, 10, 0x56700000, 0xFFFF0000, 0, 0)
+INSTRUCTION(TRAPA,          "TRAPA %i2",                2, 14, 0x57000000, 0xFFCF0000, 0, 0)
+INSTRUCTION(BRA_16,         "BRA %D2",                  4,  6, 0x58000000, 0xFFFF0000, 0, 0)
+INSTRUCTION(BRN_16,         "BRN %D2",                  4,  6, 0x58100000, 0xFFFF0000, 0, 0)
+INSTRUCTION(BHI_16,         "BHI %D2",                  4,  6, 0x58200000, 0xFFFF0000, 0, 0)
+INSTRUCTION(BLS_16,         "BLS %D2",                  4,  6, 0x58300000, 0xFFFF0000, 0, 0)
+INSTRUCTION(BCC_16,         "BCC %D2",                  4,  6, 0x58400000, 0xFFFF0000, 0, 0)
+INSTRUCTION(BCS_16,         "BCS %D2",                  4,  6, 0x58500000, 0xFFFF0000, 0, 0)
+INSTRUCTION(BNE_16,         "BNE %D2",                  4,  6, 0x58600000, 0xFFFF0000, 0, 0)
+INSTRUCTION(BEQ_16,         "BEQ %D2",                  4,  6, 0x58700000, 0xFFFF0000, 0, 0)
+INSTRUCTION(BVC_16,         "BVC %D2",                  4,  6, 0x58800000, 0xFFFF0000, 0, 0)
+INSTRUCTION(BVS_16,         "BVS %D2",                  4,  6, 0x58900000, 0xFFFF0000, 0, 0)
+INSTRUCTION(BPL_16,         "BPL %D2",                  4,  6, 0x58A00000, 0xFFFF0000, 0, 0)
+INSTRUCTION(BMI_16,         "BMI %D2",                  4,  6, 0x58B00000, 0xFFFF0000, 0, 0)
+INSTRUCTION(BGE_16,         "BGE %D2",                  4,  6, 0x58C00000, 0xFFFF0000, 0, 0)
+INSTRUCTION(BLT_16,         "BLT %D2",                  4,  6, 0x58D00000, 0xFFFF0000, 0, 0)
+INSTRUCTION(BGT_16,         "BGT %D2",                  4,  6, 0x58E00000, 0xFFFF0000, 0, 0)
+INSTRUCTION(BLE_16,         "BLE %D2",                  4,  6, 0x58F00000, 0xFFFF0000, 0, 0)
+INSTRUCTION(JMP_IND,        "JMP @%l2",                 2,  4, 0x59000000, 0xFF8F0000, 0, 0)
+INSTRUCTION(JMP_ABS24,      "JMP %x1",                  4,  6, 0x5A000000, 0xFF000000, 0, 0)
+INSTRUCTION(JMP_MEM_IND,    "JMP @%a1",                 2,  8, 0x5B000000, 0xFF000000, 0, 0)
+INSTRUCTION(BSR_16,         "BSR %D2",                  4,  8, 0x5C000000, 0xFFFF0000, 0, 0)
+INSTRUCTION(JSR_IND,        "JSR @%l2",                 2,  6, 0x5D000000, 0xFF8F0000, 0, 0)
+INSTRUCTION(JSR_ABS24,      "JSR %x1",                  4,  8, 0x5E000000, 0xFF000000, 0, 0)
+INSTRUCTION(JSR_MEM_IND,    "JSR @%a1",                 2,  8, 0x5F000000, 0xFF000000, 0, 0)
+
+// 6x: bit ops on registers, word logic ops, MOV.B / MOV.W with memory
+INSTRUCTION(BSET_R_R,       "BSET %b2, %b3",            2,  2, 0x60000000, 0xFF000000, 0, 0)
+INSTRUCTION(BNOT_R_R,       "BNOT %b2, %b3",            2,  2, 0x61000000, 0xFF000000, 0, 0)
+INSTRUCTION(BCLR_R_R,       "BCLR %b2, %b3",            2,  2, 0x62000000, 0xFF000000, 0, 0)
+INSTRUCTION(BTST_R_R,       "BTST %b2, %b3",            2,  2, 0x63000000, 0xFF000000, 0, 0)
+INSTRUCTION(OR_W_R_R,       "OR.w %w2, %w3",            2,  2, 0x64000000, 0xFF000000, 0, 0)
+INSTRUCTION(XOR_W_R_R,      "XOR.w %w2, %w3",           2,  2, 0x65000000, 0xFF000000, 0, 0)
+INSTRUCTION(AND_W_R_R,      "AND.w %w2, %w3",           2,  2, 0x66000000, 0xFF000000, 0, 0)
+INSTRUCTION(BST_R,          "BST %i2, %b3",             2,  2, 0x67000000, 0xFF800000, 0, 0)
+INSTRUCTION(BIST_R,         "BIST %i2, %b3",            2,  2, 0x67800000, 0xFF800000, 0, 0)
+INSTRUCTION(MOV_B_IND_R,    "MOV.b @%l2, %b3",          2,  4, 0x68000000, 0xFF800000, 0, 0)
+INSTRUCTION(MOV_B_R_IND,    "MOV.b %b3, @%l2",          2,  4, 0x68800000, 0xFF800000, 0, 0)
+INSTRUCTION(MOV_W_IND_R,    "MOV.w @%l2, %w3",          2,  4, 0x69000000, 0xFF800000, 0, 0)
+INSTRUCTION(MOV_W_R_IND,    "MOV.w %w3, @%l2",          2,  4, 0x69800000, 0xFF800000, 0, 0)
+INSTRUCTION(MOV_B_ABS16_R,  "MOV.b %A2, %b3",           4,  6, 0x6A000000, 0xFFF00000, 0, 0)
+INSTRUCTION(MOV_B_ABS24_R,  "MOV.b %x3, %b3",           6,  8, 0x6A200000, 0xFFF00000, 0, 0)
+INSTRUCTION(MOV_B_R_ABS16,  "MOV.b %b3, %A2",           4,  6, 0x6A800000, 0xFFF00000, 0, 0)
+INSTRUCTION(MOV_B_R_ABS24,  "MOV.b %b3, %x3",           6,  8, 0x6AA00000, 0xFFF00000, 0, 0)
+INSTRUCTION(MOV_W_ABS16_R,  "MOV.w %A2, %w3",           4,  6, 0x6B000000, 0xFFF00000, 0, 0)
+INSTRUCTION(MOV_W_ABS24_R,  "MOV.w %x3, %w3",           6,  8, 0x6B200000, 0xFFF00000, 0, 0)
+INSTRUCTION(MOV_W_R_ABS16,  "MOV.w %w3, %A2",           4,  6, 0x6B800000, 0xFFF00000, 0, 0)
+INSTRUCTION(MOV_W_R_ABS24,  "MOV.w %w3, %x3",           6,  8, 0x6BA00000, 0xFFF00000, 0, 0)
+INSTRUCTION(MOV_B_POSTINC_R,"MOV.b @%l2+, %b3",         2,  6, 0x6C000000, 0xFF800000, 0, 0)
+INSTRUCTION(MOV_B_R_PREDEC, "MOV.b %b3, @-%l2",         2,  6, 0x6C800000, 0xFF800000, 0, 0)
+INSTRUCTION(MOV_W_POSTINC_R,"MOV.w @%l2+, %w3",         2,  6, 0x6D000000, 0xFF800000, 0, 0)
+INSTRUCTION(MOV_W_R_PREDEC, "MOV.w %w3, @-%l2",         2,  6, 0x6D800000, 0xFF800000, 0, 0)
+INSTRUCTION(MOV_B_DISP16_R, "MOV.b @(%s2, %l2), %b3",   4,  6, 0x6E000000, 0xFF800000, 0, 0)
+INSTRUCTION(MOV_B_R_DISP16, "MOV.b %b3, @(%s2, %l2)",   4,  6, 0x6E800000, 0xFF800000, 0, 0)
+INSTRUCTION(MOV_W_DISP16_R, "MOV.w @(%s2, %l2), %w3",   4,  6, 0x6F000000, 0xFF800000, 0, 0)
+INSTRUCTION(MOV_W_R_DISP16, "MOV.w %w3, @(%s2, %l2)",   4,  6, 0x6F800000, 0xFF800000, 0, 0)
+
+// 7x: bit ops with immediates, MOV.B / MOV.W @(d:24), word and long immediates, EEPMOV, bit ops on memory
+INSTRUCTION(BSET_IMM_R,     "BSET %i2, %b3",            2,  2, 0x70000000, 0xFF800000, 0, 0)
+INSTRUCTION(BNOT_IMM_R,     "BNOT %i2, %b3",            2,  2, 0x71000000, 0xFF800000, 0, 0)
+INSTRUCTION(BCLR_IMM_R,     "BCLR %i2, %b3",            2,  2, 0x72000000, 0xFF800000, 0, 0)
+INSTRUCTION(BTST_IMM_R,     "BTST %i2, %b3",            2,  2, 0x73000000, 0xFF800000, 0, 0)
+INSTRUCTION(BOR_R,          "BOR %i2, %b3",             2,  2, 0x74000000, 0xFF800000, 0, 0)
+INSTRUCTION(BIOR_R,         "BIOR %i2, %b3",            2,  2, 0x74800000, 0xFF800000, 0, 0)
+INSTRUCTION(BXOR_R,         "BXOR %i2, %b3",            2,  2, 0x75000000, 0xFF800000, 0, 0)
+INSTRUCTION(BIXOR_R,        "BIXOR %i2, %b3",           2,  2, 0x75800000, 0xFF800000, 0, 0)
+INSTRUCTION(BAND_R,         "BAND %i2, %b3",            2,  2, 0x76000000, 0xFF800000, 0, 0)
+INSTRUCTION(BIAND_R,        "BIAND %i2, %b3",           2,  2, 0x76800000, 0xFF800000, 0, 0)
+INSTRUCTION(BLD_R,          "BLD %i2, %b3",             2,  2, 0x77000000, 0xFF800000, 0, 0)
+INSTRUCTION(BILD_R,         "BILD %i2, %b3",            2,  2, 0x77800000, 0xFF800000, 0, 0)
+INSTRUCTION(MOV_B_DISP24_R, "MOV.b @(%S5, %l2), %b7",   8, 10, 0x78006A20, 0xFF8FFFF0, 0, 0)
+INSTRUCTION(MOV_B_R_DISP24, "MOV.b %b7, @(%S5, %l2)",   8, 10, 0x78006AA0, 0xFF8FFFF0, 0, 0)
+INSTRUCTION(MOV_W_DISP24_R, "MOV.w @(%S5, %l2), %w7",   8, 10, 0x78006B20, 0xFF8FFFF0, 0, 0)
+INSTRUCTION(MOV_W_R_DISP24, "MOV.w %w7, @(%S5, %l2)",   8, 10, 0x78006BA0, 0xFF8FFFF0, 0, 0)
+INSTRUCTION(MOV_W_IMM,      "MOV.w %22, %w3",           4,  4, 0x79000000, 0xFFF00000, 0, 0)
+INSTRUCTION(ADD_W_IMM,      "ADD.w %22, %w3",           4,  4, 0x79100000, 0xFFF00000, 0, 0)
+INSTRUCTION(CMP_W_IMM,      "CMP.w %22, %w3",           4,  4, 0x79200000, 0xFFF00000, 0, 0)
+INSTRUCTION(SUB_W_IMM,      "SUB.w %22, %w3",           4,  4, 0x79300000, 0xFFF00000, 0, 0)
+INSTRUCTION(OR_W_IMM,       "OR.w %22, %w3",            4,  4, 0x79400000, 0xFFF00000, 0, 0)
+INSTRUCTION(XOR_W_IMM,      "XOR.w %22, %w3",           4,  4, 0x79500000, 0xFFF00000, 0, 0)
+INSTRUCTION(AND_W_IMM,      "AND.w %22, %w3",           4,  4, 0x79600000, 0xFFF00000, 0, 0)
+INSTRUCTION(MOV_L_IMM,      "MOV.l %42, %l3",           6,  6, 0x7A000000, 0xFFF80000, 0, 0)
+INSTRUCTION(ADD_L_IMM,      "ADD.l %42, %l3",           6,  6, 0x7A100000, 0xFFF80000, 0, 0)
+INSTRUCTION(CMP_L_IMM,      "CMP.l %42, %l3",           6,  6, 0x7A200000, 0xFFF80000, 0, 0)
+INSTRUCTION(SUB_L_IMM,      "SUB.l %42, %l3",           6,  6, 0x7A300000, 0xFFF80000, 0, 0)
+INSTRUCTION(OR_L_IMM,       "OR.l %42, %l3",            6,  6, 0x7A400000, 0xFFF80000, 0, 0)
+INSTRUCTION(XOR_L_IMM,      "XOR.l %42, %l3",           6,  6, 0x7A500000, 0xFFF80000, 0, 0)
+INSTRUCTION(AND_L_IMM,      "AND.l %42, %l3",           6,  6, 0x7A600000, 0xFFF80000, 0, 0)
+INSTRUCTION(EEPMOV_B,       "EEPMOV.b",                 4,  8, 0x7B5C598F, 0xFFFFFFFF, 0, 0)
+INSTRUCTION(EEPMOV_W,       "EEPMOV.w",                 4,  8, 0x7BD4598F, 0xFFFFFFFF, 0, 0)
+INSTRUCTION(BTST_R_IND,     "BTST %b6, @%l2",           4,  6, 0x7C006300, 0xFF8FFF0F, 0, 0)
+INSTRUCTION(BTST_IMM_IND,   "BTST %i6, @%l2",           4,  6, 0x7C007300, 0xFF8FFF8F, 0, 0)
+INSTRUCTION(BOR_IND,        "BOR %i6, @%l2",            4,  6, 0x7C007400, 0xFF8FFF8F, 0, 0)
+INSTRUCTION(BIOR_IND,       "BIOR %i6, @%l2",           4,  6, 0x7C007480, 0xFF8FFF8F, 0, 0)
+INSTRUCTION(BXOR_IND,       "BXOR %i6, @%l2",           4,  6, 0x7C007500, 0xFF8FFF8F, 0, 0)
+INSTRUCTION(BIXOR_IND,      "BIXOR %i6, @%l2",          4,  6, 0x7C007580, 0xFF8FFF8F, 0, 0)
+INSTRUCTION(BAND_IND,       "BAND %i6, @%l2",           4,  6, 0x7C007600, 0xFF8FFF8F, 0, 0)
+INSTRUCTION(BIAND_IND,      "BIAND %i6, @%l2",          4,  6, 0x7C007680, 0xFF8FFF8F, 0, 0)
+INSTRUCTION(BLD_IND,        "BLD %i6, @%l2",            4,  6, 0x7C007700, 0xFF8FFF8F, 0, 0)
+INSTRUCTION(BILD_IND,       "BILD %i6, @%l2",           4,  6, 0x7C007780, 0xFF8FFF8F, 0, 0)
+INSTRUCTION(BSET_R_IND,     "BSET %b6, @%l2",           4,  8, 0x7D006000, 0xFF8FFF0F, 0, 0)
+INSTRUCTION(BNOT_R_IND,     "BNOT %b6, @%l2",           4,  8, 0x7D006100, 0xFF8FFF0F, 0, 0)
+INSTRUCTION(BCLR_R_IND,     "BCLR %b6, @%l2",           4,  8, 0x7D006200, 0xFF8FFF0F, 0, 0)
+INSTRUCTION(BST_IND,        "BST %i6, @%l2",            4,  8, 0x7D006700, 0xFF8FFF8F, 0, 0)
+INSTRUCTION(BIST_IND,       "BIST %i6, @%l2",           4,  8, 0x7D006780, 0xFF8FFF8F, 0, 0)
+INSTRUCTION(BSET_IMM_IND,   "BSET %i6, @%l2",           4,  8, 0x7D007000, 0xFF8FFF8F, 0, 0)
+INSTRUCTION(BNOT_IMM_IND,   "BNOT %i6, @%l2",           4,  8, 0x7D007100, 0xFF8FFF8F, 0, 0)
+INSTRUCTION(BCLR_IMM_IND,   "BCLR %i6, @%l2",           4,  8, 0x7D007200, 0xFF8FFF8F, 0, 0)
+INSTRUCTION(BTST_R_ABS8,    "BTST %b6, %a1",            4,  6, 0x7E006300, 0xFF00FF0F, 0, 0)
+INSTRUCTION(BTST_IMM_ABS8,  "BTST %i6, %a1",            4,  6, 0x7E007300, 0xFF00FF8F, 0, 0)
+INSTRUCTION(BOR_ABS8,       "BOR %i6, %a1",             4,  6, 0x7E007400, 0xFF00FF8F, 0, 0)
+INSTRUCTION(BIOR_ABS8,      "BIOR %i6, %a1",            4,  6, 0x7E007480, 0xFF00FF8F, 0, 0)
+INSTRUCTION(BXOR_ABS8,      "BXOR %i6, %a1",            4,  6, 0x7E007500, 0xFF00FF8F, 0, 0)
+INSTRUCTION(BIXOR_ABS8,     "BIXOR %i6, %a1",           4,  6, 0x7E007580, 0xFF00FF8F, 0, 0)
+INSTRUCTION(BAND_ABS8,      "BAND %i6, %a1",            4,  6, 0x7E007600, 0xFF00FF8F, 0, 0)
+INSTRUCTION(BIAND_ABS8,     "BIAND %i6, %a1",           4,  6, 0x7E007680, 0xFF00FF8F, 0, 0)
+INSTRUCTION(BLD_ABS8,       "BLD %i6, %a1",             4,  6, 0x7E007700, 0xFF00FF8F, 0, 0)
+INSTRUCTION(BILD_ABS8,      "BILD %i6, %a1",            4,  6, 0x7E007780, 0xFF00FF8F, 0, 0)
+INSTRUCTION(BSET_R_ABS8,    "BSET %b6, %a1",            4,  8, 0x7F006000, 0xFF00FF0F, 0, 0)
+INSTRUCTION(BNOT_R_ABS8,    "BNOT %b6, %a1",            4,  8, 0x7F006100, 0xFF00FF0F, 0, 0)
+INSTRUCTION(BCLR_R_ABS8,    "BCLR %b6, %a1",            4,  8, 0x7F006200, 0xFF00FF0F, 0, 0)
+INSTRUCTION(BST_ABS8,       "BST %i6, %a1",             4,  8, 0x7F006700, 0xFF00FF8F, 0, 0)
+INSTRUCTION(BIST_ABS8,      "BIST %i6, %a1",            4,  8, 0x7F006780, 0xFF00FF8F, 0, 0)
+INSTRUCTION(BSET_IMM_ABS8,  "BSET %i6, %a1",            4,  8, 0x7F007000, 0xFF00FF8F, 0, 0)
+INSTRUCTION(BNOT_IMM_ABS8,  "BNOT %i6, %a1",            4,  8, 0x7F007100, 0xFF00FF8F, 0, 0)
+INSTRUCTION(BCLR_IMM_ABS8,  "BCLR %i6, %a1",            4,  8, 0x7F007200, 0xFF00FF8F, 0, 0)
+
+// 8x - Fx: byte immediates
+INSTRUCTION(ADD_B_IMM,      "ADD.b %11, %b1",           2,  2, 0x80000000, 0xF0000000, 0, 0)
+INSTRUCTION(ADDX_IMM,       "ADDX %11, %b1",            2,  2, 0x90000000, 0xF0000000, 0, 0)
+INSTRUCTION(CMP_B_IMM,      "CMP.b %11, %b1",           2,  2, 0xA0000000, 0xF0000000, 0, 0)
+INSTRUCTION(SUBX_IMM,       "SUBX %11, %b1",            2,  2, 0xB0000000, 0xF0000000, 0, 0)
+INSTRUCTION(OR_B_IMM,       "OR.b %11, %b1",            2,  2, 0xC0000000, 0xF0000000, 0, 0)
+INSTRUCTION(XOR_B_IMM,      "XOR.b %11, %b1",           2,  2, 0xD0000000, 0xF0000000, 0, 0)
+INSTRUCTION(AND_B_IMM,      "AND.b %11, %b1",           2,  2, 0xE0000000, 0xF0000000, 0, 0)
+INSTRUCTION(MOV_B_IMM,      "MOV.b %11, %b1",           2,  2, 0xF0000000, 0xF0000000, 0, 0)
@@ -0,0 +1,70 @@
+// Interrupts. A source raises its flag bit in a request register, and once it's also enabled it gets taken between
+// instructions as soon as the I flag allows. Nothing is checked per instruction: whatever can make an interrupt due
+// (an input, a write to the enable or flag registers, a change to the CCR) calls checkInterrupts, and serviceEvents
+// looks at the sources after the current instruction.
+// SLEEP stops the CPU until an enabled request shows up. Time skips straight to the next event that could bring one,
+// so a scripted button press wakes it right away, however far in the future it is.
+// Normal mode exception frame: return address at SP + 2, CCR at SP (in both bytes), 16 bit vectors.
+
+#define IENR1 0xFFF3 // Interrupt enable register 1, IENWP (wakeup interrupts) is bit 5
+#define IWPR 0xFFF9 // Wakeup request flags, one per WKP pin, cleared by writing 0
+#define RTCFLG 0xF067 // Real time clock flags, cleared by writing 0
+#define RTCCR2 0xF06D // Real time clock interrupt enables, one per RTCFLG bit
+#define VECTOR_TRAPA 8 // TRAPA #0 - #3 use 8 - 11
+#define VECTOR_RTC 16
+#define VECTOR_WAKEUP 20 // WKP0 - WKP7 share one vector
+#define EXCEPTION_STATES 14
+
+struct InterruptSource{
+	uint16_t flagRegister;
+	uint8_t flagMask;
+	uint16_t enableRegister;
+	uint8_t enableMask; // 0 when the enable register has one bit per flag
+	uint8_t vector;
+};
+
+// Highest priority first
+static const struct InterruptSource interruptSources[] = {
+	{IWPR, 0xFF, IENR1, 0x20, VECTOR_WAKEUP},
+	{RTCFLG, 0x7F, RTCCR2, 0, VECTOR_RTC},
+};
+#define INTERRUPT_SOURCE_COUNT (sizeof(interruptSources) / sizeof(interruptSources[0]))
+
+static bool sleeping; // pc stays on the SLEEP instruction until something wakes us up
+
+void checkInterrupts(){
+	nextEventCycle = 0;
+}
+
+// Pushes the return address and CCR, masks interrupts, returns where the vector points
+uint32_t takeException(int vector, uint32_t returnAddress){
+	uint8_t ccr = getCCR();
+	*SP -= 2;
+	setMemory16(*SP, returnAddress);
+	*SP -= 2;
+	setMemory16(*SP, (ccr << 8) | ccr);
+	flags.I = true;
+	return getMemory16(vector * 2);
+}
+
+// Called from serviceEvents
+void serviceInterrupts(){
+	for(int i = 0; i < INTERRUPT_SOURCE_COUNT; i++){
+		const struct InterruptSource* source = &interruptSources[i];
+		uint8_t enabled = memory[source->enableRegister];
+		if (source->enableMask){
+			enabled = (enabled & source->enableMask) ? 0xFF : 0;
+		}
+		if (memory[source->flagRegister] & source->flagMask & enabled){
+			if (sleeping){
+				sleeping = false; // Woken up even with interrupts masked, carries on after the SLEEP
+				pc = (pc + 2) & ADDRESS_MASK; // Past the SLEEP
+			}
+			if (!flags.I){
+				pc = takeException(source->vector, pc);
+				cycles += EXCEPTION_STATES;
+			}
+			return;
+		}
+	}
+}
@@ -0,0 +1,685 @@
+// Lane engine for input sweeps. -L file runs the ROM once per input journal listed in file (one path per line),
+// all of them side by side. Registers and flags live in structure-of-arrays form, one array per register across
+// the lanes, so while a big enough group of lanes sits on the same pc a register-only ALU instruction runs as a
+// single loop over the lanes that the compiler turns into SIMD (only in an optimized build, /O2 or -O3). Loads from
+// fixed addresses and Bcc also stay on that path. Anything else (stores, calls, devices) and lanes that went their own
+// way run one at a time through executeInstruction, with the lane swapped into the globals.
+// When it's done the sweep runs again one lane after the other, to check both agree and to report what batching gained.
+//
+// Each lane has its own copy of the on-chip memory, but only the RAM and registers (0xF000 up) are switched between
+// lanes: the ROM pages stay on the shared image and off-chip blocks are shared too. Breakpoints, watchpoints, the
+// rewind buffer, the hang report, coverage and the debugger don't apply to lanes. Neither does SLEEP, a lane that gets there stops.
+#include <time.h>
+
+#define MAX_LANES 4096
+#define LANE_WINDOW 0xF000 // Start of the per lane part of the on-chip memory
+
+static int laneCount;
+static uint32_t laneRegisters[8][MAX_LANES];
+static uint8_t laneH[MAX_LANES];
+static uint8_t laneN[MAX_LANES];
+static uint8_t laneZ[MAX_LANES];
+static uint8_t laneV[MAX_LANES];
+static uint8_t laneC[MAX_LANES];
+static uint8_t laneCCR[MAX_LANES]; // I, UI and U, the ALU doesn't touch these
+static uint32_t lanePc[MAX_LANES];
+static uint64_t laneCycles[MAX_LANES];
+static uint64_t laneInstructions[MAX_LANES];
+static uint8_t laneRunning[MAX_LANES];
+static uint8_t laneMask[MAX_LANES]; // Lanes taking part in the current SIMD pass
+static uint8_t laneAttention[MAX_LANES]; // Lanes that have something due before their next instruction
+static uint64_t laneNextEvent[MAX_LANES]; // Earliest of the next input, clock tick, watchdog expiry and the cycle limit
+static int laneWaited[MAX_LANES]; // Rounds since the lane last moved
+static uint32_t laneLoaded[MAX_LANES];
+
+// The rest of a lane, only needed when it runs on its own
+struct Lane{
+	const char* journalPath;
+	uint8_t* memory;
+	uint8_t accel[29];
+	uint8_t ssuBuffer[2];
+	uint8_t ssuShift;
+	struct Port ports[PORT_COUNT];
+	struct Rtc rtc;
+	struct Watchdog watchdog;
+	uint8_t* replayData;
+	long replaySize;
+	long replayPosition;
+	uint64_t nextReplayCycle;
+	const char* stopReason;
+	uint64_t stateHash;
+};
+static struct Lane lanes[MAX_LANES];
+static uint8_t* laneImage; // On-chip memory as loaded, every lane starts from a copy
+static uint8_t laneImageAccel[29];
+static struct Port laneImagePorts[PORT_COUNT];
+static struct Rtc laneImageRtc;
+static struct Watchdog laneImageWatchdog;
+static bool laneDevicePages[BLOCK_SIZE >> PAGE_SHIFT]; // Writes to these still go through the slow path
+static uint32_t laneEntry;
+
+// Lanes grouped by pc for the current round. A group is a linked list through laneNext.
+static int groupCount;
+static uint32_t groupPc[MAX_LANES];
+static int groupSize[MAX_LANES];
+static int groupFirst[MAX_LANES];
+static int groupSlot[MAX_LANES];
+static int laneNext[MAX_LANES];
+static int pcSlots[4 * MAX_LANES]; // Open addressing, group index + 1, 0 when free
+
+static uint64_t simdLaneInstructions;
+static uint64_t simdPasses;
+static uint64_t scalarLaneInstructions;
+
+// Only the pages above LANE_WINDOW change, and only device registers need the slow path
+void switchMemory(uint8_t* backing){
+	memory = backing;
+	blocks[0x00] = backing;
+	blocks[0xFF] = backing;
+	int highBlock = 0xFF << (BLOCK_SHIFT - PAGE_SHIFT);
+	for(int page = LANE_WINDOW >> PAGE_SHIFT; page < (BLOCK_SIZE >> PAGE_SHIFT); page++){
+		uint8_t* pageMemory = backing + (page << PAGE_SHIFT);
+		readPages[page] = readPages[highBlock + page] = pageMemory;
+		writePages[page] = writePages[highBlock + page] = laneDevicePages[page] ? NULL : pageMemory;
+	}
+	mapSSURegisters();
+}
+
+void enterLane(int lane){
+	struct Lane* state = &lanes[lane];
+	for(int i = 0; i < 8; i++){
+		*ER[i] = laneRegisters[i][lane];
+	}
+	setCCR(laneCCR[lane] | (laneH[lane] << 5) | (laneN[lane] << 3) | (laneZ[lane] << 2) | (laneV[lane] << 1) | laneC[lane]);
+	pc = lanePc[lane];
+	cycles = laneCycles[lane];
+	instructions = laneInstructions[lane];
+	switchMemory(state->memory);
+	accel_memory = state->accel;
+	memcpy(ssuBuffer, state->ssuBuffer, 2);
+	SSU.SSTRSR = state->ssuShift;
+	memcpy(ports, state->ports, sizeof(ports));
+	rtc = state->rtc;
+	watchdog = state->watchdog;
+	replayData = state->replayData;
+	replaySize = state->replaySize;
+	replayPosition = state->replayPosition;
+	nextReplayCycle = state->nextReplayCycle;
+}
+
+void leaveLane(int lane){
+	struct Lane* state = &lanes[lane];
+	for(int i = 0; i < 8; i++){
+		laneRegisters[i][lane] = *ER[i];
+	}
+	uint8_t ccr = getCCR();
+	laneCCR[lane] = ccr & 0xD0;
+	laneH[lane] = flags.H;
+	laneN[lane] = flags.N;
+	laneZ[lane] = flags.Z;
+	laneV[lane] = flags.V;
+	laneC[lane] = flags.C;
+	lanePc[lane] = pc;
+	laneCycles[lane] = cycles;
+	laneInstructions[lane] = instructions;
+	memcpy(state->ssuBuffer, ssuBuffer, 2);
+	state->ssuShift = SSU.SSTRSR;
+	memcpy(state->ports, ports, sizeof(ports));
+	state->rtc = rtc;
+	state->watchdog = watchdog;
+	state->replayPosition = replayPosition;
+	state->nextReplayCycle = nextReplayCycle;
+}
+
+void stopLane(int lane, const char* reason){
+	lanes[lane].stopReason = reason;
+	laneRunning[lane] = 0;
+}
+
+// What the main loop does between two instructions, in the same order: inputs, clock and limits, then stop addresses
+void serviceLane(int lane){
+	struct Lane* state = &lanes[lane];
+	uint64_t next = (state->nextReplayCycle < state->rtc.nextTick) ? state->nextReplayCycle : state->rtc.nextTick;
+	next = (state->watchdog.expiry < next) ? state->watchdog.expiry : next;
+	if (next <= laneCycles[lane]){
+		enterLane(lane);
+		replayInputs();
+		serviceRtc();
+		serviceWatchdog();
+		serviceInterrupts();
+		serviceSSU(); // Stands in for the one the next instruction runs, in case that one goes down the SIMD path
+		leaveLane(lane);
+	}
+	next = (state->nextReplayCycle < state->rtc.nextTick) ? state->nextReplayCycle : state->rtc.nextTick;
+	next = (state->watchdog.expiry < next) ? state->watchdog.expiry : next;
+	laneNextEvent[lane] = (cycleLimit < next) ? cycleLimit : next;
+	uint32_t at = lanePc[lane];
+	if (laneInstructions[lane] >= instructionLimit){
+		stopLane(lane, "instruction limit");
+	} else if (laneCycles[lane] >= cycleLimit){
+		stopLane(lane, "cycle limit");
+	} else if (testBit(breakpoints, at) && (at == stopAtPc || at == imageEnd)){
+		stopLane(lane, (at == stopAtPc) ? "stop address" : "end of image");
+	}
+}
+
+// Back to the state right after reset, with its journal rewound
+void resetLane(int lane){
+	struct Lane* state = &lanes[lane];
+	memcpy(state->memory, laneImage, BLOCK_SIZE + BLOCK_PADDING);
+	memcpy(state->accel, laneImageAccel, 29);
+	memset(state->ssuBuffer, 0xFF, 2);
+	state->ssuShift = 0;
+	memcpy(state->ports, laneImagePorts, sizeof(laneImagePorts));
+	state->rtc = laneImageRtc;
+	state->watchdog = laneImageWatchdog;
+	state->replayPosition = 4;
+	state->nextReplayCycle = 0;
+	state->stopReason = NULL;
+	for(int i = 0; i < 8; i++){
+		laneRegisters[i][lane] = 0;
+	}
+	laneCCR[lane] = laneH[lane] = laneN[lane] = laneZ[lane] = laneV[lane] = laneC[lane] = 0;
+	lanePc[lane] = laneEntry;
+	laneCycles[lane] = 0;
+	laneInstructions[lane] = 0;
+
+	laneRunning[lane] = 1;
+	laneWaited[lane] = 0;
+
+	enterLane(lane);
+	readNextReplayCycle();
+	leaveLane(lane);
+	serviceLane(lane); // Whatever is due before the first instruction
+}
+
+void runLaneScalar(int lane){
+	enterLane(lane);
+	executeInstruction();
+	if (sleeping){
+		stopReason = "SLEEP, lanes can't sleep";
+		sleeping = false;
+	}
+	serviceInterrupts(); // In case the instruction unmasked or enabled one
+	leaveLane(lane);
+	if (stopReason){
+		stopLane(lane, stopReason);
+		stopReason = NULL;
+	}
+	scalarLaneInstructions++;
+	laneWaited[lane] = 0;
+	if (laneRunning[lane]){
+		serviceLane(lane);
+	}
+}
+
+// The register-only instructions the SIMD path knows, everything else runs lane by lane
+enum LaneOp{
+	LANE_SCALAR,
+	LANE_MOV,
+	LANE_ADD,
+	LANE_SUB,
+	LANE_CMP,
+	LANE_AND,
+	LANE_OR,
+	LANE_XOR,
+	LANE_INC,
+	LANE_DEC,
+	LANE_ADDS,
+	LANE_SUBS,
+	LANE_LOAD, // MOV @aa, Rd from the on-chip memory, value is the address
+	LANE_BRANCH // Bcc, rd is the condition and value the target
+};
+
+struct LaneInstruction{
+	enum LaneOp op;
+	uint8_t bits;
+	uint8_t rs;
+	uint8_t rd;
+	bool immediate;
+	uint32_t value;
+};
+
+#define LANE_REGISTER_CASES(W, bits, rs, rd) \
+	case OP_MOV_##W##_R_R: return (struct LaneInstruction){LANE_MOV, bits, rs, rd}; \
+	case OP_ADD_##W##_R_R: return (struct LaneInstruction){LANE_ADD, bits, rs, rd}; \
+	case OP_SUB_##W##_R_R: return (struct LaneInstruction){LANE_SUB, bits, rs, rd}; \
+	case OP_CMP_##W##_R_R: return (struct LaneInstruction){LANE_CMP, bits, rs, rd};
+
+#define LANE_LOGIC_CASES(W, bits, rs, rd) \
+	case OP_AND_##W##_R_R: return (struct LaneInstruction){LANE_AND, bits, rs, rd}; \
+	case OP_OR_##W##_R_R: return (struct LaneInstruction){LANE_OR, bits, rs, rd}; \
+	case OP_XOR_##W##_R_R: return (struct LaneInstruction){LANE_XOR, bits, rs, rd};
+
+#define LANE_IMMEDIATE_CASES(W, bits, rd, imm) \
+	case OP_MOV_##W##_IMM: return (struct LaneInstruction){LANE_MOV, bits, 0, rd, true, imm}; \
+	case OP_ADD_##W##_IMM: return (struct LaneInstruction){LANE_ADD, bits, 0, rd, true, imm}; \
+	case OP_CMP_##W##_IMM: return (struct LaneInstruction){LANE_CMP, bits, 0, rd, true, imm}; \
+	case OP_AND_##W##_IMM: return (struct LaneInstruction){LANE_AND, bits, 0, rd, true, imm}; \
+	case OP_OR_##W##_IMM: return (struct LaneInstruction){LANE_OR, bits, 0, rd, true, imm}; \
+	case OP_XOR_##W##_IMM: return (struct LaneInstruction){LANE_XOR, bits, 0, rd, true, imm};
+
+struct LaneInstruction decodeLaneInstruction(enum InstructionId id, uint32_t at, const uint8_t* bytes){
+	uint8_t aL = bytes[0] & 0xF;
+	uint8_t b = bytes[1];
+	uint8_t bH = b >> 4;
+	uint8_t bL = b & 0xF;
+	uint8_t dH = bytes[3] >> 4;
+	uint8_t dL = bytes[3] & 0xF;
+	uint16_t cd = (bytes[2] << 8) | bytes[3];
+	uint32_t cdef = readBigEndian32(bytes + 2);
+	uint32_t next = at + instructionTable[id].length;
+	if (id >= OP_BRA_8 && id <= OP_BLE_8){
+		return (struct LaneInstruction){LANE_BRANCH, 0, 0, aL, true, (next + (int8_t)b) & ADDRESS_MASK};
+	}
+	if (id >= OP_BRA_16 && id <= OP_BLE_16){
+		return (struct LaneInstruction){LANE_BRANCH, 0, 0, bH, true, (next + (int16_t)cd) & ADDRESS_MASK};
+	}
+	switch(id){
+		LANE_REGISTER_CASES(B, 8, bH, bL)
+		LANE_REGISTER_CASES(W, 16, bH, bL)
+		LANE_REGISTER_CASES(L, 32, bH, bL)
+		LANE_LOGIC_CASES(B, 8, bH, bL)
+		LANE_LOGIC_CASES(W, 16, bH, bL)
+		LANE_LOGIC_CASES(L, 32, dH, dL)
+		LANE_IMMEDIATE_CASES(B, 8, aL, b)
+		LANE_IMMEDIATE_CASES(W, 16, bL, cd)
+		LANE_IMMEDIATE_CASES(L, 32, bL, cdef)
+		case OP_SUB_W_IMM: return (struct LaneInstruction){LANE_SUB, 16, 0, bL, true, cd};
+		case OP_SUB_L_IMM: return (struct LaneInstruction){LANE_SUB, 32, 0, bL, true, cdef};
+		case OP_INC_B: return (struct LaneInstruction){LANE_INC, 8, 0, bL, true, 1};
+		case OP_INC_W_1: return (struct LaneInstruction){LANE_INC, 16, 0, bL, true, 1};
+		case OP_INC_W_2: return (struct LaneInstruction){LANE_INC, 16, 0, bL, true, 2};
+		case OP_INC_L_1: return (struct LaneInstruction){LANE_INC, 32, 0, bL, true, 1};
+		case OP_INC_L_2: return (struct LaneInstruction){LANE_INC, 32, 0, bL, true, 2};
+		case OP_DEC_B: return (struct LaneInstruction){LANE_DEC, 8, 0, bL, true, 1};
+		case OP_DEC_W_1: return (struct LaneInstruction){LANE_DEC, 16, 0, bL, true, 1};
+		case OP_DEC_W_2: return (struct LaneInstruction){LANE_DEC, 16, 0, bL, true, 2};
+		case OP_DEC_L_1: return (struct LaneInstruction){LANE_DEC, 32, 0, bL, true, 1};
+		case OP_DEC_L_2: return (struct LaneInstruction){LANE_DEC, 32, 0, bL, true, 2};
+		case OP_ADDS_1: return (struct LaneInstruction){LANE_ADDS, 32, 0, bL, true, 1};
+		case OP_ADDS_2: return (struct LaneInstruction){LANE_ADDS, 32, 0, bL, true, 2};
+		case OP_ADDS_4: return (struct LaneInstruction){LANE_ADDS, 32, 0, bL, true, 4};
+		case OP_SUBS_1: return (struct LaneInstruction){LANE_SUBS, 32, 0, bL, true, 1};
+		case OP_SUBS_2: return (struct LaneInstruction){LANE_SUBS, 32, 0, bL, true, 2};
+		case OP_SUBS_4: return (struct LaneInstruction){LANE_SUBS, 32, 0, bL, true, 4};
+		case OP_MOV_B_ABS8_R: return (struct LaneInstruction){LANE_LOAD, 8, 0, aL, false, 0xFF00 | b};
+		case OP_MOV_B_ABS16_R: return (struct LaneInstruction){LANE_LOAD, 8, 0, bL, false, cd};
+		case OP_MOV_W_ABS16_R: return (struct LaneInstruction){LANE_LOAD, 16, 0, bL, false, cd};
+		default: return (struct LaneInstruction){LANE_SCALAR};
+	}
+}
+
+// Where a register operand sits inside its ER array entry, same numbering as getRegRef8/16/32
+int laneRegisterShift(int bits, uint8_t n){
+	if (bits == 8){
+		return (n & 0x8) ? 0 : 8;
+	} else if (bits == 16){
+		return (n & 0x8) ? 16 : 0;
+	}
+	return 0;
+}
+
+// One pass over every lane, lanes outside the mask keep what they had. Branch free so it vectorizes,
+// the flags come out exactly like the alu.c kernels. LANE_MOVE_PASS is for the ops that don't read the destination.
+#define LANE_FLAG(flag, value) flag[l] = on ? (uint8_t)((value) != 0) : flag[l];
+#define LANE_READ_DESTINATION uint32_t a = (destination[l] >> dShift) & valueMask;
+#define LANE_PASS(result, writeBack, flagUpdates) LANE_LOOP(LANE_READ_DESTINATION, result, writeBack, flagUpdates)
+#define LANE_MOVE_PASS(result, flagUpdates) LANE_LOOP(, result, true, flagUpdates)
+#define LANE_LOOP(readDestination, result, writeBack, flagUpdates) \
+	for(int l = 0; l < laneCount; l++){ \
+		readDestination \
+		uint32_t b = in->immediate ? in->value : (source[l] >> sShift) & valueMask; \
+		uint32_t r = (result) & valueMask; \
+		bool on = mask[l]; \
+		flagUpdates \
+		if (writeBack){ \
+			destination[l] = on ? ((destination[l] & ~(valueMask << dShift)) | (r << dShift)) : destination[l]; \
+		} \
+	}
+#define LANE_NZ LANE_FLAG(laneN, r & signBit) LANE_FLAG(laneZ, r == 0)
+
+void executeLaneGroup(const struct LaneInstruction* in, const uint8_t* mask){
+	uint32_t* destination = laneRegisters[in->rd & 0x7];
+	uint32_t* source = laneRegisters[in->rs & 0x7];
+	int dShift = laneRegisterShift(in->bits, in->rd);
+	int sShift = laneRegisterShift(in->bits, in->rs);
+	uint32_t valueMask = (in->bits == 32) ? 0xFFFFFFFF : (1u << in->bits) - 1;
+	uint32_t signBit = 1u << (in->bits - 1);
+	uint32_t halfMask = valueMask >> 4;
+	switch(in->op){
+		case LANE_MOV:{
+			LANE_MOVE_PASS(b, LANE_NZ LANE_FLAG(laneV, 0))
+		}break;
+		case LANE_ADD:{
+			LANE_PASS(a + b, true, LANE_NZ LANE_FLAG(laneH, (a & halfMask) + (b & halfMask) > halfMask)
+				LANE_FLAG(laneV, ~(a ^ b) & (a ^ r) & signBit) LANE_FLAG(laneC, r < a))
+		}break;
+		case LANE_SUB:{
+			LANE_PASS(a - b, true, LANE_NZ LANE_FLAG(laneH, (b & halfMask) > (a & halfMask))
+				LANE_FLAG(laneV, (a ^ b) & (a ^ r) & signBit) LANE_FLAG(laneC, b > a))
+		}break;
+		case LANE_CMP:{
+			LANE_PASS(a - b, false, LANE_NZ LANE_FLAG(laneH, (b & halfMask) > (a & halfMask))
+				LANE_FLAG(laneV, (a ^ b) & (a ^ r) & signBit) LANE_FLAG(laneC, b > a))
+		}break;
+		case LANE_AND:{
+			LANE_PASS(a & b, true, LANE_NZ LANE_FLAG(laneV, 0))
+		}break;
+		case LANE_OR:{
+			LANE_PASS(a | b, true, LANE_NZ LANE_FLAG(laneV, 0))
+		}break;
+		case LANE_XOR:{
+			LANE_PASS(a ^ b, true, LANE_NZ LANE_FLAG(laneV, 0))
+		}break;
+		case LANE_INC:{
+			LANE_PASS(a + b, true, LANE_NZ LANE_FLAG(laneV, ~a & r & signBit))
+		}break;
+		case LANE_DEC:{
+			LANE_PASS(a - b, true, LANE_NZ LANE_FLAG(laneV, a & ~r & signBit))
+		}break;
+		case LANE_ADDS:{
+			LANE_PASS(a + b, true, )
+		}break;
+		case LANE_SUBS:{
+			LANE_PASS(a - b, true, )
+		}break;
+		case LANE_LOAD:{ // A gather rather than SIMD, but it saves swapping every lane in for a load
+			uint16_t address = in->value;
+			for(int l = 0; l < laneCount; l++){
+				uint8_t* bytes = ((address >= LANE_WINDOW) ? lanes[l].memory : laneImage) + address;
+				laneLoaded[l] = (in->bits == 8) ? bytes[0] : (bytes[0] << 8) | bytes[1];
+			}
+			source = laneLoaded;
+			sShift = 0;
+			LANE_MOVE_PASS(b, LANE_NZ LANE_FLAG(laneV, 0))
+		}break;
+		case LANE_BRANCH: // Only moves pc, see runLaneRounds
+		case LANE_SCALAR:{
+		}break;
+	}
+}
+
+// testCondition without the switch: bit n of conditions is the condition for Bcc codes 2n and 2n + 1,
+// the odd codes are the opposite of the even ones
+static inline uint8_t laneTaken(uint8_t condition, int l){
+	uint8_t z = laneZ[l];
+	uint8_t lessThan = laneN[l] ^ laneV[l];
+	uint8_t conditions = 1 | (((laneC[l] | z) ^ 1) << 1) | ((laneC[l] ^ 1) << 2) | ((z ^ 1) << 3) | ((laneV[l] ^ 1) << 4) |
+		((laneN[l] ^ 1) << 5) | ((lessThan ^ 1) << 6) | (((z | lessThan) ^ 1) << 7);
+	return ((conditions >> (condition >> 1)) & 1) ^ (condition & 1);
+}
+
+// Moves the lanes in mask past an instruction the SIMD path ran and flags the ones that have something due
+void advanceLanes(const struct LaneInstruction* in, enum InstructionId id, uint32_t at, const uint8_t* mask){
+	uint32_t next = (at + instructionTable[id].length) & ADDRESS_MASK;
+	uint32_t target = (in->op == LANE_BRANCH) ? in->value : next;
+	uint8_t condition = (in->op == LANE_BRANCH) ? in->rd : 1; // BRN for everything else
+	uint8_t states = instructionTable[id].states;
+	for(int l = 0; l < laneCount; l++){
+		uint8_t on = mask[l];
+		lanePc[l] = on ? (laneTaken(condition, l) ? target : next) : lanePc[l];
+		laneCycles[l] += on ? states : 0;
+		laneInstructions[l] += on;
+		laneWaited[l] = on ? 0 : laneWaited[l];
+		laneAttention[l] = on & ((laneCycles[l] >= laneNextEvent[l]) | (laneInstructions[l] >= instructionLimit) |
+			(lanePc[l] == stopAtPc) | (lanePc[l] == imageEnd));
+	}
+	for(int l = 0; l < laneCount; l++){
+		if (laneAttention[l]){
+			serviceLane(l);
+		}
+	}
+}
+
+// Buckets the running lanes by pc, returns how many are still running
+int groupLanes(){
+	int running = 0;
+	int slotMask = 1;
+	while(slotMask < 2 * laneCount){
+		slotMask = slotMask * 2;
+	}
+	slotMask = slotMask - 1;
+	groupCount = 0;
+	for(int lane = 0; lane < laneCount; lane++){
+		if (!laneRunning[lane]){
+			continue;
+		}
+		running++;
+		uint32_t at = lanePc[lane];
+		int slot = (at * 2654435761u >> 8) & slotMask;
+		while(pcSlots[slot] && groupPc[pcSlots[slot] - 1] != at){
+			slot = (slot + 1) & slotMask;
+		}
+		if (!pcSlots[slot]){
+			groupPc[groupCount] = at;
+			groupSize[groupCount] = 0;
+			groupFirst[groupCount] = -1;
+			groupSlot[groupCount] = slot;
+			pcSlots[slot] = ++groupCount;
+		}
+		int group = pcSlots[slot] - 1;
+		laneNext[lane] = groupFirst[group];
+		groupFirst[group] = lane;
+		groupSize[group]++;
+	}
+	for(int group = 0; group < groupCount; group++){
+		pcSlots[groupSlot[group]] = 0;
+	}
+	return running;
+}
+
+// Lanes are kept together the way GPUs do it: each round only the lanes at the lowest pc move, the ones that went
+// ahead wait for the others to catch up, so a group split by a forward branch meets again where the paths join.
+// Nobody waits more than LANE_MAX_WAIT rounds in a row though, or a lane spinning in a low loop would hold everyone up.
+// A group goes down the SIMD path when it holds at least a quarter of the running lanes, below that a pass over
+// every lane costs more than swapping the group in lane by lane.
+// The SIMD path skips the SSU step that follows every instruction, it would see nothing new: the instructions it
+// handles don't write memory, and serviceLane runs the step after inputs. Reset state hasn't been through it yet,
+// so the first round always runs lane by lane.
+#define LANE_MAX_WAIT 256
+
+// Runs the lanes in mask through the instruction at at, together if the SIMD path knows it
+void runLaneGroup(uint32_t at, const uint8_t* mask, int size, int running, bool allowSimd){
+	struct LaneInstruction in = {LANE_SCALAR};
+	enum InstructionId id = OP_UNKNOWN;
+	if (allowSimd && size > 1 && size * 4 >= running && at < LANE_WINDOW){
+		id = decodeInstruction(laneImage + at);
+		in = decodeLaneInstruction(id, at, laneImage + at);
+	}
+	if (in.op == LANE_SCALAR){
+		for(int lane = 0; lane < laneCount; lane++){
+			if (mask[lane]){
+				runLaneScalar(lane);
+			}
+		}
+		return;
+	}
+	executeLaneGroup(&in, mask);
+	advanceLanes(&in, id, at, mask);
+	simdLaneInstructions += size;
+	simdPasses++;
+}
+
+void runLaneRounds(){
+	for(uint64_t round = 0;; round++){
+		// Usually everybody is in step, that doesn't need any grouping
+		int running = 0;
+		int first = -1;
+		uint8_t diverged = 0;
+		for(int lane = 0; lane < laneCount; lane++){
+			running += laneRunning[lane];
+			if (first < 0 && laneRunning[lane]){
+				first = lane;
+			}
+		}
+		if (!running){
+			return;
+		}
+		uint32_t firstPc = lanePc[first];
+		for(int lane = 0; lane < laneCount; lane++){
+			diverged |= laneRunning[lane] & (lanePc[lane] != firstPc);
+		}
+		if (!diverged){
+			runLaneGroup(firstPc, laneRunning, running, running, round > 0);
+			continue;
+		}
+
+		groupLanes();
+		uint32_t lowestPc = 0xFFFFFFFF;
+		for(int group = 0; group < groupCount; group++){
+			if (groupPc[group] < lowestPc){
+				lowestPc = groupPc[group];
+			}
+		}
+		for(int group = 0; group < groupCount; group++){
+			int head = groupFirst[group];
+			if (groupPc[group] != lowestPc && laneWaited[head] < LANE_MAX_WAIT){
+				for(int lane = head; lane >= 0; lane = laneNext[lane]){
+					laneWaited[lane]++;
+				}
+				continue;
+			}
+			for(int lane = head; lane >= 0; lane = laneNext[lane]){
+				laneMask[lane] = 1;
+			}
+			runLaneGroup(groupPc[group], laneMask, groupSize[group], running, round > 0);
+			for(int lane = head; lane >= 0; lane = laneNext[lane]){
+				laneMask[lane] = 0;
+			}
+		}
+	}
+}
+
+// The same lane on its own, straight through executeInstruction and the regular scheduler
+void runLaneAlone(int lane){
+	if (!laneRunning[lane]){
+		return; // Stopped before the first instruction
+	}
+	enterLane(lane);
+	scheduleNextEvent();
+	while(!stopReason){
+		if (testBit(breakpoints, pc) && (pc == stopAtPc || pc == imageEnd)){
+			stopReason = (pc == stopAtPc) ? "stop address" : "end of image";
+			break;
+		}
+		executeInstruction();
+		if (sleeping){
+			stopReason = "SLEEP, lanes can't sleep";
+			sleeping = false;
+			break;
+		}
+		if (cycles >= nextEventCycle){
+			serviceEvents();
+		}
+	}
+	lanes[lane].stopReason = stopReason;
+	stopReason = NULL;
+	leaveLane(lane);
+}
+
+uint64_t laneStateHash(int lane){
+	enterLane(lane);
+	uint64_t hash = stateHash();
+	leaveLane(lane);
+	return hash;
+}
+
+uint64_t totalLaneInstructions(){
+	uint64_t total = 0;
+	for(int lane = 0; lane < laneCount; lane++){
+		total += laneInstructions[lane];
+	}
+	return total;
+}
+
+bool loadLaneJournal(struct Lane* state, const char* path){
+	if (!startInputReplay(path)){
+		return false;
+	}
+	state->replayData = replayData;
+	state->replaySize = replaySize;
+	replayData = NULL;
+	nextReplayCycle = UINT64_MAX;
+	return true;
+}
+
+// Call once the ROM is loaded and the machine is reset, returns the exit code
+int runLanes(const char* listPath, uint32_t entry){
+	FILE* list = fopen(listPath, "r");
+	if (!list){
+		printf("Can't open lane list %s\n", listPath);
+		return 1;
+	}
+	char line[1024];
+	while(laneCount < MAX_LANES && fgets(line, sizeof(line), list)){
+		line[strcspn(line, "\r\n")] = 0;
+		if (!line[0]){
+			continue;
+		}
+		struct Lane* state = &lanes[laneCount];
+		if (!loadLaneJournal(state, line)){
+			printf("Can't open input journal %s\n", line);
+			fclose(list);
+			return 1;
+		}
+		size_t pathSize = strlen(line) + 1;
+		state->journalPath = memcpy(malloc(pathSize), line, pathSize);
+		state->memory = malloc(BLOCK_SIZE + BLOCK_PADDING);
+		laneCount++;
+	}
+	fclose(list);
+	if (!laneCount){
+		printf("No input journals in %s\n", listPath);
+		return 1;
+	}
+
+	laneImage = memory;
+	memcpy(laneImageAccel, accel_memory, 29);
+	memcpy(laneImagePorts, ports, sizeof(ports));
+	laneImageRtc = rtc;
+	laneImageWatchdog = watchdog;
+	historyRing = NULL;
+	coveredPcs = NULL;
+	stopOnWatchdog = false;
+	fuseBranches = false;
+	for(int page = 0; page < (BLOCK_SIZE >> PAGE_SHIFT); page++){
+		laneDevicePages[page] = pageHasBitsSet(deviceRegisters, page);
+	}
+	laneEntry = entry;
+	trace = false;
+
+	for(int lane = 0; lane < laneCount; lane++){
+		resetLane(lane);
+	}
+	clock_t start = clock();
+	runLaneRounds();
+	double batchedSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	uint64_t batchedInstructions = totalLaneInstructions();
+	for(int lane = 0; lane < laneCount; lane++){
+		struct Lane* state = &lanes[lane];
+		state->stateHash = laneStateHash(lane);
+		printf("LANE %d - %s: %s at 0x%04x after %llu instructions, %llu states, state hash %016llx\n", lane, state->journalPath, state->stopReason, lanePc[lane], (unsigned long long)laneInstructions[lane], (unsigned long long)laneCycles[lane], (unsigned long long)state->stateHash);
+	}
+
+	int mismatches = 0;
+	start = clock();
+	for(int lane = 0; lane < laneCount; lane++){
+		resetLane(lane);
+		runLaneAlone(lane);
+	}
+	double aloneSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	for(int lane = 0; lane < laneCount; lane++){
+		if (laneStateHash(lane) != lanes[lane].stateHash){
+			printf("LANE %d - ended differently when run alone\n", lane);
+			mismatches++;
+		}
+	}
+
+	double batchedRate = batchedInstructions / (batchedSeconds > 0 ? batchedSeconds : 1e-9) / 1e6;
+	double aloneRate = totalLaneInstructions() / (aloneSeconds > 0 ? aloneSeconds : 1e-9) / 1e6;
+	printf("LANES - %d lanes, %llu instructions, %.1f%% on the SIMD path (%.1f lanes per pass)\n", laneCount, (unsigned long long)batchedInstructions, 100.0 * simdLaneInstructions / (batchedInstructions ? batchedInstructions : 1), simdPasses ? (double)simdLaneInstructions / simdPasses : 0.0);
+	printf("LANES - batched %.3fs (%.1fM instructions/s), one at a time %.3fs (%.1fM instructions/s), %.2fx\n", batchedSeconds, batchedRate, aloneSeconds, aloneRate, aloneRate > 0 ? batchedRate / aloneRate : 0.0);
+	printf("LANES - %s\n", mismatches ? "results differ from running alone" : "all lanes match running alone");
+	return mismatches ? 1 : 0;
+}
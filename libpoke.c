@@ -0,0 +1,285 @@
+// libpoke, see libpoke.h. The emulator keeps its state in globals, so a machine is the part of them that belongs to
+// one walker, saved here while another machine is in and put back when it's its turn (the same thing lanes.c does per
+// lane). Only what differs gets remapped: a harness that sticks to one machine never swaps at all.
+// The debugging aids (breakpoints, watchpoints, rewind, hang report, coverage, logging) stay off in the library.
+#define POKE_LIBRARY
+#include "main.c"
+#include "libpoke.h"
+
+struct PokeMachine{
+	uint8_t* memory; // On-chip memory, mapped as block 0x00 and 0xFF
+	uint8_t* blocks[ADDRESS_SPACE >> BLOCK_SHIFT]; // Same as the global one while the machine is out
+	uint8_t* rom;
+	size_t romSize;
+	uint32_t registers[8];
+	uint8_t ccr;
+	uint32_t pc;
+	uint64_t cycles;
+	uint64_t instructions;
+	bool sleeping;
+	uint8_t accel[29];
+	uint8_t ssuBuffer[2];
+	uint8_t ssuShift;
+	struct Port ports[PORT_COUNT];
+	struct Rtc rtc;
+	struct Watchdog watchdog;
+};
+
+static PokeMachine* currentMachine; // The one in the globals
+static struct Port resetPorts[PORT_COUNT];
+static bool libraryReady;
+
+void leaveMachine(PokeMachine* machine){
+	for(int i = 0; i < 8; i++){
+		machine->registers[i] = *ER[i];
+	}
+	machine->ccr = getCCR();
+	machine->pc = pc;
+	machine->cycles = cycles;
+	machine->instructions = instructions;
+	machine->sleeping = sleeping;
+	memcpy(machine->ssuBuffer, ssuBuffer, 2);
+	machine->ssuShift = SSU.SSTRSR;
+	memcpy(machine->ports, ports, sizeof(ports));
+	machine->rtc = rtc;
+	machine->watchdog = watchdog;
+	memcpy(machine->blocks, blocks, sizeof(blocks)); // Off-chip blocks the program wrote to since it came in
+}
+
+void enterMachine(PokeMachine* machine){
+	if (machine == currentMachine){
+		return;
+	}
+	if (currentMachine){
+		leaveMachine(currentMachine);
+	}
+	currentMachine = machine;
+	memory = machine->memory;
+	for(int i = 0; i < (ADDRESS_SPACE >> BLOCK_SHIFT); i++){
+		if (blocks[i] != machine->blocks[i]){
+			mapBlock(i, machine->blocks[i]);
+		}
+	}
+	mapSSURegisters();
+	accel_memory = machine->accel;
+	for(int i = 0; i < 8; i++){
+		*ER[i] = machine->registers[i];
+	}
+	setCCR(machine->ccr);
+	pc = machine->pc;
+	cycles = machine->cycles;
+	instructions = machine->instructions;
+	sleeping = machine->sleeping;
+	memcpy(ssuBuffer, machine->ssuBuffer, 2);
+	SSU.SSTRSR = machine->ssuShift;
+	memcpy(ports, machine->ports, sizeof(ports));
+	rtc = machine->rtc;
+	watchdog = machine->watchdog;
+	imageEnd = machine->romSize;
+	nextEventCycle = 0; // The deadlines are the last machine's
+}
+
+// Limits are counts from where the machine is now, returns NULL if it got to one of them
+const char* runMachine(PokeMachine* machine, uint64_t stateCount, uint64_t instructionCount){
+	enterMachine(machine);
+	cycleLimit = (stateCount > UINT64_MAX - cycles) ? UINT64_MAX : cycles + stateCount;
+	instructionLimit = (instructionCount > UINT64_MAX - instructions) ? UINT64_MAX : instructions + instructionCount;
+	stopReason = NULL;
+	serviceEvents(); // Inputs given since the last run, and the first deadline
+	while(!stopReason){
+		if (pc == imageEnd){
+			stopReason = "end of image";
+			break;
+		}
+		executeInstruction();
+		if (cycles >= nextEventCycle){
+			serviceEvents();
+		}
+	}
+	const char* reason = stopReason;
+	stopReason = NULL;
+	cycleLimit = UINT64_MAX;
+	instructionLimit = UINT64_MAX;
+	if (strcmp(reason, "cycle limit") == 0 || strcmp(reason, "instruction limit") == 0){
+		return NULL;
+	}
+	return reason;
+}
+
+PokeMachine* pokeCreate(){
+	if (!libraryReady){
+		initDecoder();
+		initFusion();
+		allocateRegisters();
+		memcpy(resetPorts, ports, sizeof(ports)); // Before any machine moves a pin
+		mode = RUN;
+		trace = false;
+		libraryReady = true;
+	}
+	PokeMachine* machine = calloc(1, sizeof(PokeMachine));
+	if (!machine){
+		return NULL;
+	}
+	machine->memory = calloc(BLOCK_SIZE + BLOCK_PADDING, 1);
+	if (!machine->memory){
+		free(machine);
+		return NULL;
+	}
+	machine->blocks[0x00] = machine->memory;
+	machine->blocks[0xFF] = machine->memory;
+	pokeReset(machine);
+	return machine;
+}
+
+void pokeDestroy(PokeMachine* machine){
+	if (!machine){
+		return;
+	}
+	if (machine == currentMachine){
+		leaveMachine(machine);
+		for(int i = 0; i < (ADDRESS_SPACE >> BLOCK_SHIFT); i++){
+			if (blocks[i]){
+				mapBlock(i, NULL);
+			}
+		}
+		currentMachine = NULL;
+		memory = NULL;
+		accel_memory = NULL;
+	}
+	for(int i = 0; i < (ADDRESS_SPACE >> BLOCK_SHIFT); i++){
+		if (machine->blocks[i] != machine->memory){
+			free(machine->blocks[i]);
+		}
+	}
+	free(machine->memory);
+	free(machine->rom);
+	free(machine);
+}
+
+bool pokeLoadRom(PokeMachine* machine, const void* data, size_t size){
+	if (size > BLOCK_SIZE){
+		return false;
+	}
+	uint8_t* rom = malloc(size ? size : 1);
+	if (!rom){
+		return false;
+	}
+	memcpy(rom, data, size);
+	free(machine->rom);
+	machine->rom = rom;
+	machine->romSize = size;
+	pokeReset(machine);
+	return true;
+}
+
+void pokeReset(PokeMachine* machine){
+	enterMachine(machine);
+	for(int i = 0; i < (ADDRESS_SPACE >> BLOCK_SHIFT); i++){
+		if (blocks[i] && blocks[i] != memory){
+			free(blocks[i]);
+			mapBlock(i, NULL);
+		}
+	}
+	memset(memory, 0, BLOCK_SIZE + BLOCK_PADDING);
+	if (machine->romSize){
+		memcpy(memory, machine->rom, machine->romSize);
+	}
+	memcpy(ports, resetPorts, sizeof(ports));
+	rtc = (struct Rtc){.nextTick = UINT64_MAX};
+	watchdog = (struct Watchdog){.expiry = UINT64_MAX};
+	sleeping = false;
+	cycles = 0;
+	instructions = 0;
+	resetMachine(0);
+	nextEventCycle = 0;
+}
+
+const char* pokeRun(PokeMachine* machine, uint64_t states){
+	return runMachine(machine, states, UINT64_MAX);
+}
+
+const char* pokeStep(PokeMachine* machine){
+	return runMachine(machine, UINT64_MAX, 1);
+}
+
+uint64_t pokeStates(PokeMachine* machine){
+	enterMachine(machine);
+	return cycles;
+}
+
+uint64_t pokeInstructions(PokeMachine* machine){
+	enterMachine(machine);
+	return instructions;
+}
+
+uint64_t pokeStateHash(PokeMachine* machine){
+	enterMachine(machine);
+	return stateHash();
+}
+
+uint32_t pokeGetRegister(PokeMachine* machine, int n){
+	enterMachine(machine);
+	return *ER[n & 7];
+}
+
+void pokeSetRegister(PokeMachine* machine, int n, uint32_t value){
+	enterMachine(machine);
+	*ER[n & 7] = value;
+}
+
+uint32_t pokeGetPc(PokeMachine* machine){
+	enterMachine(machine);
+	return pc;
+}
+
+void pokeSetPc(PokeMachine* machine, uint32_t address){
+	enterMachine(machine);
+	pc = address & ADDRESS_MASK;
+	sleeping = false;
+}
+
+uint8_t pokeGetCCR(PokeMachine* machine){
+	enterMachine(machine);
+	return getCCR();
+}
+
+void pokeSetCCR(PokeMachine* machine, uint8_t ccr){
+	enterMachine(machine);
+	setCCR(ccr);
+	nextEventCycle = 0; // Unmasking can let a pending interrupt in
+}
+
+void pokeReadMemory(PokeMachine* machine, uint32_t address, void* out, size_t size){
+	enterMachine(machine);
+	for(size_t i = 0; i < size; i++){
+		((uint8_t*)out)[i] = peekMemory8(address + i);
+	}
+}
+
+void pokeWriteMemory(PokeMachine* machine, uint32_t address, const void* data, size_t size){
+	enterMachine(machine);
+	for(size_t i = 0; i < size; i++){
+		pokeMemory8(address + i, ((const uint8_t*)data)[i]);
+	}
+	nextEventCycle = 0; // Could have raised an interrupt flag
+}
+
+void pokeSetButton(PokeMachine* machine, enum PokeButton button, bool pressed){
+	enterMachine(machine);
+	inputWrite(INPUT_BUTTON, button, pressed);
+}
+
+void pokeSetPortPins(PokeMachine* machine, uint16_t dataRegister, uint8_t pins){
+	enterMachine(machine);
+	inputWrite(INPUT_PORT, dataRegister & 0xFF, pins);
+}
+
+void pokeSetAccelRegister(PokeMachine* machine, uint8_t index, uint8_t value){
+	enterMachine(machine);
+	inputWrite(INPUT_ACCEL, index, value);
+}
+
+void pokeWarpClock(PokeMachine* machine, uint64_t seconds){
+	enterMachine(machine);
+	inputRtcWarp(seconds);
+}
@@ -0,0 +1,84 @@
+// libpoke, the emulator as a library, for test harnesses that want to run lots of short scenarios in one process
+// instead of starting poke once per case and reading its stdout.
+//
+// Build it as a DLL / shared object, only the functions below are exported:
+//   cl -LD -O2 -DPOKE_BUILD -Felibpoke.dll libpoke.c
+//   gcc -shared -fPIC -O2 -fvisibility=hidden -DPOKE_BUILD -o libpoke.so libpoke.c -lpthread
+//
+// A machine is a whole walker: CPU, memory and devices. Any number of them can exist at once, but there is only one
+// emulator core, each call swaps the machine it's given in (cheap while it's the same machine as the last call).
+// So calls must not come from more than one thread at the same time.
+// Addresses are CPU addresses, the on-chip memory (ROM, RAM and registers) is 0x0000 - 0xFFFF.
+#ifndef LIBPOKE_H
+#define LIBPOKE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef _WIN32
+	#ifdef POKE_BUILD
+		#define POKE_API __declspec(dllexport)
+	#else
+		#define POKE_API __declspec(dllimport)
+	#endif
+#else
+	#define POKE_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct PokeMachine PokeMachine;
+
+enum PokeButton{
+	POKE_BUTTON_ENTER,
+	POKE_BUTTON_LEFT,
+	POKE_BUTTON_RIGHT
+};
+
+// NULL if out of memory. A new machine has an empty ROM and is in reset.
+POKE_API PokeMachine* pokeCreate();
+POKE_API void pokeDestroy(PokeMachine* machine);
+
+// Copies size bytes (up to 64KB) to address 0 and resets, false if it doesn't fit. Like the command line, running
+// into the end of the image stops the run, so small test images don't need a stop address.
+POKE_API bool pokeLoadRom(PokeMachine* machine, const void* data, size_t size);
+// Back to the state right after loading the ROM: memory cleared apart from the ROM, CPU and devices reset
+POKE_API void pokeReset(PokeMachine* machine);
+
+// Runs until at least states more states have gone by (it stops between instructions). Returns NULL if it got there,
+// otherwise why it stopped early, same text as the STOP line on the command line ("end of image" and so on).
+POKE_API const char* pokeRun(PokeMachine* machine, uint64_t states);
+// One instruction, same return
+POKE_API const char* pokeStep(PokeMachine* machine);
+
+POKE_API uint64_t pokeStates(PokeMachine* machine); // Since reset
+POKE_API uint64_t pokeInstructions(PokeMachine* machine);
+// Same hash as the STOP line, for telling whether two runs ended in the same state
+POKE_API uint64_t pokeStateHash(PokeMachine* machine);
+
+// CPU, n is 0 - 7 for ER0 - ER7
+POKE_API uint32_t pokeGetRegister(PokeMachine* machine, int n);
+POKE_API void pokeSetRegister(PokeMachine* machine, int n, uint32_t value);
+POKE_API uint32_t pokeGetPc(PokeMachine* machine);
+POKE_API void pokeSetPc(PokeMachine* machine, uint32_t address);
+POKE_API uint8_t pokeGetCCR(PokeMachine* machine);
+POKE_API void pokeSetCCR(PokeMachine* machine, uint8_t ccr);
+
+// Memory, the way a debugger sees it: no watchpoints, and writes to device registers don't reach the device models
+POKE_API void pokeReadMemory(PokeMachine* machine, uint32_t address, void* out, size_t size);
+POKE_API void pokeWriteMemory(PokeMachine* machine, uint32_t address, const void* data, size_t size);
+
+// Inputs, the same ones an input journal holds (-R / -P). They take effect before the next instruction.
+POKE_API void pokeSetButton(PokeMachine* machine, enum PokeButton button, bool pressed);
+POKE_API void pokeSetPortPins(PokeMachine* machine, uint16_t dataRegister, uint8_t pins); // Outside levels of a port
+POKE_API void pokeSetAccelRegister(PokeMachine* machine, uint8_t index, uint8_t value); // 0 - 28
+POKE_API void pokeWarpClock(PokeMachine* machine, uint64_t seconds); // 0 for the next midnight
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
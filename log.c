@@ -0,0 +1,270 @@
+// Logging, -l file. Instead of printing as it goes, the emulator fills in fixed size binary records and posts them to a
+// single producer / single consumer ring (same scheme as the console), and a writer thread turns them into text and
+// writes them out a batch at a time, so the emulator never waits on the file, the terminal or a pipe. If the writer
+// falls behind and the ring fills up records are dropped and counted, the emulator doesn't wait for it either.
+// -F filter sets a level per subsystem, filter is a comma separated list of subsystem:level, with cpu, ssu and memory
+// for subsystems and off, info, debug and trace for levels (everything is on by default):
+//   cpu: unimplemented instructions (info), the trace (trace, it's what -q turns off)
+//   ssu: bytes sent and received (debug)
+//   memory: writes to device registers (debug)
+// Text is slow to put together, a full trace easily outruns the writer. -B file writes the records as they are
+// instead, which keeps up, and -D file turns such a file into the same text afterwards.
+// Without -l or -B the trace still goes straight to stdout and the rest isn't recorded at all.
+
+enum LogSubsystem{
+	LOG_CPU,
+	LOG_SSU,
+	LOG_MEMORY,
+	LOG_SUBSYSTEMS
+};
+
+enum LogLevel{
+	LOG_OFF,
+	LOG_INFO,
+	LOG_DEBUG,
+	LOG_TRACE
+};
+
+enum LogKind{
+	LOG_INSTRUCTION,
+	LOG_UNIMPLEMENTED,
+	LOG_SSU_TRANSFER,
+	LOG_DEVICE_WRITE
+};
+
+#define LOG_QUEUE_SIZE (1 << 18) // Power of two, 56 bytes each (struct LogRecord), 14MB
+#define LOG_BATCH_SIZE (64 * 1024) // Text the writer puts together before each write
+#define LOG_MAGIC "POKELOG1" // Then the record size as a byte, then the records
+
+struct LogRecord{
+	uint64_t cycles;
+	uint32_t pc;
+	uint8_t kind;
+	uint8_t ccr;
+	uint8_t bytes[10]; // The instruction
+	uint32_t values[8]; // ER0 - ER7 for instructions, whatever else needs otherwise
+};
+
+static const char* logSubsystemNames[LOG_SUBSYSTEMS] = {"cpu", "ssu", "memory"};
+static const char* logLevelNames[] = {"off", "info", "debug", "trace"};
+
+static uint8_t logLevels[LOG_SUBSYSTEMS]; // All off until the writer is running
+static uint8_t logFilter[LOG_SUBSYSTEMS] = {LOG_TRACE, LOG_TRACE, LOG_TRACE};
+static FILE* logFile;
+static bool logBinary;
+static bool logging;
+static struct LogRecord logQueue[LOG_QUEUE_SIZE];
+static volatile int32_t logHead; // Only written by the emulator
+static volatile int32_t logTail; // Only written by the writer
+static volatile int32_t logClosed; // Nothing more is coming
+static uint64_t logDropped;
+#ifdef _WIN32
+static HANDLE logThread;
+#else
+static pthread_t logThread;
+#endif
+
+#define logWanted(subsystem, level) (logLevels[subsystem] >= (level))
+
+bool openLog(const char* path, bool binary){
+	logFile = fopen(path, binary ? "wb" : "w");
+	logBinary = binary;
+	if (logFile && binary){
+		fwrite(LOG_MAGIC, 1, 8, logFile);
+		fputc(sizeof(struct LogRecord), logFile);
+	}
+	return logFile != NULL;
+}
+
+// Returns false if filter doesn't parse
+bool setLogFilter(const char* filter){
+	while(*filter){
+		size_t length = strcspn(filter, ":,");
+		int subsystem = 0;
+		while(subsystem < LOG_SUBSYSTEMS && (strlen(logSubsystemNames[subsystem]) != length || strncmp(filter, logSubsystemNames[subsystem], length) != 0)){
+			subsystem++;
+		}
+		if (subsystem == LOG_SUBSYSTEMS){
+			return false;
+		}
+		filter += length;
+		int level = LOG_TRACE;
+		if (*filter == ':'){
+			filter++;
+			length = strcspn(filter, ",");
+			level = 0;
+			while(level <= LOG_TRACE && (strlen(logLevelNames[level]) != length || strncmp(filter, logLevelNames[level], length) != 0)){
+				level++;
+			}
+			if (level > LOG_TRACE){
+				return false;
+			}
+			filter += length;
+		}
+		logFilter[subsystem] = level;
+		filter += (*filter == ',');
+	}
+	return true;
+}
+
+// Writer side
+int formatLogRecord(const struct LogRecord* record, char* out){
+	char* start = out;
+	switch(record->kind){
+		case LOG_INSTRUCTION:{ // Same as the trace on stdout
+			char text[64];
+			disassembleInstruction(record->pc, record->bytes, text);
+			out += sprintf(out, "%04x - %s\n", record->pc, text);
+			for(int i = 0; i < 8; i++){
+				out += sprintf(out, "ER%d: [0x%08X], ", i, record->values[i]);
+			}
+			uint8_t ccr = record->ccr;
+			out += sprintf(out, "\nI: %d, H: %d, N: %d, Z: %d, V: %d, C: %d \n\n", ccr >> 7, (ccr >> 5) & 1, (ccr >> 3) & 1, (ccr >> 2) & 1, (ccr >> 1) & 1, ccr & 1);
+		}break;
+		case LOG_UNIMPLEMENTED:{
+			char text[64];
+			disassembleInstruction(record->pc, record->bytes, text);
+			out += sprintf(out, "CPU - unimplemented %s at 0x%04x, %llu states\n", text, record->pc, (unsigned long long)record->cycles);
+		}break;
+		case LOG_SSU_TRANSFER:{
+			out += sprintf(out, "SSU - sent 0x%02x", record->values[0]);
+			if (record->values[2]){
+				out += sprintf(out, ", received 0x%02x", record->values[1]);
+			}
+			out += sprintf(out, " at 0x%04x, %llu states\n", record->pc, (unsigned long long)record->cycles);
+		}break;
+		case LOG_DEVICE_WRITE:{
+			out += sprintf(out, "MEMORY - 0x%02x to 0x%04x at 0x%04x, %llu states\n", record->values[1], record->values[0], record->pc, (unsigned long long)record->cycles);
+		}break;
+	}
+	return (int)(out - start);
+}
+
+#ifdef _WIN32
+DWORD WINAPI logWriterThread(LPVOID unused){
+#else
+void* logWriterThread(void* unused){
+#endif
+	static char batch[LOG_BATCH_SIZE + 1024];
+	while(true){
+		int32_t tail = logTail;
+		int32_t head = consoleLoad(&logHead);
+		if (head == tail){
+			if (consoleLoad(&logClosed) && consoleLoad(&logHead) == tail){
+				break;
+			}
+			consoleSleep();
+			continue;
+		}
+		if (logBinary){ // Up to the end of the ring at most, it's written straight from there
+			int32_t end = tail + LOG_QUEUE_SIZE - (tail & (LOG_QUEUE_SIZE - 1));
+			int32_t count = ((head - end) < 0) ? head - tail : end - tail;
+			fwrite(&logQueue[tail & (LOG_QUEUE_SIZE - 1)], sizeof(struct LogRecord), count, logFile);
+			consoleStore(&logTail, tail + count);
+			continue;
+		}
+		int size = 0;
+		for(; tail != head && size < LOG_BATCH_SIZE; tail++){
+			size += formatLogRecord(&logQueue[tail & (LOG_QUEUE_SIZE - 1)], batch + size);
+		}
+		consoleStore(&logTail, tail);
+		fwrite(batch, 1, size, logFile);
+	}
+	fflush(logFile);
+	return 0;
+}
+
+// -D, prints a file -B wrote as text
+bool printBinaryLog(const char* path){
+	FILE* file = fopen(path, "rb");
+	if (!file){
+		return false;
+	}
+	char magic[9] = {0};
+	bool valid = fread(magic, 1, 9, file) == 9 && memcmp(magic, LOG_MAGIC, 8) == 0 && magic[8] == sizeof(struct LogRecord);
+	struct LogRecord record;
+	char text[1024];
+	while(valid && fread(&record, sizeof(record), 1, file) == 1){
+		fwrite(text, 1, formatLogRecord(&record, text), stdout);
+	}
+	fclose(file);
+	return valid;
+}
+
+void startLog(){
+	if (!logFile){
+		return;
+	}
+#ifdef _WIN32
+	logThread = CreateThread(NULL, 0, logWriterThread, NULL, 0, NULL);
+	logging = logThread != NULL;
+#else
+	logging = pthread_create(&logThread, NULL, logWriterThread, NULL) == 0;
+#endif
+	if (!logging){
+		printf("LOG - can't start the writer thread, not logging\n");
+		return;
+	}
+	memcpy(logLevels, logFilter, sizeof(logLevels));
+}
+
+// Waits for the writer to get through what's left
+void stopLog(){
+	if (!logging){
+		return;
+	}
+	memset(logLevels, LOG_OFF, sizeof(logLevels));
+	consoleStore(&logClosed, 1);
+#ifdef _WIN32
+	WaitForSingleObject(logThread, INFINITE);
+#else
+	pthread_join(logThread, NULL);
+#endif
+	fclose(logFile);
+	logging = false;
+	if (logDropped){
+		printf("LOG - the writer fell behind, %llu records dropped\n", (unsigned long long)logDropped);
+	}
+}
+
+// Emulator side. Fill in the record reserveLog hands out (NULL if the ring is full) and post it with commitLog
+struct LogRecord* reserveLog(uint8_t kind){
+	int32_t head = logHead;
+	if (head - consoleLoad(&logTail) == LOG_QUEUE_SIZE){
+		logDropped++;
+		return NULL;
+	}
+	struct LogRecord* record = &logQueue[head & (LOG_QUEUE_SIZE - 1)];
+	record->kind = kind;
+	record->pc = pc;
+	record->cycles = cycles;
+	return record;
+}
+
+void commitLog(){
+	consoleStore(&logHead, logHead + 1);
+}
+
+// LOG_INSTRUCTION or LOG_UNIMPLEMENTED, for the instruction at address
+void logInstruction(uint8_t kind, uint32_t address, const uint8_t* bytes){
+	struct LogRecord* record = reserveLog(kind);
+	if (record){
+		record->pc = address;
+		memcpy(record->bytes, bytes, sizeof(record->bytes));
+		for(int i = 0; i < 8; i++){
+			record->values[i] = *ER[i];
+		}
+		record->ccr = getCCR();
+		commitLog();
+	}
+}
+
+void logValues(uint8_t kind, uint32_t a, uint32_t b, uint32_t c){
+	struct LogRecord* record = reserveLog(kind);
+	if (record){
+		record->values[0] = a;
+		record->values[1] = b;
+		record->values[2] = c;
+		commitLog();
+	}
+}
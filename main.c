@@ -1,3 +1,6 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L // nanosleep, threads and sockets, with -std=c11 too
+#endif
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -9,7 +12,9 @@
 
 enum Mode{
 	STEP,
-	RUN
+	RUN,
+	GDB_RUN, // Running with a debugger attached
+	GDB_STEP // Stop and report to the debugger after the current instruction
 };
 
 static enum Mode mode;
@@ -26,6 +31,7 @@ static uint8_t* RL[8];
 static uint8_t* RH[8];
 
 static uint32_t* SP;
+static int pc;
 // CCR Condition Code Register
 // I UI H U N Z V C
 struct Flags{
@@ -40,6 +46,35 @@ struct Flags{
 };	
 static struct Flags flags;
 
+// CMP leaves its operands here instead of working out the flags, a Bcc tests them directly and anything else that
+// looks at the flags settles them first (see fusion.c)
+struct DeferredCompare{
+	uint8_t bits; // Operand width, 0 when the flags are up to date
+	uint32_t a;
+	uint32_t b;
+};
+static struct DeferredCompare deferredCompare;
+void settleFlags(); // alu.c
+
+uint8_t getCCR(){
+	if (deferredCompare.bits){
+		settleFlags();
+	}
+	return (flags.I << 7) | (flags.UI << 6) | (flags.H << 5) | (flags.U << 4) | (flags.N << 3) | (flags.Z << 2) | (flags.V << 1) | flags.C;
+}
+
+void setCCR(uint8_t ccr){
+	deferredCompare.bits = 0;
+	flags.I = ccr & 0x80;
+	flags.UI = ccr & 0x40;
+	flags.H = ccr & 0x20;
+	flags.U = ccr & 0x10;
+	flags.N = ccr & 0x08;
+	flags.Z = ccr & 0x04;
+	flags.V = ccr & 0x02;
+	flags.C = ccr & 0x01;
+}
+
 static uint8_t* memory;
 static uint8_t* accel_memory;
 
@@ -71,163 +106,328 @@ void printRegistersState(){
 		printf("ER%d: [0x%08X], ", i, *ER[i]); 
 	}
 	printf("\n");
+	if (deferredCompare.bits){
+		settleFlags();
+	}
 	printf("I: %d, H: %d, N: %d, Z: %d, V: %d, C: %d ", flags.I, flags.H, flags.N, flags.Z, flags.V, flags.C);
 	printf("\n\n");
 
 }
 
-void printMemory(uint32_t address, int byteCount){
-	address = address & 0x0000ffff; // Keep lower 16 bits only
-	for(int i = 0; i < byteCount; i++){ 
-		printf("MEMORY - 0x%04x -> %02x\n", address + i, memory[address + i]);
+// Bus map. The 16MB address space is split in 128 byte pages, each one pointing to its backing memory for reads and for
+// writes. A NULL entry sends the access through the slow path, that's how watchpoints get flagged at page level without
+// costing anything on the pages that aren't being watched. 128 bytes lines up with the 0xF780 and 0xFF80 boundaries.
+// Backing memory is handed out 64KB at a time, the first time something writes to a block, so the parts of the
+// space nothing touches only cost their (zero, never written) entries in the page tables.
+#define ADDRESS_SPACE (16 * 1024 * 1024)
+#define ADDRESS_MASK (ADDRESS_SPACE - 1)
+#define PAGE_SHIFT 7
+#define PAGE_SIZE (1 << PAGE_SHIFT)
+#define PAGE_MASK (PAGE_SIZE - 1)
+#define PAGE_COUNT (ADDRESS_SPACE >> PAGE_SHIFT)
+#define BLOCK_SHIFT 16
+#define BLOCK_SIZE (1 << BLOCK_SHIFT)
+#define BLOCK_PADDING 16 // So decoding the last instruction of a block can't read past the end
+
+static uint8_t* readPages[PAGE_COUNT];
+static uint8_t* writePages[PAGE_COUNT];
+static uint8_t* blocks[ADDRESS_SPACE >> BLOCK_SHIFT];
+static bool journalWrites; // The rewind buffer is on, every write goes through the slow path to get journaled
+
+// Debugging aids. One bit per address, breakpoints are checked on every dispatch so it has to stay a single bit test.
+static uint8_t breakpoints[ADDRESS_SPACE / 8];
+static uint8_t readWatchpoints[ADDRESS_SPACE / 8];
+static uint8_t writeWatchpoints[ADDRESS_SPACE / 8];
+static uint8_t deviceRegisters[ADDRESS_SPACE / 8]; // Writes to these go through the slow path, so the device sees them
+static uint8_t codePages[PAGE_COUNT / 8]; // One bit per page, set where there's translated code (aot.c), same thing
+static uint8_t mmioPages[PAGE_COUNT / 8]; // Same, for the I/O register pages while they're being counted (mmio.c)
+static int instructionsToStep;
+
+bool testBit(uint8_t* bitmap, uint32_t address){
+	return bitmap[address >> 3] & (1 << (address & 0x7));
+}
+
+void setBit(uint8_t* bitmap, uint32_t address){
+	bitmap[address >> 3] |= (1 << (address & 0x7));
+}
+
+void clearBit(uint8_t* bitmap, uint32_t address){
+	bitmap[address >> 3] &= ~(1 << (address & 0x7));
+}
+
+bool pageHasBitsSet(uint8_t* bitmap, int page){
+	for(int i = (page << PAGE_SHIFT) >> 3; i < ((page + 1) << PAGE_SHIFT) >> 3; i++){
+		if (bitmap[i]){
+			return true;
+		}
 	}
+	return false;
 }
 
-// With masking here we're ignoring the 0x00XX0000 part of the address for this emulator, as we have one big memory block that goes up to 0xFFFF
-void setMemory8(uint32_t address, uint8_t value){
-	address = address & 0x0000ffff; // Keep lower 16 bits only
-	memory[address] = value; 
+// Points the page at its backing memory, unless it has no backing yet or has watchpoints on it
+void mapPage(int page){
+	uint8_t* block = blocks[page >> (BLOCK_SHIFT - PAGE_SHIFT)];
+	uint8_t* backing = block ? block + ((page << PAGE_SHIFT) & (BLOCK_SIZE - 1)) : NULL;
+	readPages[page] = (pageHasBitsSet(readWatchpoints, page) || testBit(mmioPages, page)) ? NULL : backing;
+	writePages[page] = (journalWrites || pageHasBitsSet(writeWatchpoints, page) || pageHasBitsSet(deviceRegisters, page) || testBit(codePages, page) || testBit(mmioPages, page)) ? NULL : backing;
 }
 
-void setMemory16(uint32_t address, uint16_t value){
-	address = address & 0x0000ffff; // Keep lower 16 bits only
-	memory[address] = value >> 8; 
-	memory[address + 1] = value & 0xFF; 
+void mapBlock(int block, uint8_t* backing){
+	blocks[block] = backing;
+	int firstPage = block << (BLOCK_SHIFT - PAGE_SHIFT);
+	for(int page = firstPage; page < firstPage + (BLOCK_SIZE >> PAGE_SHIFT); page++){
+		mapPage(page);
+	}
 }
 
-void setMemory32(uint32_t address, uint32_t value){
-	address = address & 0x0000ffff; // Keep lower 16 bits only
-	memory[address] = value >> 24; 
-	memory[address + 1] = (value >> 16) & 0xFF; 
-	memory[address + 2] = (value >> 8) & 0xFF; 
-	memory[address + 3] = value & 0xFF; 
+// The 64KB of ROM, RAM and registers sit at the bottom of the space and show up again at the top,
+// which is where @aa:8 and sign extended @aa:16 addresses land.
+void mapMemory(){
+	mapBlock(0x00, memory);
+	mapBlock(0xFF, memory);
 }
 
-uint16_t getMemory8(uint32_t address){
-	address = address & 0x0000ffff; // Keep lower 16 bits only
-	return (uint8_t)(memory[address]);
+// Returns where address lives in host memory. With allocate, blocks nothing has touched yet get backing memory.
+uint8_t* backingMemory(uint32_t address, bool allocate){
+	address = address & ADDRESS_MASK;
+	uint8_t* block = blocks[address >> BLOCK_SHIFT];
+	if (!block){
+		if (!allocate){
+			return NULL;
+		}
+		block = calloc(BLOCK_SIZE + BLOCK_PADDING, 1);
+		mapBlock(address >> BLOCK_SHIFT, block);
+	}
+	return block + (address & (BLOCK_SIZE - 1));
 }
 
-uint16_t getMemory16(uint32_t address){
-	address = address & 0x0000ffff; // Keep lower 16 bits only
-	return (uint16_t)((memory[address] << 8) | (memory[address + 1]));
+void addBreakpoint(uint32_t address){
+	setBit(breakpoints, address & ADDRESS_MASK);
 }
 
-uint32_t getMemory32(uint32_t address){
-	address = address & 0x0000ffff; // Keep lower 16 bits only
-	return (uint32_t)((memory[address] << 24) | (memory[address + 1] << 16) | (memory[address + 2] << 8) | memory[address + 3]);
+// Calls apply for address and, when it's in a block that's mapped more than once, for the same byte in the other copies.
+// That way a watchpoint on the on-chip memory catches accesses through either of its addresses.
+void forEachAlias(uint32_t address, bool onRead, bool onWrite, void (*apply)(uint32_t, bool, bool)){
+	address = address & ADDRESS_MASK;
+	uint8_t* block = blocks[address >> BLOCK_SHIFT];
+	for(int i = 0; i < (ADDRESS_SPACE >> BLOCK_SHIFT); i++){
+		if (i == (address >> BLOCK_SHIFT) || (block && blocks[i] == block)){
+			apply((i << BLOCK_SHIFT) | (address & (BLOCK_SIZE - 1)), onRead, onWrite);
+		}
+	}
 }
 
-// Note: I considered using signed parameters here, but they get sign extended and screw up the carry calculations.
-void setFlagsADD(uint32_t value1, uint32_t value2, int numberOfBits){
-	// TODO: might be greately simplified, see setFlagsINC
-	uint32_t maxValue;
-	uint32_t maxValueLo;
-	uint32_t negativeFlag;
-	uint32_t halfCarryFlag;
-	switch(numberOfBits){
-		case 8:{
-			maxValue = 0xFF;
-			maxValueLo = 0xF;
-			negativeFlag = 0x80;
-			halfCarryFlag = 0x8;
+void setWatchpointBits(uint32_t address, bool onRead, bool onWrite){
+	if (onRead){
+		setBit(readWatchpoints, address);
+		readPages[address >> PAGE_SHIFT] = NULL;
+	}
+	if (onWrite){
+		setBit(writeWatchpoints, address);
+		writePages[address >> PAGE_SHIFT] = NULL;
+	}
+}
 
-			// TODO: maybe we can just cast to a signed int here and not have to use the flags
-			flags.Z = (uint8_t)(value1 + value2) == 0x0;  
-			flags.N = (uint8_t)(value1 + value2) & negativeFlag;  
+// The page goes back to the fast path once it has no watchpoints left
+void clearWatchpointBits(uint32_t address, bool onRead, bool onWrite){
+	if (onRead){
+		clearBit(readWatchpoints, address);
+	}
+	if (onWrite){
+		clearBit(writeWatchpoints, address);
+	}
+	mapPage(address >> PAGE_SHIFT);
+}
 
-		}break;
-		case 16:{
-			maxValue = 0xFFFF;
-			maxValueLo = 0xFF;
-			negativeFlag = 0x8000;
-			halfCarryFlag = 0x100;
+void addWatchpoint(uint32_t address, bool onRead, bool onWrite){
+	forEachAlias(address, onRead, onWrite, setWatchpointBits);
+}
 
-			flags.Z = (uint16_t)(value1 + value2) == 0x0;  
-			flags.N = (uint16_t)(value1 + value2) & negativeFlag;  
+void removeWatchpoint(uint32_t address, bool onRead, bool onWrite){
+	forEachAlias(address, onRead, onWrite, clearWatchpointBits);
+}
 
-		}break;
-		case 32:{
-			maxValue = 0xFFFFFFFF;
-			maxValueLo = 0xFFFF;
-			negativeFlag = 0x80000000;
-			halfCarryFlag = 0x10000;
+void removeBreakpoint(uint32_t address){
+	clearBit(breakpoints, address & ADDRESS_MASK);
+}
 
-			flags.Z = (uint32_t)(value1 + value2) == 0x0;  
-			flags.N = (uint32_t)(value1 + value2) & negativeFlag;  
+void setDeviceRegisterBit(uint32_t address, bool onRead, bool onWrite){
+	setBit(deviceRegisters, address);
+	writePages[address >> PAGE_SHIFT] = NULL;
+}
 
+// For devices that have to react as soon as a register is written, rather than when they next run
+void addDeviceRegisters(uint32_t address, int count){
+	for(int i = 0; i < count; i++){
+		forEachAlias(address + i, false, true, setDeviceRegisterBit);
+	}
+}
 
-		}break;
+void setCodePageBit(uint32_t address, bool onRead, bool onWrite){
+	setBit(codePages, address >> PAGE_SHIFT);
+	writePages[address >> PAGE_SHIFT] = NULL;
+}
+
+// Translated code sits on address - end, the translation has to hear about writes there
+void addCodePages(uint32_t address, uint32_t end){
+	for(uint32_t page = address >> PAGE_SHIFT; page <= ((end - 1) >> PAGE_SHIFT); page++){
+		forEachAlias(page << PAGE_SHIFT, false, true, setCodePageBit);
 	}
+}
 
-	flags.V = ~(value1 ^ value2) & ((value1 + value2) ^ value1) & negativeFlag; // If both operands have the same sign and the results is from a different sign, overflow has occured.
-	flags.C = (value1 & negativeFlag) && !(value2 & negativeFlag) && !((value1 + value2) & negativeFlag);
-	flags.H = (((value1 & maxValueLo) + (value2 & maxValueLo) & halfCarryFlag) == halfCarryFlag) ? 1 : 0; 
+void journalWrite(uint32_t address, uint8_t value); // rewind.c
+void codeWritten(uint32_t address); // aot.c
+void deviceWrite(uint16_t address, uint8_t value); // main.c, after the devices
+void printHangReport(); // hang.c
+void countMmioAccess(uint16_t address, bool write); // mmio.c
+int disassembleInstruction(uint32_t address, const uint8_t* bytes, char* out); // disassembler.c
+
+// Debugger accesses, these don't trigger watchpoints. Unmapped memory reads as 0.
+uint8_t peekMemory8(uint32_t address){
+	uint8_t* backing = backingMemory(address, false);
+	return backing ? *backing : 0;
 }
 
-void setFlagsSUB(uint32_t value1, uint32_t value2, int numberOfBits){
-	// TODO: might be greately simplified, see setFlagsINC
-	uint32_t maxValueLo;
-	uint32_t negativeFlag;
-	uint32_t halfCarryFlag;
-	switch(numberOfBits){
-		case 8:{
-			maxValueLo = 0xF;
-			negativeFlag = 0x80;
-			halfCarryFlag = 0x8;
+void pokeMemory8(uint32_t address, uint8_t value){
+	if (journalWrites){
+		journalWrite(address & ADDRESS_MASK, value);
+	}
+	*backingMemory(address, true) = value;
+}
 
-			// TODO: maybe we can just cast to a signed int here and not have to use the flags
-			flags.N = (uint8_t)(value1 - value2) & negativeFlag;  
+static uint32_t watchpointHitAddress;
+static char watchpointHitType; // 'r', 'w' or 0 if the last stop wasn't caused by a watchpoint
 
-		}break;
-		case 16:{
-			maxValueLo = 0xFF;
-			negativeFlag = 0x8000;
-			halfCarryFlag = 0x100;
+void hitWatchpoint(uint32_t address, char readOrWrite){
+	if (blocks[address >> BLOCK_SHIFT] == memory){
+		address = address & (BLOCK_SIZE - 1); // On-chip memory is reported by its 16 bit address
+	}
+	if (mode == GDB_RUN || mode == GDB_STEP){
+		if (!watchpointHitType){ // Multi byte accesses report the first watched byte
+			watchpointHitAddress = address;
+			watchpointHitType = readOrWrite;
+		}
+		mode = GDB_STEP; // Reported once the instruction completes
+		return;
+	}
+	printf("WATCHPOINT - %c 0x%04x\n", readOrWrite, address);
+	mode = STEP;
+	instructionsToStep = 0;
+}
 
-			flags.N = (uint16_t)(value1 - value2) & negativeFlag;  
+// Slow paths, only reached for pages with watchpoints or device registers on them, pages with no backing memory yet
+// or accesses that cross a page boundary
+void setMemory8Slow(uint32_t address, uint8_t value){
+	address = address & ADDRESS_MASK;
+	if (journalWrites){
+		journalWrite(address, value);
+	}
+	*backingMemory(address, true) = value; 
+	if (testBit(deviceRegisters, address)){
+		deviceWrite(address & (BLOCK_SIZE - 1), value); // Device registers are all on-chip
+	}
+	if (testBit(codePages, address >> PAGE_SHIFT)){
+		codeWritten(address & (BLOCK_SIZE - 1)); // So is translated code
+	}
+	if (testBit(mmioPages, address >> PAGE_SHIFT)){
+		countMmioAccess(address & (BLOCK_SIZE - 1), true);
+	}
+	if (testBit(writeWatchpoints, address)){
+		hitWatchpoint(address, 'w');
+	}
+}
 
-		}break;
-		case 32:{
-			maxValueLo = 0xFFFF;
-			negativeFlag = 0x80000000;
-			halfCarryFlag = 0x10000;
+uint8_t getMemory8Slow(uint32_t address){
+	address = address & ADDRESS_MASK;
+	if (testBit(readWatchpoints, address)){
+		hitWatchpoint(address, 'r');
+	}
+	if (testBit(mmioPages, address >> PAGE_SHIFT)){
+		countMmioAccess(address & (BLOCK_SIZE - 1), false);
+	}
+	return peekMemory8(address);
+}
 
-			flags.N = (uint32_t)(value1 - value2) & negativeFlag;  
+void setMemory8(uint32_t address, uint8_t value){
+	address = address & ADDRESS_MASK; // 24 bit address bus
+	uint8_t* page = writePages[address >> PAGE_SHIFT];
+	if (page){
+		page[address & PAGE_MASK] = value; 
+	} else{
+		setMemory8Slow(address, value);
+	}
+}
 
+void setMemory16(uint32_t address, uint16_t value){
+	address = address & ADDRESS_MASK;
+	uint8_t* page = writePages[address >> PAGE_SHIFT];
+	if (page && (address & PAGE_MASK) != PAGE_MASK){
+		page[address & PAGE_MASK] = value >> 8; 
+		page[(address & PAGE_MASK) + 1] = value & 0xFF; 
+	} else{
+		setMemory8Slow(address, value >> 8);
+		setMemory8Slow(address + 1, value & 0xFF);
+	}
+}
 
-		}break;
+void setMemory32(uint32_t address, uint32_t value){
+	setMemory16(address, value >> 16);
+	setMemory16(address + 2, value & 0xFFFF);
+}
+
+uint16_t getMemory8(uint32_t address){
+	address = address & ADDRESS_MASK; // 24 bit address bus
+	uint8_t* page = readPages[address >> PAGE_SHIFT];
+	if (page){
+		return (uint8_t)(page[address & PAGE_MASK]);
 	}
+	return getMemory8Slow(address);
+}
 
-	flags.Z = (value1 - value2) == 0x0;  
-	flags.V = ((value1 ^ value2) & negativeFlag) && (~((value1 - value2) ^ value2) & negativeFlag); // If both operands have a different sign and the results is from the same sing as the 2nd op, overflow has occured.
-	flags.C = value2 > value1;
-	flags.H = (value2 & maxValueLo) > (value1 & maxValueLo); 
+uint16_t getMemory16(uint32_t address){
+	address = address & ADDRESS_MASK;
+	uint8_t* page = readPages[address >> PAGE_SHIFT];
+	if (page && (address & PAGE_MASK) != PAGE_MASK){
+		return (uint16_t)((page[address & PAGE_MASK] << 8) | (page[(address & PAGE_MASK) + 1]));
+	}
+	return (uint16_t)((getMemory8Slow(address) << 8) | getMemory8Slow(address + 1));
 }
 
-void setFlagsINC(uint32_t value1, uint32_t value2, int numberOfBits){
-	uint32_t negativeFlag = (1 << (numberOfBits-1));
-	flags.N = (value1 + value2) & negativeFlag;  
-	flags.Z = ((value1 + value2) == 0) ? true : false;
-	flags.V = ~(value1 ^ value2) & ((value1 + value2) ^ value1) & negativeFlag; // If both operands have the same sign and the results is from a different sign, overflow has occured.
+uint32_t getMemory32(uint32_t address){
+	return ((uint32_t)getMemory16(address) << 16) | getMemory16(address + 2);
 }
 
-void setFlagsMOV(uint32_t value, int numberOfBits){
-	flags.V = 0;
-	flags.Z = (value == 0x0);
-	switch(numberOfBits){
-		case 8:{
-			flags.N = value & 0x80;
-		}break;
-		case 16:{
-			flags.N = value & 0x8000;
-		}break;
-		case 32:{
-			flags.N = value & 0x80000000;
-		}break;
+// Block copy, one byte after the other in address order like EEPMOV does it. Runs where both sides are on the fast path
+// go as one memmove each, whatever is watched, journaled, a device register or translated code goes a byte at a time
+// through the slow paths so it gets seen.
+void moveMemory(uint32_t from, uint32_t to, uint32_t count){
+	while(count){
+		from = from & ADDRESS_MASK;
+		to = to & ADDRESS_MASK;
+		uint32_t run = count;
+		run = (PAGE_SIZE - (from & PAGE_MASK) < run) ? PAGE_SIZE - (from & PAGE_MASK) : run;
+		run = (PAGE_SIZE - (to & PAGE_MASK) < run) ? PAGE_SIZE - (to & PAGE_MASK) : run;
+		uint32_t ahead = (to - from) & ADDRESS_MASK;
+		if (ahead && ahead < run){
+			run = ahead; // Writing just ahead of the source copies the bytes it has already written again
+		}
+		uint8_t* source = readPages[from >> PAGE_SHIFT];
+		uint8_t* destination = writePages[to >> PAGE_SHIFT];
+		if (source && destination){
+			memmove(destination + (to & PAGE_MASK), source + (from & PAGE_MASK), run);
+		} else{
+			for(uint32_t i = 0; i < run; i++){
+				setMemory8(to + i, getMemory8(from + i));
+			}
+		}
+		from += run;
+		to += run;
+		count -= run;
 	}
 }
 
+#include "alu.c"
+
 struct SSU_t{
 	uint8_t* SSCRH; // Control register H
 	uint8_t* SSCRL; // Control register L
@@ -240,37 +440,7 @@ struct SSU_t{
 };
 static struct SSU_t SSU;
 
-static uint8_t ssuBuffer[2];
-
-int main(){
-	//int entry = 0x02C4;
-	int entry = 0x0;
-	mode = RUN;
-	int instructionsToStep = 0;
-
-	// 0x0000 - 0xBFFF - ROM 
-	// 0xF020 - 0xF0FF - MMIO
-	// 0xF780 - 0xFF7F - RAM 
-	// 0xFF80 - 0xFFFF - MMIO
-	memory = malloc(64 * 1024);
-	memset(memory, 0, 64 * 1024);
-
-	accel_memory = malloc(29);
-	memset(accel_memory, 0, 29);
-	accel_memory[0] = 0x2; // Chip id
-
-	FILE* romFile = fopen("roms/shar.bin","r");
-	if(!romFile){
-		printf("Can't find rom");
-	}
-
-	fseek (romFile , 0 , SEEK_END);
-	int romSize = ftell (romFile);
-	rewind (romFile);
-
-	fread(memory,1,romSize ,romFile);
-
-	// Init SSU registers
+void mapSSURegisters(){
 	SSU.SSCRH = &memory[0xF0E0]; 
 	SSU.SSCRL = &memory[0xF0E1]; 
 	SSU.SSMR = &memory[0xF0E2]; 
@@ -278,1968 +448,1142 @@ int main(){
 	SSU.SSSR = &memory[0xF0E4]; 
 	SSU.SSRDR = &memory[0xF0E9]; 
 	SSU.SSTDR = &memory[0xF0EB]; 
-	SSU.SSTRSR = 0x0; 
-
-	*SSU.SSRDR = 0x0; 
-	*SSU.SSTDR = 0x0;
-	*SSU.SSER = 0x0; 
-	*SSU.SSSR = 0x4; // TDRE = 1 (Transmit data empty) 
-	
-	memset(ssuBuffer, 0xFF, 2);
-	// Init general purpose registers
-	for(int i=0; i < 8;i++){
-		ER[i] = malloc(4);
-		*ER[i] = 0;
-		R[i] = (uint16_t*) ER[i];
-		E[i] = (uint16_t*) ER[i] + 1;
-		RL[i] = (uint8_t*) R[i];
-		RH[i] = (uint8_t*) R[i] + 1;
-	}
-	SP = ER[7];
-	flags = (struct Flags){0};
-	printRegistersState();
-
-	int pc = entry;
-	while(pc != romSize){
-		uint16_t* currentInstruction = (uint16_t*)(memory + pc);
-		// IMPROVEMENT: maybe just use pointers to the ROM, left this way cause it seems cleaner
-		uint16_t ab = (*currentInstruction << 8) | (*currentInstruction >> 8); // 0xbHbL aHaL -> aHaL bHbL
-
-		uint8_t a = ab >> 8;
-		uint8_t aH = (a >> 4) & 0xF; 
-		uint8_t aL = a & 0xF;
-
-		uint8_t b = ab & 0xFF;
-		uint8_t bH = (b >> 4) & 0xF;
-		uint8_t bL = b & 0xF;
-
-		uint16_t cd = (*(currentInstruction + 1) << 8) | (*(currentInstruction + 1) >> 8);
-		uint8_t c = cd >> 8;
-		uint8_t cH = (c >> 4) & 0xF; 
-		uint8_t cL = c & 0xF;
-
-		uint8_t d = cd & 0xFF;
-		uint8_t dH = (d >> 4) & 0xF;
-		uint8_t dL = d & 0xF;
-
-		uint16_t ef = (*(currentInstruction + 2) << 8) | (*(currentInstruction + 2) >> 8);
-		uint8_t e = ef >> 8;
-		uint8_t eH = (e >> 4) & 0xF; 
-		uint8_t eL = e & 0xF;
-
-		uint8_t f = ef & 0xFF;
-		uint8_t fH = (f >> 4) & 0xF;
-		uint8_t fL = f & 0xF;
-
-		uint32_t cdef = cd << 16 | ef;
-		switch(aH){
-			case 0x0:{
-				switch(aL){
-					case 0x0:{
-						printf("%04x - NOP\n", pc);
-					}break;
-					case 0x1:{
-						switch(bH){ // NOTE. we're ignoring bL here, might not be necesary
-							case 0x0:{ // Lots of MOV.l type instructions and push.l + pop.l
-								switch(c){
-									case 0x6B:{
-										switch(dH){
-											case 0x0:{ // MOV.l @aa:16, Rd
-												uint32_t address = (ef & 0x0000FFFF) | 0x00FF0000; 
-												uint32_t value = getMemory32(address);
-
-												struct RegRef32 Rd = getRegRef32(dL);
-
-												setFlagsMOV(value, 32);
-												*Rd.ptr = value;
-
-												printf("%04x - MOV.l @%x:16, ER%d\n", pc, address, Rd.idx); 
-												printRegistersState();
-
-											}break;
-
-											case 0x8:{ // MOV.l Rs, @aa:16 
-												uint32_t address = (cdef & 0x0000FFFF) | 0x00FF0000; 
-
-												struct RegRef32 Rs = getRegRef32(dL);
-
-												uint32_t value = *Rs.ptr;
-												setFlagsMOV(value, 32);
-												setMemory32(address, value);
-
-												printf("%04x - MOV.l ER%d,@%x:16 \n", pc, Rs.idx, address); 
-												printMemory(address, 4);
-												printRegistersState();
-
-											}break;
-										}
-										pc += 4;
-
-
-									}break;
-									case 0x6D:{ // MOV.l @ERs+, ERd --- MOV.l ERs, @-ERd
-										char incOrDec = (dH & 0b1000) ? '-' : '+';
-
-										if (incOrDec == '+'){
-											struct RegRef32 Rs = getRegRef32(dH);
-											struct RegRef32 Rd = getRegRef32(dL);
-
-											uint32_t value = getMemory32(*Rs.ptr);
-
-											*Rs.ptr += 4;
-
-											setFlagsMOV(value, 32);
-											*Rd.ptr = value;
-
-											printf("%04x - MOV.l @ER%d+, ER%d\n", pc, Rs.idx, Rd.idx); 
-
-										} else{
-											struct RegRef32 Rs = getRegRef32(dL);
-											struct RegRef32 Rd = getRegRef32(dH);
-
-											*Rd.ptr -= 4;
-
-											uint32_t value = *Rs.ptr;
-											setMemory32(*Rd.ptr, value);
-											setFlagsMOV(value, 32);
-
-											printf("%04x - MOV.l ER%d, @-ER%d, \n", pc, Rs.idx, Rd.idx); 
-											printMemory(*Rd.ptr, 4);
-
-										}
-										printRegistersState();
-										pc +=2;
-
-
-									} break;
-									case 0x6F:{ 
-										uint16_t disp = ef;
-										bool msbDisp = disp & 0x8000;
-										uint32_t signExtendedDisp = msbDisp ? (0xFFFF0000 & disp) : disp;
-
-										if (!(dH & 0b1000)){ // From memory @(d:16, ERs), ERd
-											struct RegRef32 Rs = getRegRef32(dH);
-											struct RegRef32 Rd = getRegRef32(dL);
+}
 
-											uint32_t value = getMemory32(*Rs.ptr + signExtendedDisp); 
-											*Rd.ptr = value;
-											setFlagsMOV(value, 32);
-
-											printf("%04x - MOV.l @(%d:16, ER%d), ER%d\n", pc, disp, Rs.idx, Rd.idx); 
-
-										} else{ // To memory  ERs, @(d:16,ERd) 
-											struct RegRef32 Rs = getRegRef32(dL);
-											struct RegRef32 Rd = getRegRef32(dH);
-
-											uint32_t value = *Rs.ptr;
-											setFlagsMOV(value, 32);
-
-
-											setMemory32(*Rd.ptr + signExtendedDisp, value);
-											printf("%04x - MOV.l ER%d,@(%d:16, ER%d)\n", pc, Rs.idx, disp, Rd.idx); 
-											printMemory(*Rd.ptr + signExtendedDisp, 4);
-										}
-										printRegistersState();
-										pc+=4;
-									} break;
-									case 0x69:{ 
-										if (!(dH & 0x80)){ // MOV.L @ERs, ERd
-											struct RegRef32 Rs = getRegRef32(dH);
-											struct RegRef32 Rd = getRegRef32(dL);
-
-											uint32_t value = getMemory32(*Rs.ptr);
-
-											setFlagsMOV(value, 32);
-											*Rd.ptr = value;
-
-											printf("%04x - MOV.l @ER%d, ER%d\n", pc, Rs.idx, Rd.idx ); 
-											printRegistersState();
-										} else{ // MOV.l ERs, @ERd 
-											struct RegRef32 Rs = getRegRef32(bL);
-											struct RegRef32 Rd = getRegRef32(bH);
-											uint32_t value = *Rs.ptr;
-											setFlagsMOV(value, 32);
-											setMemory32(*Rd.ptr, value);
-											printf("%04x - MOV.l ER%d, @ER%d, \n", pc, Rs.idx, Rd.idx);
-											printMemory(*Rd.ptr, 4);
-										}
-										pc += 2;
-									}break;
-									case 0x66:{ // AND.L Rs, ERd
-										struct RegRef32 Rs = getRegRef32(dH);
-										struct RegRef32 Rd = getRegRef32(dL);
-
-										uint32_t value = *Rs.ptr;
-										uint32_t newValue = value & *Rd.ptr;
-
-										setFlagsMOV(newValue, 32);
-										*Rd.ptr = newValue;
-
-										printf("%04x - AND.l R%d, ER%d\n", pc, Rs.idx, Rd.idx ); 
-										printRegistersState();
-
-										pc += 2;
-									}break;
-									case 0x64:{ // OR.L Rs, ERd
-										struct RegRef32 Rs = getRegRef32(dH);
-										struct RegRef32 Rd = getRegRef32(dL);
-
-										uint32_t value = *Rs.ptr;
-										uint32_t newValue = value | *Rd.ptr;
-
-										setFlagsMOV(newValue, 32);
-										*Rd.ptr = newValue;
-
-										printf("%04x - OR.l R%d, ER%d\n", pc, Rs.idx, Rd.idx ); 
-										printRegistersState();
-
-										pc += 2;
-									}break;
-									case 0x65:{ // XOR.L Rs, ERd
-										struct RegRef32 Rs = getRegRef32(dH);
-										struct RegRef32 Rd = getRegRef32(dL);
-
-										uint32_t value = *Rs.ptr;
-										uint32_t newValue = value ^ *Rd.ptr;
-
-										setFlagsMOV(newValue, 32);
-										*Rd.ptr = newValue;
-
-										printf("%04x - XOR.l R%d, ER%d\n", pc, Rs.idx, Rd.idx ); 
-										printRegistersState();
-
-										pc += 2;
-									}break;
-
-								}
-
-							}break;
-							case 0x4:{
-								pc+=2;
-								if (bL == 0x0 && cH == 0x6){
-									switch(cL){
-										case 0x9:
-										case 0xB:
-										case 0xD:
-										case 0xF:{
-											uint8_t mostSignificantBit = dH >> 7;
-											if (mostSignificantBit == 0x1){
-												printf("%04x - STC\n", pc);
-											}else{
-												printf("%04x - LDC\n", pc);
-											}
-										}break;
-									}
-								}
-							}break;
-							case 0x8:{
-								printf("%04x - SLEEP\n", pc);
-							}break;
-							case 0xC:{
-								pc+=2;
-								if (bL == 0x0 && cH == 0x5){
-									switch(cL){
-										case 0x0:
-										case 0x2:{
-											printf("%04x - MULXS\n", pc);
-										}break;
-									}
-								};
-							}break;
-							case 0xD:{
-								pc+=2;
-								if (bL == 0x0 && cH == 0x5){
-									switch(cL){ // TODO replace with if, and see if merging it with C & F makes it more readable
-										case 0x1:
-										case 0x3:{
-											printf("%04x - DIVXS\n", pc);
-										}break;
-									}
-								};
-							}break;
-							case 0xF:{
-								pc+=2;
-								if (bL == 0x0 && cH == 0x6){
-									switch(cL){ // TODO replace with if, and see if merging it with C & F makes it more readable
-										case 0x4:{
-											printf("%04x - OR\n", pc);
-										}break;
-										case 0x5:{
-											printf("%04x - XOR\n", pc);
-										}break;
-										case 0x6:{
-											printf("%04x - AND\n", pc);
-										}break;
-									}
-								};
-							}break;
-
-							default:{
-								printf("???\n");
-							}break;
-
-						}
-					}break;
-					case 0x2:{
-						printf("%04x - STC\n", pc);
-					}break;
-					case 0x3:{
-						printf("%04x - LDC\n", pc);
-					}break;
-					case 0x4:{
-						printf("%04x - ORC\n", pc);
-					}break;
-					case 0x5:{
-						printf("%04x - XORC\n", pc);
-					}break;
-					case 0x6:{
-						printf("%04x - ANDC\n", pc);
-					}break;
-					case 0x7:{
-						printf("%04x - LDC\n", pc);
-					}break;
-					case 0x8:{ // ADD.B Rs, Rd
-						struct RegRef8 Rs = getRegRef8(bH);
-						struct RegRef8 Rd = getRegRef8(bL);
-
-						setFlagsADD(*Rd.ptr, *Rs.ptr, 8);
-						*Rd.ptr += *Rs.ptr;
-
-						printf("%04x - ADD.b R%d%c,R%d%c\n", pc, Rs.idx, Rs.loOrHiReg, Rd.idx, Rd.loOrHiReg); 
-						printRegistersState();
-					}break;
-					case 0x9:{ // ADD.W Rs, Rd
-						struct RegRef16 Rs = getRegRef16(bH);
-						struct RegRef16 Rd = getRegRef16(bL);
-
-						setFlagsADD(*Rd.ptr, *Rs.ptr, 16);
-
-						*Rd.ptr += *Rs.ptr;
-						printf("%04x - ADD.w %c%d,%c%d\n", pc, Rs.loOrHiReg, Rs.idx, Rd.loOrHiReg,  Rd.idx); 
-						printRegistersState();
-
-					}break;
-					case 0xA:{
-						switch(bH){
-							case 0x0:{ // INC.b Rd
-								struct RegRef8 Rd = getRegRef8(bL);
-								setFlagsINC(*Rd.ptr, 1, 8);
-								*Rd.ptr += 1;
-								printf("%04x - INC.b r%d%c\n", pc, Rd.idx, Rd.loOrHiReg);
-								printRegistersState();
-							}break;
-							case 0x8:
-							case 0x9:
-							case 0xA:
-							case 0xB:
-							case 0xC:
-							case 0xD:
-							case 0xE:
-							case 0xF:{ // ADD.l ERs, ERd
-								struct RegRef32 Rs = getRegRef32(bH);
-								struct RegRef32 Rd = getRegRef32(bL);
-
-								setFlagsADD(*Rd.ptr, *Rs.ptr, 32);
-
-								*Rd.ptr += *Rs.ptr;
-								printf("%04x - ADD.l ER%d, ER%d\n", pc, Rs.idx,  Rd.idx); 
-								printRegistersState();
-							}break;
-
-						}
-					}break;
-					case 0xB:{ // ADDS and INC
-						switch(bH){
-							case 0x0:{ // ADDS.l #1, ERd
-								struct RegRef32 Rd = getRegRef32(bL);
-								*Rd.ptr += 1;
-								printf("%04x - ADDS.l #1, ER%d\n", pc, Rd.idx);
-							}break;
-							case 0x8:{ // ADDS.l #2, ERd
-								struct RegRef32 Rd = getRegRef32(bL);
-								*Rd.ptr += 2;
-								printf("%04x - ADDS.l #2, ER%d\n", pc, Rd.idx);
-							}break;
-							case 0x9:{ // ADDS.l #4, ERd
-								struct RegRef32 Rd = getRegRef32(bL);
-								*Rd.ptr += 4;
-								printf("%04x - ADDS.l #4, ER%d\n", pc, Rd.idx);
-							}break;
-							case 0x5:{ // INC.w #1, Rd
-								struct RegRef16 Rd = getRegRef16(bL);
-								setFlagsINC(*Rd.ptr, 1, 16); 
-								*Rd.ptr += 1;
-								printf("%04x - INC.w #1, %c%d\n", pc, Rd.loOrHiReg, Rd.idx);
-							}break;
-							case 0x7:{ // INC.l #1, ERd
-								struct RegRef32 Rd = getRegRef32(bL);
-								setFlagsINC(*Rd.ptr, 1, 32);
-								*Rd.ptr += 1;
-								printf("%04x - INC.l #1, ER%d\n", pc, Rd.idx);
-							} break;
-							case 0xD:{ // INC.w #2, Rd
-								struct RegRef16 Rd = getRegRef16(bL);
-								setFlagsINC(*Rd.ptr, 2, 16);
-								*Rd.ptr += 2;
-								printf("%04x - INC.w #2, %c%d\n", pc, Rd.loOrHiReg, Rd.idx);
-							}break;
-							case 0xF:{ // INC.l #2, ERd
-								struct RegRef32 Rd = getRegRef32(bL);
-								setFlagsINC(*Rd.ptr, 2, 32);
-								*Rd.ptr += 2;
-								printf("%04x - INC.l #2, ER%d\n", pc, Rd.idx);
-							}break;
-						}
-						printRegistersState();
-					}break;
-					case 0xC:{ // MOV.B Rs, Rd
-						struct RegRef8 Rs = getRegRef8(bH);
-						struct RegRef8 Rd = getRegRef8(bL);
-
-						setFlagsMOV(*Rs.ptr, 8);
-						*Rd.ptr = *Rs.ptr;
-
-						printf("%04x - MOV.b R%d%c,R%d%c\n", pc, Rs.idx, Rs.loOrHiReg, Rd.idx, Rd.loOrHiReg); 
-						printRegistersState();
-
-					}break;
-					case 0xD:{ // MOV.W Rs, Rd
-						struct RegRef16 Rs = getRegRef16(bH);
-						struct RegRef16 Rd = getRegRef16(bL);
-
-						setFlagsMOV(*Rs.ptr, 16);
-
-						*Rd.ptr = *Rs.ptr;
-						printf("%04x - MOV.w %c%d,%c%d\n", pc, Rs.loOrHiReg, Rs.idx, Rd.loOrHiReg,  Rd.idx); 
-						printRegistersState();
-
-					}break;
-					case 0xE:{
-						printf("%04x - ADDX\n", pc);
-					}break;
-					case 0xF:{
-						switch(bH){
-							case 0x0:{
-								printf("%04x - DAA\n", pc);
-							}break;
-							case 0x8:
-							case 0x9:
-							case 0xA:
-							case 0xB:
-							case 0xC:
-							case 0xD:
-							case 0xE:
-							case 0xF:{// MOV.l ERs, ERd
-								struct RegRef32 Rs = getRegRef32(bH);
-								struct RegRef32 Rd = getRegRef32(bL);
-
-								setFlagsMOV(*Rs.ptr, 32);
-
-								*Rd.ptr = *Rs.ptr;
-								printf("%04x - MOV.l ER%d, ER%d\n", pc, Rs.idx,  Rd.idx); 
-								printRegistersState();
-							}break;
-						}
-					}break;
+static uint8_t ssuBuffer[2];
 
-				}
-			}break;
-			case 0x1:{
-				switch(aL){
-					case 0x0:{
-						switch(bH){
-							case 0x0:{ // SHLL.b Rd
-								struct RegRef8 Rd = getRegRef8(bL);
-								flags.C = *Rd.ptr & 0x80;
-								*Rd.ptr = (*Rd.ptr << 1);
-								setFlagsMOV(*Rd.ptr, 8);
-								printf("%04x - SHLL.b r%d%c\n", pc, Rd.idx, Rd.loOrHiReg);
-							}break;
-							case 0x1:{ // SHLL.w Rd
-								struct RegRef16 Rd = getRegRef16(bL);
-								flags.C = *Rd.ptr & 0x8000;
-								*Rd.ptr = (*Rd.ptr << 1);
-								setFlagsMOV(*Rd.ptr, 16);
-								printf("%04x - SHLL.w %c%d\n", pc, Rd.loOrHiReg, Rd.idx);
-							} break;
-							case 0x3:{ // SHLL.l Rd
-								struct RegRef32 Rd = getRegRef32(bL);
-								flags.C = *Rd.ptr & 0x80000000;
-								*Rd.ptr = (*Rd.ptr << 1);
-								setFlagsMOV(*Rd.ptr, 32);
-								printf("%04x - SHLL.l er%d\n", pc, Rd.idx);
-							}break;
-							case 0x8:{ // SHAL.b Rd -- These differ in their treatment of the V flag
-								struct RegRef8 Rd = getRegRef8(bL);
-								flags.C = *Rd.ptr & 0x80;
-								*Rd.ptr = (*Rd.ptr << 1);
-								setFlagsMOV(*Rd.ptr, 8);
-								flags.V = flags.C && !(*Rd.ptr & 0x80);
-								printf("%04x - SHAL.b r%d%c\n", pc, Rd.idx, Rd.loOrHiReg);
-							}break;
-							case 0x9:{ // SHAL.w Rd
-								struct RegRef16 Rd = getRegRef16(bL);
-								flags.C = *Rd.ptr & 0x8000;
-								*Rd.ptr = (*Rd.ptr << 1);
-								setFlagsMOV(*Rd.ptr, 16);
-								flags.V = flags.C && !(*Rd.ptr & 0x8000);
-								printf("%04x - SHAL.w %c%d\n", pc, Rd.loOrHiReg, Rd.idx);
-							}break;
-							case 0xB:{ // SHAL.l Rd
-								struct RegRef32 Rd = getRegRef32(bL);
-								flags.C = *Rd.ptr & 0x80000000;
-								*Rd.ptr = (*Rd.ptr << 1);
-								setFlagsMOV(*Rd.ptr, 32);
-								flags.V = flags.C && !(*Rd.ptr & 0x80000000);
-								printf("%04x - SHAL.l er%d\n", pc, Rd.idx);
-							}break;
-						}
-						printRegistersState();
-					}break;
-					case 0x1:{
-						switch(bH){
-							case 0x0:{ // SHLR.b Rd
-								struct RegRef8 Rd = getRegRef8(bL);
-								flags.C = *Rd.ptr & 0x1;
-								*Rd.ptr = (*Rd.ptr >> 1);
-								setFlagsMOV(*Rd.ptr, 8);
-								printf("%04x - SHLR.b r%d%c\n", pc, Rd.idx, Rd.loOrHiReg);
-							}break;
-							case 0x1:{ // SHLR.w Rd
-								struct RegRef16 Rd = getRegRef16(bL);
-								flags.C = *Rd.ptr & 0x1;
-								*Rd.ptr = (*Rd.ptr >> 1);
-								setFlagsMOV(*Rd.ptr, 16);
-								printf("%04x - SHLR.w %c%d\n", pc, Rd.loOrHiReg, Rd.idx);
-							} break;
-							case 0x3:{ // SHLR.l Rd
-								struct RegRef32 Rd = getRegRef32(bL);
-								flags.C = *Rd.ptr & 0x1;
-								*Rd.ptr = (*Rd.ptr >> 1);
-								setFlagsMOV(*Rd.ptr, 32);
-								printf("%04x - SHLR.l er%d\n", pc, Rd.idx);
-							}break;
-							case 0x8:{ // SHAR.b Rd - Unused in the ROM
-								return 1;
-							}break;
-							case 0x9:{ // SHAR.w Rd
-								struct RegRef16 Rd = getRegRef16(bL);
-								flags.C = *Rd.ptr & 0x1;
-								*Rd.ptr = (*Rd.ptr >> 1) | (*Rd.ptr & 0x8000);
-								setFlagsMOV(*Rd.ptr, 16);
-								printf("%04x - SHAR.w %c%d\n", pc, Rd.loOrHiReg, Rd.idx);
-							}break;
-							case 0xB:{ // SHAR.l Rd
-								struct RegRef32 Rd = getRegRef32(bL);
-								flags.C = *Rd.ptr & 0x1;
-								*Rd.ptr = (*Rd.ptr >> 1) | (*Rd.ptr & 0x80000000);
-								setFlagsMOV(*Rd.ptr, 32);
-								printf("%04x - SHAR.l er%d\n", pc, Rd.idx);
-							}break;
-						}
-						printRegistersState();
-					}break;
-					case 0x2:{
-						switch(bH){
-							case 0x0:{ // ROTXL.b Rd
-								struct RegRef8 Rd = getRegRef8(bL);
-								bool oldCarry = flags.C;
-								flags.C = *Rd.ptr & 0x80;
-								*Rd.ptr = (*Rd.ptr << 1) | oldCarry;
-								setFlagsMOV(*Rd.ptr, 8);
-								printf("%04x - ROTXL.b r%d%c\n", pc, Rd.idx, Rd.loOrHiReg);
-							} break;
-							case 0x1:{ // ROTXL.w Rd
-								struct RegRef16 Rd = getRegRef16(bL);
-								bool oldCarry = flags.C;
-								flags.C = *Rd.ptr & 0x8000;
-								*Rd.ptr = (*Rd.ptr << 1) | oldCarry;
-								setFlagsMOV(*Rd.ptr, 16);
-								printf("%04x - ROTXL.w %c%d\n", pc, Rd.loOrHiReg, Rd.idx);
-							} break;
-							case 0x3:{ // ROTXL.l Rd
-								struct RegRef32 Rd = getRegRef32(bL);
-								bool oldCarry = flags.C;
-								flags.C = *Rd.ptr & 0x80000000;
-								*Rd.ptr = (*Rd.ptr << 1) | oldCarry;
-								setFlagsMOV(*Rd.ptr, 32);
-								printf("%04x - ROTXL.l er%d\n", pc, Rd.idx);
-							}break;
-							case 0x8:{ // ROTL.b Rd
-								struct RegRef8 Rd = getRegRef8(bL);
-								flags.C = *Rd.ptr & 0x80;
-								*Rd.ptr = (*Rd.ptr << 1) | flags.C;
-								setFlagsMOV(*Rd.ptr, 8);
-								printf("%04x - ROTL.b r%d%c\n", pc, Rd.idx, Rd.loOrHiReg);
-							} break;
-							case 0x9:{ // ROTL.w Rd
-								struct RegRef16 Rd = getRegRef16(bL);
-								flags.C = *Rd.ptr & 0x8000;
-								*Rd.ptr = (*Rd.ptr << 1) | flags.C;
-								setFlagsMOV(*Rd.ptr, 16);
-								printf("%04x - ROTL.w %c%d\n", pc, Rd.loOrHiReg, Rd.idx);
-							} break;
-							case 0xB:{ // ROTL.l Rd
-								struct RegRef32 Rd = getRegRef32(bL);
-								flags.C = *Rd.ptr & 0x80000000;
-								*Rd.ptr = (*Rd.ptr << 1) | flags.C;
-								setFlagsMOV(*Rd.ptr, 32);
-								printf("%04x - ROTL.l er%d\n", pc, Rd.idx);
-							}break;
-						}
-						printRegistersState();
-					}break;
-					case 0x3:{ // ROTR and ROTXR - Unused in the ROM
-						return 1;
-					}break;
-					case 0x4:{ // OR.B Rs, Rd
-						struct RegRef8 Rs = getRegRef8(bH);
-						struct RegRef8 Rd = getRegRef8(bL);
-
-						uint8_t newValue = *Rs.ptr | *Rd.ptr;
-
-						setFlagsMOV(newValue, 8);
-						*Rd.ptr = newValue;
-
-						printf("%04x - OR.b R%d%c,R%d%c\n", pc, Rs.idx, Rs.loOrHiReg, Rd.idx, Rd.loOrHiReg); 
-						printRegistersState();
-					}break;
-					case 0x5:{ // XOR.B Rs, Rd
-						struct RegRef8 Rs = getRegRef8(bH);
-						struct RegRef8 Rd = getRegRef8(bL);
-
-						uint8_t newValue = *Rs.ptr ^ *Rd.ptr;
-
-						setFlagsMOV(newValue, 8);
-						*Rd.ptr = newValue;
-
-						printf("%04x - XOR.b R%d%c,R%d%c\n", pc, Rs.idx, Rs.loOrHiReg, Rd.idx, Rd.loOrHiReg); 
-						printRegistersState();
-					}break;
-					case 0x6:{ // AND.B Rs, Rd
-						struct RegRef8 Rs = getRegRef8(bH);
-						struct RegRef8 Rd = getRegRef8(bL);
-
-						uint8_t newValue = *Rs.ptr & *Rd.ptr;
-
-						setFlagsMOV(newValue, 8);
-						*Rd.ptr = newValue;
-
-						printf("%04x - AND.b R%d%c,R%d%c\n", pc, Rs.idx, Rs.loOrHiReg, Rd.idx, Rd.loOrHiReg); 
-						printRegistersState();
-					}break;
-					case 0x7:{
-						switch(bH){
-							case 0x0:
-							case 0x1:
-							case 0x3:{
-								printf("%04x - NOT\n", pc);
-							}break;
-							case 0x5:
-							case 0x7:{
-								printf("%04x - EXTU\n", pc);
-							}break;
-							case 0x8:
-							case 0x9:
-							case 0xB:{
-								printf("%04x - NEG\n", pc);
-							}break;
-							case 0xD:
-							case 0xF:{
-								printf("%04x - EXTS\n", pc);
-							}break;
-
-						}
-					}break;
-					case 0x8:{ // SUB.b Rs, Rd
-						struct RegRef8 Rs = getRegRef8(bH);
-						struct RegRef8 Rd = getRegRef8(bL);
-
-						setFlagsSUB(*Rd.ptr, *Rs.ptr, 8);
-						*Rd.ptr -= *Rs.ptr;
-
-						printf("%04x - SUB.b R%d%c,R%d%c\n", pc, Rs.idx, Rs.loOrHiReg, Rd.idx, Rd.loOrHiReg); 
-						printRegistersState();
-
-					}break;
-					case 0x9:{ // SUB.W Rs, Rd
-
-						struct RegRef16 Rs = getRegRef16(bH);
-						struct RegRef16 Rd = getRegRef16(bL);
-
-						setFlagsSUB(*Rd.ptr, *Rs.ptr, 16);
-
-						*Rd.ptr -= *Rs.ptr;
-						printf("%04x - SUB.w %c%d,%c%d\n", pc, Rs.loOrHiReg, Rs.idx, Rd.loOrHiReg,  Rd.idx); 
-						printRegistersState();
-
-					}break;
-					case 0xA:{
-						switch(bH){
-							case 0x0:{ // DEC.b Rd
-								struct RegRef8 Rd = getRegRef8(bL);
-								setFlagsINC(*Rd.ptr, -1, 8);
-								*Rd.ptr -= 1;
-								printf("%04x - DEC.b r%d%c\n", pc, Rd.idx, Rd.loOrHiReg);
-								printRegistersState();
-							}break;
-							case 0x8:
-							case 0x9:
-							case 0xA:
-							case 0xB:
-							case 0xC:
-							case 0xD:
-							case 0xE:
-							case 0xF:{ // SUB.l ERs, ERd
-								struct RegRef32 Rs = getRegRef32(bH);
-								struct RegRef32 Rd = getRegRef32(bL);
-								
-								setFlagsSUB(*Rd.ptr, *Rs.ptr, 32);
-
-								*Rd.ptr -= *Rs.ptr;
-								printf("%04x - SUB.l ER%d, ER%d\n", pc, Rs.idx,  Rd.idx); 
-								printRegistersState();
-							}break;
-
-						}
-					}break;
-					case 0xB:{
-						switch(bH){
-							case 0x0:{ // SUBS #1, ERd
-								struct RegRef32 Rd = getRegRef32(bL);
-
-								*Rd.ptr -= 1;
-								printf("%04x - SUBS #1, ER%d\n", pc, Rd.idx); 
-								printRegistersState();
-							}break;
-							case 0x8:{ // SUBS #2, ERd
-								struct RegRef32 Rd = getRegRef32(bL);
-
-								*Rd.ptr -= 2;
-								printf("%04x - SUBS #2, ER%d\n", pc, Rd.idx); 
-								printRegistersState();
-							}break;
-							case 0x9:{ // SUBS #4, ERd
-								struct RegRef32 Rd = getRegRef32(bL);
-
-								*Rd.ptr -= 4;
-								printf("%04x - SUBS #4, ER%d\n", pc, Rd.idx); 
-								printRegistersState();
-							}break;
-							case 0x5:{ // DEC.w #1, Rd
-								struct RegRef16 Rd = getRegRef16(bL);
-								setFlagsINC(*Rd.ptr, -1, 16);
-								*Rd.ptr -= 1;
-								printf("%04x - DEC.w #1, %c%d\n", pc, Rd.loOrHiReg, Rd.idx);
-								printRegistersState();
-							}break;
-							case 0x7:{ // DEC.l #1, ERd
-								struct RegRef32 Rd = getRegRef32(bL);
-								setFlagsINC(*Rd.ptr, -1, 32);
-								*Rd.ptr -= 1;
-								printf("%04x - DEC.l #1, ER%d\n", pc, Rd.idx);
-								printRegistersState();
-							}break;
-							case 0xD:{ // DEC.w #2, Rd
-								struct RegRef16 Rd = getRegRef16(bL);
-								setFlagsINC(*Rd.ptr, -2, 16);
-								*Rd.ptr -= 2;
-								printf("%04x - DEC.w #2, %c%d\n", pc, Rd.loOrHiReg, Rd.idx);
-								printRegistersState();
-							}break;
-							case 0xF:{ // DEC.l #2, ERd
-								struct RegRef32 Rd = getRegRef32(bL);
-								setFlagsINC(*Rd.ptr, -2, 32);
-								*Rd.ptr -= 2;
-								printf("%04x - DEC.l #2, ER%d\n", pc, Rd.idx);
-								printRegistersState();
-							}break;
-						}
-					}break;
-					case 0xC:{ // CMP.b Rs, Rd
-						struct RegRef8 Rs = getRegRef8(bH);
-						struct RegRef8 Rd = getRegRef8(bL);
-
-						setFlagsSUB(*Rd.ptr, *Rs.ptr, 8);
-
-						printf("%04x - SUB.b R%d%c,R%d%c\n", pc, Rs.idx, Rs.loOrHiReg, Rd.idx, Rd.loOrHiReg); 
-						printRegistersState();
-
-					}break;
-					case 0xD:{ // CMP.W Rs, Rd
-						struct RegRef16 Rs = getRegRef16(bH);
-						struct RegRef16 Rd = getRegRef16(bL);
-						setFlagsSUB(*Rd.ptr, *Rs.ptr, 16);
-
-						printf("%04x - CMP.w %c%d,%c%d\n", pc, Rs.loOrHiReg, Rs.idx, Rd.loOrHiReg,  Rd.idx); 
-						printRegistersState();
-					}break;
-					case 0xE:{
-						printf("%04x - SUBX\n", pc);
-					}break;
-					case 0xF:{
-						switch(bH){
-							case 0x0:{
-								printf("%04x - DAS\n", pc);
-							}break;
-							case 0x8:
-							case 0x9:
-							case 0xA:
-							case 0xB:
-							case 0xC:
-							case 0xD:
-							case 0xE:
-							case 0xF:{ // CMP.l ERs, ERd
-								struct RegRef32 Rs = getRegRef32(bH);
-								struct RegRef32 Rd = getRegRef32(bL);
-
-								setFlagsSUB(*Rd.ptr, *Rs.ptr, 32);
-
-								printf("%04x - CMP.l ER%d, ER%d\n", pc, Rs.idx,  Rd.idx); 
-								printRegistersState();
-							}break;
-						}
-					}break;
-				}
+// Bcc condition field, shared by the d:8 and d:16 forms
+bool testCondition(uint8_t condition){
+	if (deferredCompare.bits){ // Straight from the CMP operands, N and V on their own need the flags
+		uint32_t a = deferredCompare.a;
+		uint32_t b = deferredCompare.b;
+		int32_t signedA = (int32_t)(a << (32 - deferredCompare.bits)); // Sign bit on top, they order like the operands
+		int32_t signedB = (int32_t)(b << (32 - deferredCompare.bits));
+		switch(condition){
+			case 0x0: return true;
+			case 0x1: return false;
+			case 0x2: return a > b;
+			case 0x3: return a <= b;
+			case 0x4: return a >= b;
+			case 0x5: return a < b;
+			case 0x6: return a != b;
+			case 0x7: return a == b;
+			case 0xC: return signedA >= signedB;
+			case 0xD: return signedA < signedB;
+			case 0xE: return signedA > signedB;
+			case 0xF: return signedA <= signedB;
+			default:{
+				settleFlags();
 			}break;
+		}
+	}
+	switch(condition){
+		case 0x0: return true; // BRA
+		case 0x1: return false; // BRN
+		case 0x2: return !(flags.C || flags.Z); // BHI
+		case 0x3: return flags.C || flags.Z; // BLS
+		case 0x4: return !flags.C; // BCC
+		case 0x5: return flags.C; // BCS
+		case 0x6: return !flags.Z; // BNE
+		case 0x7: return flags.Z; // BEQ
+		case 0x8: return !flags.V; // BVC
+		case 0x9: return flags.V; // BVS
+		case 0xA: return !flags.N; // BPL
+		case 0xB: return flags.N; // BMI
+		case 0xC: return flags.N == flags.V; // BGE
+		case 0xD: return flags.N != flags.V; // BLT
+		case 0xE: return !flags.Z && flags.N == flags.V; // BGT
+		case 0xF: return flags.Z || flags.N != flags.V; // BLE
+	}
+	return false;
+}
 
-			case 0x2:{ // MOV.B @aa:8, Rd
-				uint32_t address = (b & 0x000000FF) | 0x00FFFF00; // Upper 16 bits assumed to be 1
-				uint8_t value = getMemory8(address);
-
-				struct RegRef8 Rd = getRegRef8(aL);
-				setFlagsMOV(value, 8);
-				*Rd.ptr = value;
-
-				printf("%04x - MOV.b @%x:8, R%d%c\n", pc, address, Rd.idx, Rd.loOrHiReg); 
-				printRegistersState();
-
+static bool trace = true; // Prints every instruction and the registers after it
+
+// Run control. Everything that has to happen at a given point in time is folded into nextEventCycle,
+// so the dispatch loop pays a single compare per instruction for all of it.
+#define STATES_PER_SECOND 3686400 // System clock
+static uint64_t cycles; // States since reset
+static uint64_t instructions;
+static uint64_t cycleLimit = UINT64_MAX;
+static uint64_t instructionLimit = UINT64_MAX;
+static uint64_t nextEventCycle;
+static uint32_t stopAtPc = 0xFFFFFFFF; // These two ride on the breakpoint bitmap
+static uint32_t imageEnd = 0xFFFFFFFF; // Test images just run off their end
+static bool stopOnUnimplemented;
+static const char* stopReason; // The loop exits once this is set
+
+void scheduleAtCycle(uint64_t cycle){
+	if (cycle < nextEventCycle){
+		nextEventCycle = cycle;
+	}
+}
 
-			}break;
-			case 0x3:{ // MOV.B Rs, @aa:8 
-				uint32_t address = (b & 0x000000FF) | 0x00FFFF00; // Upper 16 bits assumed to be 1
+// Stop addresses share the breakpoint bitmap, this puts them back after a debugger cleared it
+void addStopBreakpoints(){
+	if (stopAtPc != 0xFFFFFFFF){
+		addBreakpoint(stopAtPc);
+	}
+	if (imageEnd != 0xFFFFFFFF){
+		addBreakpoint(imageEnd);
+	}
+}
 
-				struct RegRef8 Rs = getRegRef8(aL);
-				uint8_t value = *Rs.ptr;
-				setFlagsMOV(value, 8);
-				setMemory8(address, value);
+#include "interrupts.c"
+#include "ports.c"
+#include "rtc.c"
+#include "watchdog.c"
+#include "input.c"
+#include "rewind.c"
+#include "console.c"
+#include "log.c"
+#include "buzzer.c"
+#include "mmio.c"
+
+// Device registers that have to see writes as they happen, see addDeviceRegisters
+void deviceWrite(uint16_t address, uint8_t value){
+	if (logWanted(LOG_MEMORY, LOG_DEBUG)){
+		logValues(LOG_DEVICE_WRITE, address, value, 0);
+	}
+	if (portWrite(address, value)){
+		return;
+	}
+	if (address == IENR1 || address == IWPR){
+		checkInterrupts();
+	} else if (address >= RTCFLG && address < RTCFLG + RTC_REGISTERS){
+		rtcWrite(address, value);
+	} else if (address >= TCSRWD1 && address < TCSRWD1 + WATCHDOG_REGISTERS){
+		watchdogWrite(address, value);
+	} else if (address >= TMRW && address < TMRW + TIMER_W_REGISTERS){
+		updateBuzzer(address);
+	}
+}
 
-				printf("%04x - MOV.b R%d%c,@%x:8 \n", pc, Rs.idx, Rs.loOrHiReg, address); 
-				printMemory(address, 1);
-				printRegistersState();
+// No instruction takes less than 2 states, so we can't run past the instruction before this fires.
+// It may fire early, serviceEvents checks the real count and schedules again.
+void scheduleAtInstruction(uint64_t instruction){
+	if (instruction != UINT64_MAX){
+		scheduleAtCycle(cycles + ((instruction > instructions) ? (instruction - instructions) * 2 : 0));
+	}
+}
 
+void scheduleNextEvent(){
+	nextEventCycle = cycleLimit;
+	scheduleAtCycle(nextInputCycle());
+	scheduleAtInstruction(instructionLimit);
+	scheduleAtInstruction(nextCheckpointInstruction);
+	scheduleAtInstruction(pauseAtInstruction);
+	scheduleAtCycle(nextConsolePoll);
+	scheduleAtCycle(nextBuzzerEdge);
+	scheduleAtCycle(rtc.nextTick);
+	scheduleAtCycle(watchdog.expiry);
+}
 
+// While asleep only things on the state clock can change anything, instruction counts stand still. The console isn't
+// one of them, it doesn't run on states (see serviceEvents)
+uint64_t nextWakeCycle(){
+	uint64_t wake = cycleLimit;
+	uint64_t input = nextInputCycle();
+	wake = (input < wake) ? input : wake;
+	wake = (nextBuzzerEdge < wake) ? nextBuzzerEdge : wake;
+	wake = (rtc.nextTick < wake) ? rtc.nextTick : wake;
+	return (watchdog.expiry < wake) ? watchdog.expiry : wake;
+}
 
-			}break;
-			case 0x4:{
-				int8_t disp = b;
-
-				switch(aL){
-					case 0x0:{ // BRA d:8
-						printf("%04x - BRA %d:8\n", pc, disp);
-						pc += disp; 
-					}break;
-					case 0x1:{ // Unused in the ROM
-						printf("%04x - BRN %d:8\n", pc, disp);
-					}break;
-					case 0x2:{
-						printf("%04x - BHI %d:8\n", pc, disp);
-						if(!(flags.C | flags.Z)){
-							pc += disp;
-						}
-					}break;
-					case 0x3:{
-						printf("%04x - BLS %d:8\n", pc, disp);
-						if((flags.C | flags.Z)){
-							pc += disp;
-						}
-					}break;
-					case 0x4:{
-						printf("%04x - BCC %d:8\n", pc, disp);
-						if(!(flags.C)){
-							pc += disp;
-						}
-					}break;
-					case 0x5:{
-						printf("%04x - BCS %d:8\n", pc, disp);
-						if(flags.C){
-							pc += disp;
-						}
-					}break;
-					case 0x6:{
-						printf("%04x - BNE %d:8\n", pc, disp);
-						if(!(flags.Z)){
-							pc += disp;
-						}
-					}break;
-					case 0x7:{
-						printf("%04x - BEQ %d:8\n", pc, disp);
-						if(flags.Z){
-							pc += disp;
-						}
-					}break;
-					case 0x8:{
-						printf("%04x - BVC %d:8\n", pc, disp);
-						if(!(flags.V)){
-							pc += disp;
-						}
-					}break;
-					case 0x9:{
-						printf("%04x - BVS %d:8\n", pc, disp);
-						if(flags.V){
-							pc += disp;
-						}
-					}break;
-					case 0xA:{
-						printf("%04x - BPL %d:8\n", pc, disp);
-						if(!(flags.N)){
-							pc += disp;
-						}
-					}break;
-					case 0xB:{
-						printf("%04x - BMI %d:8\n", pc, disp);
-						if(flags.N){
-							pc += disp;
-						}
-					}break;
-					case 0xC:{
-						printf("%04x - BGE %d:8\n", pc, disp);
-						if(!(flags.N ^ flags.V)){
-							pc += disp;
-						}
-					}break;
-					case 0xD:{
-						printf("%04x - BLT %d:8\n", pc, disp);
-						if((flags.N ^ flags.V)){
-							pc += disp;
-						}
-
-					}break;
-					case 0xE:{
-						printf("%04x - BGT %d:8\n", pc, disp);
-						if(!(flags.Z | (flags.N ^ flags.V))){
-							pc += disp;
-						}
-
-					}break;
-					case 0xF:{
-						printf("%04x - BLE %d:8\n", pc, disp);
-						if(flags.Z | (flags.N ^ flags.V)){
-							pc += disp;
-						}
-					}break;
+void serviceEvents(){
+	do{
+		if (sleeping){
+			uint64_t wake = nextWakeCycle();
+			if (wake == UINT64_MAX){
+				if (!consoleRunning || consoleLoad(&consoleClosed)){
+					stopReason = "asleep with nothing to wake it up";
+					break;
 				}
-			}break;
-			case 0x5:{
-				switch(aL){
-					case 0x0:
-					case 0x2:{
-						printf("%04x - MULXU\n", pc);
-					}break;
-					case 0x1:
-					case 0x3:{
-						printf("%04x - DIVXU\n", pc);
-					}break;
-					case 0x4:{ // RTS
-						printf("%04x - RTS\n", pc);
-						pc = getMemory16(*SP) - 2;
-						*SP += 2;
-						printRegistersState();
-					}break;
-					case 0x5:{ // BSR d:8
-						int8_t disp = b;
-						printf("%04x - BSR @%d:8\n", pc, disp);
-						*SP -= 2;
-						setMemory16(*SP, pc + 2);
-
-						pc = pc + disp; // No need to increment pc by 2 since we're always doing that at the end of the loop
-
-						printMemory(*SP, 2);
-						printRegistersState();
-					}break;
-					case 0xC:{ // BSR d:16
-						int16_t disp = cd; 
-						printf("%04x - BSR @%d:16\n", pc, disp);
-						*SP -= 2;
-						setMemory16(*SP, pc + 4);
-
-						pc = pc + 2 + disp; // Increment pc by 2 since we need the next instruction (pc + 4) and we're already adding 2 at the end of the loop.
-
-						printMemory(*SP, 2);
-						printRegistersState();
-					}break;
-					case 0x6:{
-						printf("%04x - RTE\n", pc);
-					}break;
-					case 0x7:{
-						printf("%04x - TRAPA\n", pc);
-					}break;
-					case 0x8:{
-						int16_t disp = cd;
-						switch(bH){
-							case 0x0:{
-								printf("%04x - BRA %d:16\n", pc, disp);
-								pc += 2 + disp;
-							}break;
-							case 0x1:{ // Unused in the ROM
-								printf("%04x - BRN %d:16\n", pc, disp);
-							}break;
-							case 0x2:{
-								printf("%04x - BHI %d:16\n", pc, disp);
-								if(!(flags.C | flags.Z)){
-									pc += 2 + disp;
-								}else{
-									pc += 2;
-								}
-							}break;
-							case 0x3:{
-								printf("%04x - BLS %d:16\n", pc, disp);
-								if(flags.C | flags.Z){
-									pc += 2 + disp;
-								}else{
-									pc += 2;
-								}
-
-							}break;
-							case 0x4:{
-								printf("%04x - BCC %d:16\n", pc, disp);
-								if(!flags.C){
-									pc += 2 + disp;
-								}else{
-									pc += 2;
-								}
-
-							}break;
-							case 0x5:{
-								printf("%04x - BCS %d:16\n", pc, disp);
-								if(flags.C){
-									pc += 2 + disp;
-								}else{
-									pc += 2;
-								}
-
-							}break;
-							case 0x6:{
-								printf("%04x - BNE %d:16\n", pc, disp);
-								if(!flags.Z){
-									pc += 2 + disp;
-								}else{
-									pc += 2;
-								}
-
-							}break;
-							case 0x7:{
-								printf("%04x - BEQ %d:16\n", pc, disp);
-								if(flags.Z){
-									pc += 2 + disp;
-								}else{
-									pc += 2;
-								}
-
-							}break;
-							case 0x8:{
-								printf("%04x - BVC %d:16\n", pc, disp);
-								if(!flags.V){
-									pc += 2 + disp;
-								}else{
-									pc += 2;
-								}
-
-							}break;
-							case 0x9:{
-								printf("%04x - BVS %d:16\n", pc, disp);
-								if(flags.V){
-									pc += 2 + disp;
-								}else{
-									pc += 2;
-								}
-
-							}break;
-							case 0xA:{
-								printf("%04x - BPL %d:16\n", pc, disp);
-								if(!flags.N){
-									pc += 2 + disp;
-								}else{
-									pc += 2;
-								}
-
-							}break;
-							case 0xB:{
-								printf("%04x - BMI %d:16\n", pc, disp);
-								if(flags.N){
-									pc += 2 + disp;
-								}else{
-									pc += 2;
-								}
-
-							}break;
-							case 0xC:{
-								printf("%04x - BGE %d:16\n", pc, disp);
-								if(!(flags.N ^ flags.V)){
-									pc += 2 + disp;
-								}else{
-									pc += 2;
-								}
-
-							}break;
-							case 0xD:{
-								printf("%04x - BLT %d:16\n", pc, disp);
-								if(flags.N ^ flags.V){
-									pc += 2 + disp;
-								}else{
-									pc += 2;
-								}
-
-							}break;
-							case 0xE:{
-								printf("%04x - BGT %d:16\n", pc, disp);
-								if(!(flags.Z | (flags.N ^ flags.V))){
-									pc += 2 + disp;
-								}else{
-									pc += 2;
-								}
-
-							}break;
-							case 0xF:{
-								printf("%04x - BLE %d:16\n", pc, disp);
-								if((flags.Z | (flags.N ^ flags.V))){
-									pc += 2 + disp;
-								}else{
-									pc += 2;
-								}
-
-							}break;
-						}				
-					}break;
-					case 0x9:{ // JMP @ERn
-						struct RegRef32 Er = getRegRef32(bH);
-						printf("%04x - JMP @ER%d\n", pc, Er.idx);
-						pc = *Er.ptr - 2; // Sub 2 cause we're incrementing 2 at the end of the loop
-					}break;
-					case 0xA:{ // JMP @aa:24
-						uint32_t address = (b << 16) | cd;
-						printf("%04x - JMP @0x%04x:24\n", pc, address);
-						pc = address - 2; // Sub 2 cause we're incrementing 2 at the end of the loop
-					}break;
-					case 0xB:{ // JMP @@aa:8 - UNUSED IN THE ROM, left unimplemented.
-						printf("%04x - ????\n", pc);
-					}break;
-					case 0xD:{ // JSR @ERn
-						struct RegRef32 Er = getRegRef32(bH);
-						
-						*SP -= 2;
-						setMemory16(*SP, pc + 2);
-
-						printf("%04x - JSR @ER%d\n", pc, Er.idx);
-						pc = *Er.ptr - 2; // Sub 2 cause we're incrementing 2 at the end of the loop
-
-						printMemory(*SP, 2);
-						printRegistersState();
-					}break;
-					case 0xE:{ // JSR @aa:24
-						uint32_t address = (b << 16) | cd;
-
-						*SP -= 2;
-						setMemory16(*SP, pc + 4);
-
-						printf("%04x - JSR @0x%04x:24\n", pc, address);
-						pc = address - 2; // Sub 2 cause we're incrementing 2 at the end of the loop
-
-						printMemory(*SP, 2);
-						printRegistersState();
-
-					}break;
-					case 0xF:{ // JSR @@aa:24 - UNUSED IN THE ROM, left unimplemented.
-						printf("%04x - ????\n", pc);
-					}break;
+				waitForConsoleSignal(); // Only a console command can change anything now
+				nextConsolePoll = cycles; // Take it right away
+			} else if (wake > cycles){
+				cycles = wake;
+			}
+		}
+		replayInputs();
+		serviceRewind();
+		serviceConsole();
+		serviceBuzzer();
+		serviceRtc();
+		serviceWatchdog();
+		serviceInterrupts();
+		if (instructions >= instructionLimit){
+			stopReason = "instruction limit";
+		} else if (cycles >= cycleLimit){
+			stopReason = "cycle limit";
+		}
+		scheduleNextEvent();
+	} while(sleeping && !stopReason && (mode == RUN || mode == GDB_RUN)); // Paused, the SLEEP runs again when we go on
+}
 
-				}
-			}break;
-			case 0x6:{
-				switch(aL){
-					case 0x0:{ // BSET Rn, Rd
-
-						struct RegRef8 Rd = getRegRef8(bL);		
-						struct RegRef8 Rn = getRegRef8(bH);		
-						int bitToSet = *Rn.ptr;
-
-						*Rd.ptr = *Rd.ptr | (1 << bitToSet);
-
-						printf("%04x - BSET r%d%c, r%d%c\n", pc, Rn.idx, Rn.loOrHiReg, Rd.idx, Rd.loOrHiReg);
-						printRegistersState();
-					}break;
-					case 0x1:{
-						printf("%04x - BNOT\n", pc);
-					}break;
-					case 0x2:{ // BCLR Rn, Rd
-						struct RegRef8 Rd = getRegRef8(bL);		
-						struct RegRef8 Rn = getRegRef8(bH);		
-						int bitToClear = *Rn.ptr;
-
-						*Rd.ptr = *Rd.ptr & ~(1 << bitToClear);
-
-						printf("%04x - BCLR r%d%c, r%d%c\n", pc, Rn.idx, Rn.loOrHiReg, Rd.idx, Rd.loOrHiReg);
-						printRegistersState();
-					}break;
-					case 0x3:{
-						printf("%04x - BTST\n", pc);
-					}break;
-					case 0x4:{ // OR.w Rs, Rd
-						struct RegRef16 Rd = getRegRef16(bL);
-						struct RegRef16 Rs = getRegRef16(bH);
-						uint16_t newValue = *Rs.ptr | *Rd.ptr;
-						setFlagsMOV(newValue, 16);
-						*Rd.ptr = newValue;
-
-						printf("%04x - OR.w %c%d,%c%d\n", pc, Rs.loOrHiReg, Rs.idx, Rd.loOrHiReg,  Rd.idx); 
-						printRegistersState();
-					}break;
-					case 0x5:{ // XOR.w Rs, Rd
-						struct RegRef16 Rd = getRegRef16(bL);
-						struct RegRef16 Rs = getRegRef16(bH);
-						uint16_t newValue = *Rs.ptr ^ *Rd.ptr;
-						setFlagsMOV(newValue, 16);
-						*Rd.ptr = newValue;
-
-						printf("%04x - XOR.w %c%d,%c%d\n", pc, Rs.loOrHiReg, Rs.idx, Rd.loOrHiReg,  Rd.idx); 
-						printRegistersState();
-					}break;
-					case 0x6:{ // AND.w Rs, Rd
-						struct RegRef16 Rd = getRegRef16(bL);
-						struct RegRef16 Rs = getRegRef16(bH);
-						uint16_t newValue = *Rs.ptr & *Rd.ptr;
-						setFlagsMOV(newValue, 16);
-						*Rd.ptr = newValue;
-
-						printf("%04x - AND.w %c%d,%c%d\n", pc, Rs.loOrHiReg, Rs.idx, Rd.loOrHiReg,  Rd.idx); 
-						printRegistersState();
-					}break;
-					case 0x7:{
-						uint8_t mostSignificantBit = bH >> 7;
-						if (mostSignificantBit == 0x1){
-							printf("%04x - BIST\n", pc);
-						}else{
-							printf("%04x - BST\n", pc);
-						}					
-					}break;
-					case 0x8:{ 
-						if(!(b & 0x80)){ // MOV.B @ERs, Rd
-							struct RegRef32 Rs = getRegRef32(bH);
-							struct RegRef8 Rd = getRegRef8(bL);
-
-							uint8_t value = getMemory8(*Rs.ptr);
-
-							setFlagsMOV(value, 8);
-							*Rd.ptr = value;
-
-							printf("%04x - MOV.b @ER%d, R%d%c\n", pc, Rs.idx, Rd.idx, Rd.loOrHiReg); 
-						} else{// MOV.B Rs, @ERd 
-							struct RegRef8 Rs = getRegRef8(bL);
-							struct RegRef32 Rd = getRegRef32(bH);
-
-							uint8_t value = *Rs.ptr;
-
-							setFlagsMOV(value, 8);
-							setMemory8(*Rd.ptr, value);
-							printf("%04x - MOV.b R%d%c, @ER%d, \n", pc, Rs.idx, Rs.loOrHiReg, Rd.idx);
-							printMemory(*Rd.ptr, 1);
-						}
-						printRegistersState();
-					}break;
-					case 0x9:{ 
-						if(!(b & 0x80)){ // MOV.w @ERs, Rd
-							struct RegRef32 Rs = getRegRef32(bH);
-							struct RegRef16 Rd = getRegRef16(bL);
-							uint16_t value = getMemory16(*Rs.ptr);
-							setFlagsMOV(value, 16);
-							*Rd.ptr = value;
-							printf("%04x - MOV.w @ER%d, %c%d\n", pc, Rs.idx, Rd.loOrHiReg, Rd.idx ); 
-						} else{ // MOV.w Rs, @ERd 
-							struct RegRef16 Rs = getRegRef16(bL);
-							struct RegRef32 Rd = getRegRef32(bH);
-							uint16_t value = *Rs.ptr;
-							setFlagsMOV(value, 16);
-							setMemory16(*Rd.ptr, value);
-							printf("%04x - MOV.w R%d%c, @ER%d, \n", pc, Rs.idx, Rs.loOrHiReg, Rd.idx);
-							printMemory(*Rd.ptr, 2);
-						}
-						printRegistersState();
-
-					} break;
-					case 0xA:{ 
-						switch(bH){
-							case 0x0:{ // MOV.B @aa:16, Rd
-								uint32_t address = (cd & 0x0000FFFF) | 0x00FF0000; // Upper 16 bits assumed to be 1
-								uint8_t value = getMemory8(address);
-
-								struct RegRef8 Rd = getRegRef8(bL);
-
-								setFlagsMOV(value, 8);
-								*Rd.ptr = value;
-
-								printf("%04x - MOV.b @%x:16, R%d%c\n", pc, address, Rd.idx, Rd.loOrHiReg); 
-								printRegistersState();
-
-							}break;
-
-							case 0x8:{ // MOV.B Rs, @aa:16 
-								uint32_t address = (cd & 0x0000FFFF) | 0x00FF0000; // Upper 16 bits assumed to be 1
-
-								struct RegRef8 Rs = getRegRef8(bL);
-
-								uint8_t value = *Rs.ptr;
-								setFlagsMOV(value, 8);
-								setMemory8(address, value);
+// Drops the emulator into STEP mode, the next instruction won't run until we get input.
+void stopAndWaitForInput(){
+	mode = STEP;
+	waitForConsole();
+}
 
-								printf("%04x - MOV.b R%d%c,@%x:16 \n", pc, Rs.idx, Rs.loOrHiReg, address); 
-								printMemory(address, 1);
-								printRegistersState();
+#include "disassembler.c"
+#include "gdb.c"
+#include "hang.c"
+#include "coverage.c"
+#include "fusion.c"
+
+// Runs after every instruction, the serial unit reacts to whatever the instruction wrote to its registers
+void serviceSSU(){
+	if ((*SSU.SSER & 0xC0) == 0xC0){ // TE and RE flags. Transmission and recieve enabled
+		if(*SSU.SSTDR != 0){ // When we write data to SSTDR
+			*SSU.SSSR = clearBit8(*SSU.SSSR, 1); // RDRF = 0. Clear Receive Data Register Full.  
+			// Here we'll start the transmission that'll take 8 cycles. But for now it happens instantly.
+			// Accelerometer
+			if(~(peekMemory8(0xFFDC)) & 0x1){ // Pin 9 low
+				if(ssuBuffer[0] == 0xFF){
+					ssuBuffer[0] = *SSU.SSTDR & 0x0F; // We'll store the address here. The "&" removes 0x80 (RW flag, not part of the address)
+					ssuBuffer[1] = 0; // And the offset here
+				} else{
+					*SSU.SSRDR = accel_memory[(ssuBuffer[0]) + ssuBuffer[1]]; 
+					ssuBuffer[1] += 1;
+				}					
+			}
+			if (logWanted(LOG_SSU, LOG_DEBUG)){
+				logValues(LOG_SSU_TRANSFER, *SSU.SSTDR, *SSU.SSRDR, true);
+			}
+			*SSU.SSTDR = 0;
+			*SSU.SSSR = *SSU.SSSR | (1<<1); // // RDRF = 1. Receive Data Register Full
+			*SSU.SSSR = *SSU.SSSR | (1<<3); // TEND = 1. Transmit Data End. 
+		}
+	}
+	else if (*SSU.SSER & 0x80){ // TE flag. Transmission enabled
+		if(*SSU.SSTDR != 0){ // When we write data to SSTDR
+			*SSU.SSSR = clearBit8(*SSU.SSSR, 2); // TDRE = 0. Transmit Data Empty.  
+			//SSU.SSTRSR = *SSU.SSTDR;
+			// Accelerometer
+			if(~(peekMemory8(0xFFDC)) & 0x1){ // Pin 9 low
+				if(ssuBuffer[0] == 0xFF){
+					ssuBuffer[0] = *SSU.SSTDR;
+				} else if (ssuBuffer[1] == 0xFF){
+					ssuBuffer[1] = *SSU.SSTDR;
+					accel_memory[ssuBuffer[0]] = ssuBuffer[1];
+					memset(ssuBuffer, 0xFF, 2);
+				} 	
+			}
+			if (logWanted(LOG_SSU, LOG_DEBUG)){
+				logValues(LOG_SSU_TRANSFER, *SSU.SSTDR, 0, false);
+			}
+			*SSU.SSTDR = 0;
+			*SSU.SSSR = *SSU.SSSR | (1<<2); // TDRE = 1. Transmit Data Empty. (TODO: optimize away)
+			if (*SSU.SSER & 0b100){
+				// generate TX1. Maybe doesnt happen in the ROM
+			}
+			// Here we'll start the transmission that'll take 8 cycles. But for now it happens instantly.
+			*SSU.SSSR = *SSU.SSSR | (1<<3); // TEND = 1. Transmit Data End. 
+		}
+	}
+	else if (*SSU.SSER & 0x40){ // RE flag. Recieve enabled. 
+		stopReason = "SSU receive only mode"; //TODO: Check if this mode is used in the ROM
+		return;
+		if(*SSU.SSRDR != 0){ // When we write data to SSRDR
+			*SSU.SSSR = *SSU.SSSR | (1<<1); // // RDRF = 1. Receive Data Register Full
+			SSU.SSTRSR = *SSU.SSRDR; // Manual says this doesnt happen, SSTRSR isnt used in recieves.
+			*SSU.SSRDR = 0;
 
-							}break;
-						}
-						pc+=2;
+			*SSU.SSSR = clearBit8(*SSU.SSSR, 1); // RDRF = 0. Receive Data Register not Full   
+			// Here we'll start the transmission that'll take 8 cycles. But for now it happens instantly.
+			*SSU.SSER = clearBit8(*SSU.SSSR, 6); // RE = 0. 
+			*SSU.SSSR = clearBit8(*SSU.SSSR, 5); // RSSTP = 0. Receive single stop
+		}
+	}
+	
+	if((peekMemory8(0xFFDC)) & 0x1){ // Pin 9 high
+		*SSU.SSRDR = 0;
+		memset(ssuBuffer, 0xFF, 2);
+	}
+}
 
-					}break;
-					case 0xB:{
-						switch(bH){
-							case 0x0:{ // MOV.w @aa:16, Rd
-								uint32_t address = (cd & 0x0000FFFF) | 0x00FF0000; // Upper 16 bits assumed to be 1
-								uint16_t value = getMemory16(address);
+// Runs the instruction at pc: decode, execute, devices, then pc and the counters move on
+void executeInstruction(){
+	uint8_t* instruction = backingMemory(pc, true);
+	enum InstructionId id = decodeInstruction(instruction);
+	if (deferredCompare.bits){
+		settleFlagsBefore(id);
+	}
+	if (trace && !logging){ // Otherwise it goes to the log once the instruction ran
+		char text[64];
+		disassembleInstruction(pc, instruction, text);
+		printf("%04x - %s\n", pc, text);
+	}
 
-								struct RegRef16 Rd = getRegRef16(bL);
+	uint8_t a = instruction[0];
+	uint8_t aL = a & 0xF;
 
-								setFlagsMOV(value, 16);
-								*Rd.ptr = value;
+	uint8_t b = instruction[1];
+	uint8_t bH = (b >> 4) & 0xF;
+	uint8_t bL = b & 0xF;
 
-								printf("%04x - MOV.w @%x:16, %c%d\n", pc, address, Rd.loOrHiReg, Rd.idx); 
-								printRegistersState();
+	uint8_t c = instruction[2];
 
-							}break;
+	uint8_t d = instruction[3];
+	uint8_t dH = (d >> 4) & 0xF;
+	uint8_t dL = d & 0xF;
 
-							case 0x8:{ // MOV.B Rs, @aa:16 
-								uint32_t address = (cd & 0x0000FFFF) | 0x00FF0000; // Upper 16 bits assumed to be 1
+	uint8_t e = instruction[4];
+	uint8_t f = instruction[5];
 
-								struct RegRef16 Rs = getRegRef16(bL);
+	uint16_t cd = (c << 8) | d;
+	uint16_t ef = (e << 8) | f;
+	uint32_t cdef = cd << 16 | ef;
 
-								uint16_t value = *Rs.ptr;
-								setFlagsMOV(value, 16);
-								setMemory16(address, value);
+	int nextPc = pc + instructionTable[id].length; // Control flow instructions overwrite this
+	switch(id){
+		case OP_NOP:{
+		}break;
 
-								printf("%04x - MOV.w %c%d,@%x:16 \n", pc, Rs.loOrHiReg, Rs.idx, address); 
-								printMemory(address, 2);
-								printRegistersState();
+		// MOV.l to and from memory, these are all 01 00 prefixed so the registers live in d
+		case OP_MOV_L_IND_R:{ // MOV.l @ERs, ERd
+			struct RegRef32 Rs = getRegRef32(dH);
+			struct RegRef32 Rd = getRegRef32(dL);
 
-							}break;
-						}
-						pc+=2;
+			uint32_t value = getMemory32(*Rs.ptr);
 
-					}break;
-					case 0xC:{ // MOV.B @ERs+, Rd --- MOV.B Rs, @-ERd
-						char incOrDec = (bH & 0b1000) ? '-' : '+';
+			mov32(value);
+			*Rd.ptr = value;
+		}break;
+		case OP_MOV_L_R_IND:{ // MOV.l ERs, @ERd 
+			struct RegRef32 Rs = getRegRef32(dL);
+			struct RegRef32 Rd = getRegRef32(dH);
+			uint32_t value = *Rs.ptr;
+			mov32(value);
+			setMemory32(*Rd.ptr, value);
+		}break;
+		case OP_MOV_L_ABS16_R:{ // MOV.l @aa:16, ERd
+			uint32_t address = (int16_t)ef & ADDRESS_MASK; // Sign extended
+			uint32_t value = getMemory32(address);
 
-						if (incOrDec == '+'){
-							struct RegRef32 Rs = getRegRef32(bH);
-							struct RegRef8 Rd = getRegRef8(bL);
+			struct RegRef32 Rd = getRegRef32(dL);
 
-							uint8_t value = getMemory8(*Rs.ptr);
+			mov32(value);
+			*Rd.ptr = value;
+		}break;
+		case OP_MOV_L_R_ABS16:{ // MOV.l ERs, @aa:16 
+			uint32_t address = (int16_t)ef & ADDRESS_MASK; // Sign extended
 
-							*Rs.ptr += 1;
+			struct RegRef32 Rs = getRegRef32(dL);
 
-							setFlagsMOV(value, 8);
-							*Rd.ptr = value;
+			uint32_t value = *Rs.ptr;
+			mov32(value);
+			setMemory32(address, value);
+		}break;
+		case OP_MOV_L_ABS24_R:{ // MOV.l @aa:24, ERd
+			uint32_t address = readBigEndian32(instruction + 4) & ADDRESS_MASK;
+			*REG32(dL) = mov32(getMemory32(address));
+		}break;
+		case OP_MOV_L_R_ABS24:{ // MOV.l ERs, @aa:24
+			uint32_t address = readBigEndian32(instruction + 4) & ADDRESS_MASK;
+			setMemory32(address, mov32(*REG32(dL)));
+		}break;
+		case OP_MOV_L_DISP24_R:{ // MOV.l @(d:24, ERs), ERd
+			int32_t disp = (int32_t)(readBigEndian32(instruction + 6) << 8) >> 8;
+			*REG32(f & 0xF) = mov32(getMemory32(*REG32(dH) + disp));
+		}break;
+		case OP_MOV_L_R_DISP24:{ // MOV.l ERs, @(d:24, ERd)
+			int32_t disp = (int32_t)(readBigEndian32(instruction + 6) << 8) >> 8;
+			setMemory32(*REG32(dH) + disp, mov32(*REG32(f & 0xF)));
+		}break;
+		case OP_MOV_L_POSTINC_R:{ // MOV.l @ERs+, ERd
+			struct RegRef32 Rs = getRegRef32(dH);
+			struct RegRef32 Rd = getRegRef32(dL);
 
-							printf("%04x - MOV.b @ER%d+, R%d%c\n", pc, Rs.idx, Rd.idx, Rd.loOrHiReg); 
+			uint32_t value = getMemory32(*Rs.ptr);
 
-						} else{
-							struct RegRef32 Rd = getRegRef32(bH);
-							struct RegRef8 Rs = getRegRef8(bL);
+			*Rs.ptr += 4;
 
-							*Rd.ptr -= 1;
+			mov32(value);
+			*Rd.ptr = value;
+		}break;
+		case OP_MOV_L_R_PREDEC:{ // MOV.l ERs, @-ERd
+			struct RegRef32 Rs = getRegRef32(dL);
+			struct RegRef32 Rd = getRegRef32(dH);
 
+			*Rd.ptr -= 4;
 
-							uint8_t value = *Rs.ptr;
-							setMemory8(*Rs.ptr, value);
-							setFlagsMOV(value, 8);
+			uint32_t value = *Rs.ptr;
+			setMemory32(*Rd.ptr, value);
+			mov32(value);
+		}break;
+		case OP_MOV_L_DISP16_R:{ // MOV.l @(d:16, ERs), ERd
+			struct RegRef32 Rs = getRegRef32(dH);
+			struct RegRef32 Rd = getRegRef32(dL);
+			uint32_t signExtendedDisp = (int16_t)ef;
+
+			uint32_t value = getMemory32(*Rs.ptr + signExtendedDisp); 
+			*Rd.ptr = value;
+			mov32(value);
+		}break;
+		case OP_MOV_L_R_DISP16:{ // MOV.l ERs, @(d:16, ERd) 
+			struct RegRef32 Rs = getRegRef32(dL);
+			struct RegRef32 Rd = getRegRef32(dH);
+			uint32_t signExtendedDisp = (int16_t)ef;
+
+			uint32_t value = *Rs.ptr;
+			mov32(value);
+			setMemory32(*Rd.ptr + signExtendedDisp, value);
+		}break;
 
-							printf("%04x - MOV.b R%d%c, @-ER%d, \n", pc, Rs.idx, Rs.loOrHiReg, Rd.idx); 
-							printMemory(*Rd.ptr, 1);
+		// Register, immediate and shift / rotate forms of the ALU ops, see alu.c
+		ARITHMETIC_CASES(B, 8, bH, bL)
+		ARITHMETIC_CASES(W, 16, bH, bL)
+		ARITHMETIC_CASES(L, 32, bH, bL)
+		LOGIC_CASES(B, 8, bH, bL)
+		LOGIC_CASES(W, 16, bH, bL)
+		LOGIC_CASES(L, 32, dH, dL)
+		IMMEDIATE_CASES(B, 8, aL, b)
+		IMMEDIATE_CASES(W, 16, bL, cd)
+		IMMEDIATE_CASES(L, 32, bL, cdef)
+		UNARY_CASES(B, 8, bL)
+		UNARY_CASES(W, 16, bL)
+		UNARY_CASES(L, 32, bL)
+		MULDIV_CASES(B, 8, 16, bH, bL, dH, dL)
+		MULDIV_CASES(W, 16, 32, bH, bL, dH, dL)
+		case OP_SUB_W_IMM:{ *REG16(bL) = sub16(*REG16(bL), cd); }break; // No SUB.b #xx:8 on this CPU
+		case OP_SUB_L_IMM:{ *REG32(bL) = sub32(*REG32(bL), cdef); }break;
+		case OP_INC_B:{ *REG8(bL) = inc8(*REG8(bL), 1); }break;
+		case OP_INC_W_1:{ *REG16(bL) = inc16(*REG16(bL), 1); }break;
+		case OP_INC_W_2:{ *REG16(bL) = inc16(*REG16(bL), 2); }break;
+		case OP_INC_L_1:{ *REG32(bL) = inc32(*REG32(bL), 1); }break;
+		case OP_INC_L_2:{ *REG32(bL) = inc32(*REG32(bL), 2); }break;
+		case OP_DEC_B:{ *REG8(bL) = dec8(*REG8(bL), 1); }break;
+		case OP_DEC_W_1:{ *REG16(bL) = dec16(*REG16(bL), 1); }break;
+		case OP_DEC_W_2:{ *REG16(bL) = dec16(*REG16(bL), 2); }break;
+		case OP_DEC_L_1:{ *REG32(bL) = dec32(*REG32(bL), 1); }break;
+		case OP_DEC_L_2:{ *REG32(bL) = dec32(*REG32(bL), 2); }break;
+		case OP_EXTU_W:{ *REG16(bL) = mov16(*REG16(bL) & 0xFF); }break;
+		case OP_EXTU_L:{ *REG32(bL) = mov32(*REG32(bL) & 0xFFFF); }break;
+		case OP_EXTS_W:{ *REG16(bL) = mov16((int8_t)*REG16(bL)); }break;
+		case OP_EXTS_L:{ *REG32(bL) = mov32((int16_t)*REG32(bL)); }break;
+
+		case OP_ADDS_1:{ // ADDS.l #1, ERd
+			struct RegRef32 Rd = getRegRef32(bL);
+			*Rd.ptr += 1;
+		}break;
+		case OP_ADDS_2:{ // ADDS.l #2, ERd
+			struct RegRef32 Rd = getRegRef32(bL);
+			*Rd.ptr += 2;
+		}break;
+		case OP_ADDS_4:{ // ADDS.l #4, ERd
+			struct RegRef32 Rd = getRegRef32(bL);
+			*Rd.ptr += 4;
+		}break;
 
-						}
-						printRegistersState();
+		case OP_SUBS_1:{ // SUBS #1, ERd
+			struct RegRef32 Rd = getRegRef32(bL);
 
+			*Rd.ptr -= 1;
+		}break;
+		case OP_SUBS_2:{ // SUBS #2, ERd
+			struct RegRef32 Rd = getRegRef32(bL);
 
+			*Rd.ptr -= 2;
+		}break;
+		case OP_SUBS_4:{ // SUBS #4, ERd
+			struct RegRef32 Rd = getRegRef32(bL);
 
-					}break;
-					case 0xD:{ // MOV.w @ERs+, Rd --- MOV.w Rs, @-ERd
-						char incOrDec = (bH & 0b1000) ? '-' : '+';
+			*Rd.ptr -= 4;
+		}break;
 
-						if (incOrDec == '+'){
-							struct RegRef32 Rs = getRegRef32(bH);
-							struct RegRef16 Rd = getRegRef16(bL);
+		case OP_MOV_B_ABS8_R:{ // MOV.B @aa:8, Rd
+			uint32_t address = 0x00FFFF00 | b; // Upper 16 bits assumed to be 1
+			uint8_t value = getMemory8(address);
 
-							uint16_t value = getMemory16(*Rs.ptr);
+			struct RegRef8 Rd = getRegRef8(aL);
+			mov8(value);
+			*Rd.ptr = value;
+		}break;
+		case OP_MOV_B_R_ABS8:{ // MOV.B Rs, @aa:8 
+			uint32_t address = 0x00FFFF00 | b; // Upper 16 bits assumed to be 1
 
-							*Rs.ptr += 2;
+			struct RegRef8 Rs = getRegRef8(aL);
+			uint8_t value = *Rs.ptr;
+			mov8(value);
+			setMemory8(address, value);
+		}break;
 
-							setFlagsMOV(value, 16);
-							*Rd.ptr = value;
+		case OP_BRA_8:
+		case OP_BRN_8:
+		case OP_BHI_8:
+		case OP_BLS_8:
+		case OP_BCC_8:
+		case OP_BCS_8:
+		case OP_BNE_8:
+		case OP_BEQ_8:
+		case OP_BVC_8:
+		case OP_BVS_8:
+		case OP_BPL_8:
+		case OP_BMI_8:
+		case OP_BGE_8:
+		case OP_BLT_8:
+		case OP_BGT_8:
+		case OP_BLE_8:{ // Bcc d:8
+			if (testCondition(aL)){
+				nextPc += (int8_t)b;
+			}
+		}break;
+		case OP_BRA_16:
+		case OP_BRN_16:
+		case OP_BHI_16:
+		case OP_BLS_16:
+		case OP_BCC_16:
+		case OP_BCS_16:
+		case OP_BNE_16:
+		case OP_BEQ_16:
+		case OP_BVC_16:
+		case OP_BVS_16:
+		case OP_BPL_16:
+		case OP_BMI_16:
+		case OP_BGE_16:
+		case OP_BLT_16:
+		case OP_BGT_16:
+		case OP_BLE_16:{ // Bcc d:16
+			if (testCondition(bH)){
+				nextPc += (int16_t)cd;
+			}
+		}break;
 
-							printf("%04x - MOV.w @ER%d+, %c%d\n", pc, Rs.idx, Rd.loOrHiReg, Rd.idx); 
+		case OP_RTS:{ // RTS
+			nextPc = getMemory16(*SP);
+			*SP += 2;
+		}break;
+		case OP_BSR_8:{ // BSR d:8
+			*SP -= 2;
+			setMemory16(*SP, nextPc);
+			nextPc += (int8_t)b;
+		}break;
+		case OP_BSR_16:{ // BSR d:16
+			*SP -= 2;
+			setMemory16(*SP, nextPc);
+			nextPc += (int16_t)cd;
+		}break;
+		case OP_JMP_IND:{ // JMP @ERn
+			struct RegRef32 Er = getRegRef32(bH);
+			nextPc = *Er.ptr;
+		}break;
+		case OP_JMP_ABS24:{ // JMP @aa:24
+			nextPc = (b << 16) | cd;
+		}break;
+		case OP_JSR_IND:{ // JSR @ERn
+			struct RegRef32 Er = getRegRef32(bH);
+			*SP -= 2;
+			setMemory16(*SP, nextPc);
+			nextPc = *Er.ptr;
+		}break;
+		case OP_JSR_ABS24:{ // JSR @aa:24
+			*SP -= 2;
+			setMemory16(*SP, nextPc);
+			nextPc = (b << 16) | cd;
+		}break;
 
-						} else{
-							struct RegRef32 Rd = getRegRef32(bH);
-							struct RegRef16 Rs = getRegRef16(bL);
+		// Block transfer
+		case OP_EEPMOV_B: // EEPMOV.b
+		case OP_EEPMOV_W:{ // EEPMOV.w, copies R4L / R4 bytes from @ER5+ to @ER6+, 4 states a byte on top of the 8
+			uint32_t count = (id == OP_EEPMOV_B) ? *REG8(12) : *REG16(4);
+			moveMemory(*REG32(5), *REG32(6), count);
+			*REG32(5) += count;
+			*REG32(6) += count;
+			if (id == OP_EEPMOV_B){
+				*REG8(12) = 0;
+			} else{
+				*REG16(4) = 0;
+			}
+			cycles += 4 * count;
+		}break;
 
-							*Rd.ptr -= 2;
+		// Exceptions and sleep, see interrupts.c
+		case OP_RTE:{ // RTE
+			setCCR(getMemory16(*SP) >> 8);
+			nextPc = getMemory16(*SP + 2);
+			*SP += 4;
+			checkInterrupts();
+		}break;
+		case OP_TRAPA:{ // TRAPA #x:2
+			nextPc = takeException(VECTOR_TRAPA + (bH & 0x3), nextPc);
+		}break;
+		case OP_SLEEP:{ // SLEEP
+			sleeping = true;
+			nextPc = pc; // Stays here until an interrupt request wakes us up
+			checkInterrupts();
+		}break;
 
-							uint16_t value = *Rs.ptr;
-							setMemory16(*Rd.ptr, value);
-							setFlagsMOV(value, 16);
+		// CCR transfers and logic, anything that can clear I gets pending interrupts looked at
+		case OP_STC_B:{ // STC.b CCR, Rd
+			struct RegRef8 Rd = getRegRef8(bL);
+			*Rd.ptr = getCCR();
+		}break;
+		case OP_LDC_B_R:{ // LDC.b Rs, CCR
+			struct RegRef8 Rs = getRegRef8(bL);
+			setCCR(*Rs.ptr);
+			checkInterrupts();
+		}break;
+		case OP_LDC_B_IMM:{ // LDC.b #xx:8, CCR
+			setCCR(b);
+			checkInterrupts();
+		}break;
+		case OP_ORC:{ // ORC #xx:8, CCR
+			setCCR(getCCR() | b);
+		}break;
+		case OP_XORC:{ // XORC #xx:8, CCR
+			setCCR(getCCR() ^ b);
+			checkInterrupts();
+		}break;
+		case OP_ANDC:{ // ANDC #xx:8, CCR
+			setCCR(getCCR() & b);
+			checkInterrupts();
+		}break;
+		case OP_LDC_W_IND:{ // LDC.w @ERs, CCR
+			struct RegRef32 Rs = getRegRef32(dH);
+			setCCR(getMemory16(*Rs.ptr) >> 8);
+			checkInterrupts();
+		}break;
+		case OP_STC_W_IND:{ // STC.w CCR, @ERd
+			struct RegRef32 Rd = getRegRef32(dH);
+			setMemory16(*Rd.ptr, getCCR() << 8);
+		}break;
+		case OP_LDC_W_POSTINC:{ // LDC.w @ERs+, CCR
+			struct RegRef32 Rs = getRegRef32(dH);
+			setCCR(getMemory16(*Rs.ptr) >> 8);
+			*Rs.ptr += 2;
+			checkInterrupts();
+		}break;
+		case OP_STC_W_PREDEC:{ // STC.w CCR, @-ERd
+			struct RegRef32 Rd = getRegRef32(dH);
+			*Rd.ptr -= 2;
+			setMemory16(*Rd.ptr, getCCR() << 8);
+		}break;
 
-							printf("%04x - MOV.w %c%d, @-ER%d, \n", pc, Rs.loOrHiReg, Rs.idx, Rd.idx); 
-							printMemory(*Rd.ptr, 2);
+		case OP_MOV_B_IND_R:{ // MOV.B @ERs, Rd
+			struct RegRef32 Rs = getRegRef32(bH);
+			struct RegRef8 Rd = getRegRef8(bL);
 
-						}
-						printRegistersState();
+			uint8_t value = getMemory8(*Rs.ptr);
 
+			mov8(value);
+			*Rd.ptr = value;
+		}break;
+		case OP_MOV_B_R_IND:{ // MOV.B Rs, @ERd 
+			struct RegRef8 Rs = getRegRef8(bL);
+			struct RegRef32 Rd = getRegRef32(bH);
 
+			uint8_t value = *Rs.ptr;
 
-					} break;
-					case 0xE:{ 
-						struct RegRef8 Rd = getRegRef8(bL);
-						struct RegRef32 Rs = getRegRef32(bH);
+			mov8(value);
+			setMemory8(*Rd.ptr, value);
+		}break;
+		case OP_MOV_W_IND_R:{ // MOV.w @ERs, Rd
+			struct RegRef32 Rs = getRegRef32(bH);
+			struct RegRef16 Rd = getRegRef16(bL);
+			uint16_t value = getMemory16(*Rs.ptr);
+			mov16(value);
+			*Rd.ptr = value;
+		}break;
+		case OP_MOV_W_R_IND:{ // MOV.w Rs, @ERd 
+			struct RegRef16 Rs = getRegRef16(bL);
+			struct RegRef32 Rd = getRegRef32(bH);
+			uint16_t value = *Rs.ptr;
+			mov16(value);
+			setMemory16(*Rd.ptr, value);
+		}break;
+		case OP_MOV_B_ABS16_R:{ // MOV.B @aa:16, Rd
+			uint32_t address = (int16_t)cd & ADDRESS_MASK; // Sign extended
+			uint8_t value = getMemory8(address);
 
-						uint16_t disp = cd;
-						bool msbDisp = disp & 0x8000;
-						uint32_t signExtendedDisp = msbDisp ? (0xFFFF0000 & disp) : disp;
+			struct RegRef8 Rd = getRegRef8(bL);
 
-						if (!(bH & 0b1000)){ // From memory MOV.B @(d:16, ERs), Rd
-							uint8_t value = getMemory8(*Rs.ptr + signExtendedDisp);
-							*Rd.ptr = value;
-							setFlagsMOV(value, 8);
+			mov8(value);
+			*Rd.ptr = value;
+		}break;
+		case OP_MOV_B_R_ABS16:{ // MOV.B Rs, @aa:16 
+			uint32_t address = (int16_t)cd & ADDRESS_MASK; // Sign extended
 
-							printf("%04x - MOV.b @(%d:16, ER%d), R%d%c\n", pc, disp, Rs.idx, Rd.idx, Rd.loOrHiReg); 
+			struct RegRef8 Rs = getRegRef8(bL);
 
-						} else{ // To memory MOV.B Rs, @(d:16, ERd)
-							uint8_t value = *Rd.ptr;
-							setFlagsMOV(value, 8);
-							setMemory8(*Rs.ptr + signExtendedDisp, value);
-							printf("%04x - MOV.b R%d%c, @(%d:16, ER%d), \n", pc, Rd.idx, Rd.loOrHiReg, disp, Rs.idx); 
-							printMemory(*Rs.ptr + signExtendedDisp, 1);
-						}
-						printRegistersState();
-						pc+=2;
+			uint8_t value = *Rs.ptr;
+			mov8(value);
+			setMemory8(address, value);
+		}break;
+		case OP_MOV_W_ABS16_R:{ // MOV.w @aa:16, Rd
+			uint32_t address = (int16_t)cd & ADDRESS_MASK; // Sign extended
+			uint16_t value = getMemory16(address);
 
+			struct RegRef16 Rd = getRegRef16(bL);
 
-					}break;
-					case 0xF:{ 
-					struct RegRef16 Rd = getRegRef16(bL);
-						struct RegRef32 Rs = getRegRef32(bH);
-						uint16_t disp = cd;
-						bool msbDisp = disp & 0x8000;
-						uint32_t signExtendedDisp = msbDisp ? (0xFFFF0000 & disp) : disp;
+			mov16(value);
+			*Rd.ptr = value;
+		}break;
+		case OP_MOV_W_R_ABS16:{ // MOV.w Rs, @aa:16 
+			uint32_t address = (int16_t)cd & ADDRESS_MASK; // Sign extended
 
-						if (!(bH & 0b1000)){ // From memory MOV.W @(d:16, ERs), Rd
-							uint16_t value = getMemory16(*Rs.ptr + signExtendedDisp);
-							*Rd.ptr = value;
-							setFlagsMOV(value, 16);
+			struct RegRef16 Rs = getRegRef16(bL);
 
-							printf("%04x - MOV.w @(%d:16, ER%d), %c%d\n", pc, disp, Rs.idx, Rd.loOrHiReg, Rd.idx); 
+			uint16_t value = *Rs.ptr;
+			mov16(value);
+			setMemory16(address, value);
+		}break;
+		case OP_MOV_B_ABS24_R:{ // MOV.B @aa:24, Rd
+			uint32_t address = readBigEndian32(instruction + 2) & ADDRESS_MASK;
+			*REG8(bL) = mov8(getMemory8(address));
+		}break;
+		case OP_MOV_B_R_ABS24:{ // MOV.B Rs, @aa:24
+			uint32_t address = readBigEndian32(instruction + 2) & ADDRESS_MASK;
+			setMemory8(address, mov8(*REG8(bL)));
+		}break;
+		case OP_MOV_W_ABS24_R:{ // MOV.w @aa:24, Rd
+			uint32_t address = readBigEndian32(instruction + 2) & ADDRESS_MASK;
+			*REG16(bL) = mov16(getMemory16(address));
+		}break;
+		case OP_MOV_W_R_ABS24:{ // MOV.w Rs, @aa:24
+			uint32_t address = readBigEndian32(instruction + 2) & ADDRESS_MASK;
+			setMemory16(address, mov16(*REG16(bL)));
+		}break;
+		case OP_MOV_B_DISP24_R:{ // MOV.B @(d:24, ERs), Rd
+			int32_t disp = (int32_t)(readBigEndian32(instruction + 4) << 8) >> 8;
+			*REG8(dL) = mov8(getMemory8(*REG32(bH) + disp));
+		}break;
+		case OP_MOV_B_R_DISP24:{ // MOV.B Rs, @(d:24, ERd)
+			int32_t disp = (int32_t)(readBigEndian32(instruction + 4) << 8) >> 8;
+			setMemory8(*REG32(bH) + disp, mov8(*REG8(dL)));
+		}break;
+		case OP_MOV_W_DISP24_R:{ // MOV.w @(d:24, ERs), Rd
+			int32_t disp = (int32_t)(readBigEndian32(instruction + 4) << 8) >> 8;
+			*REG16(dL) = mov16(getMemory16(*REG32(bH) + disp));
+		}break;
+		case OP_MOV_W_R_DISP24:{ // MOV.w Rs, @(d:24, ERd)
+			int32_t disp = (int32_t)(readBigEndian32(instruction + 4) << 8) >> 8;
+			setMemory16(*REG32(bH) + disp, mov16(*REG16(dL)));
+		}break;
+		case OP_MOV_B_POSTINC_R:{ // MOV.B @ERs+, Rd
+			struct RegRef32 Rs = getRegRef32(bH);
+			struct RegRef8 Rd = getRegRef8(bL);
 
-						} else{ // To memory MOV.W Rs, @(d:16, ERd)
-							uint16_t value = *Rd.ptr;
-							setFlagsMOV(value, 16);
-							setMemory16(*Rs.ptr + signExtendedDisp, value);
-							printf("%04x - MOV.w %c%d, @(%d:16, ER%d), \n", pc, Rd.loOrHiReg, Rd.idx, disp, Rs.idx); 
-							printMemory(*Rs.ptr + signExtendedDisp, 2);
-						}
-						printRegistersState();
-						pc+=2;
+			uint8_t value = getMemory8(*Rs.ptr);
 
+			*Rs.ptr += 1;
 
-					}break;
-				}
-			}break;
-			case 0x7:{
-				uint8_t mostSignificantBit = bH >> 7;
-				switch(aL){
-					case 0x0:{ // BSET #xx:3, Rd
-
-						struct RegRef8 Rd = getRegRef8(bL);		
-
-						int bitToSet = bH;
-
-						*Rd.ptr = *Rd.ptr | (1 << bitToSet);
-
-						printf("%04x - BSET #%d, r%d%c\n", pc, bitToSet, Rd.idx, Rd.loOrHiReg);
-						printRegistersState();
-					}break;
-					case 0x1:{
-						printf("%04x - BNOT\n", pc);
-					}break;
-					case 0x2:{ // BCLR #xx:3, Rd
-
-						struct RegRef8 Rd = getRegRef8(bL);		
-
-						int bitToClear = bH;
-
-						*Rd.ptr = *Rd.ptr & ~(1 << bitToClear);
-
-						printf("%04x - BCLR #%d, r%d%c\n", pc, bitToClear, Rd.idx, Rd.loOrHiReg);
-						printRegistersState();
-					}break;
-					case 0x3:{
-						printf("%04x - BTST\n", pc);
-					}break;
-					case 0x4:{
-						if (mostSignificantBit == 0x1){
-							printf("%04x - BIOR\n", pc);
-						}else{
-							printf("%04x - BOR\n", pc);
-						}
-					}break;
-					case 0x5:{
-						if (mostSignificantBit == 0x1){
-							printf("%04x - BIXOR\n", pc);
-						}else{
-							printf("%04x - BXOR\n", pc);
-						}
-					}break;
-					case 0x6:{
-						if (mostSignificantBit == 0x1){
-							printf("%04x - BIAND\n", pc);
-						}else{
-							printf("%04x - BAND\n", pc);
-						}
-					}break;
-					case 0x7:{
-						if (mostSignificantBit == 0x1){
-							printf("%04x - BILD\n", pc);
-						}else{ // BLD #xx:3, Rd
-							struct RegRef8 Rd = getRegRef8(bL);		
-
-							int bitToLoad = bH;
-
-							flags.C = *Rd.ptr & (1 << bitToLoad);
-
-							printf("%04x - BLD #%d, r%d%c\n", pc, bitToLoad, Rd.idx, Rd.loOrHiReg);
-							printRegistersState();
-						}					
-					}break;
-					case 0x8:{
-						printf("%04x - MOV\n", pc);
-					}break;
-					case 0x9:{ // XXX.w #xx:16, Rd
-						struct RegRef16 Rd = getRegRef16(bL);
-						switch(bH){ 
-							case 0x0:{ // MOV.w #xx:16, Rd
-								setFlagsMOV(cd, 16);
-								*Rd.ptr = cd;
-								printf("%04x - MOV.w 0x%x,%c%d\n", pc, cd, Rd.loOrHiReg,  Rd.idx); 
-							}break;
-							case 0x1:{ // ADD.w #xx:16, Rd
-								setFlagsADD(*Rd.ptr, cd, 16);
-								*Rd.ptr += cd;
-								printf("%04x - ADD.w 0x%x,%c%d\n", pc, cd, Rd.loOrHiReg,  Rd.idx); 
-							}break;
-							case 0x2:{ // CMP.w #xx:16, Rd
-								setFlagsSUB(*Rd.ptr, cd, 16);
-								printf("%04x - CMP.w 0x%x,%c%d\n", pc, cd, Rd.loOrHiReg,  Rd.idx); 
-							}break;
-							case 0x3:{ // SUB.w #xx:16, Rd
-								setFlagsSUB(*Rd.ptr, cd, 16);
-								*Rd.ptr -= cd;
-								printf("%04x - SUB.w 0x%x,%c%d\n", pc, cd, Rd.loOrHiReg,  Rd.idx); 
-							}break;
-							case 0x4:{ // OR.w #xx:16, Rd
-								uint16_t value = cd;
-								uint16_t newValue = cd | *Rd.ptr;
-								setFlagsMOV(newValue, 16);
-								*Rd.ptr = newValue;
-								printf("%04x - OR.w 0x%x,%c%d\n", pc, cd, Rd.loOrHiReg,  Rd.idx); 
-							}break;
-							case 0x5:{ // XOR.w #xx:16, Rd
-								uint16_t value = cd;
-								uint16_t newValue = cd ^ *Rd.ptr;
-								setFlagsMOV(newValue, 16);
-								*Rd.ptr = newValue;
-								printf("%04x - XOR.w 0x%x,%c%d\n", pc, cd, Rd.loOrHiReg,  Rd.idx); 
-							}break;
-							case 0x6:{ // AND.w #xx:16, Rd
-								uint16_t value = cd;
-								uint16_t newValue = cd & *Rd.ptr;
-								setFlagsMOV(newValue, 16);
-								*Rd.ptr = newValue;
-								printf("%04x - AND.w 0x%x,%c%d\n", pc, cd, Rd.loOrHiReg,  Rd.idx); 
-							}break;
-						}
-						printRegistersState();
-						pc+=2;
-					}break;
-					case 0xA:{ // XXX.l #xx:32, ERd
-						struct RegRef32 Rd = getRegRef32(bL);
-						switch(bH){ 
-							case 0x0:{ // MOV.l #xx:32, ERd
-								setFlagsMOV(cdef, 32);
-								*Rd.ptr = cdef;
-								printf("%04x - MOV.l 0x%04x, ER%d\n", pc, cdef,  Rd.idx); 
-							}break;
-							case 0x1:{ // ADD.l #xx:32, ERd
-								setFlagsADD(*Rd.ptr, cdef, 32);
-								*Rd.ptr += cdef;
-								printf("%04x - ADD.l 0x%04x, ER%d\n", pc, cdef,  Rd.idx); 
-							}break;
-							case 0x2:{
-								// CMP.l #xx:32, ERd
-								setFlagsSUB(*Rd.ptr, cdef, 32);
-								printf("%04x - CMP.l 0x%04x, ER%d\n", pc, cdef,  Rd.idx); 
-							}break;
-							case 0x3:{ // SUB.l #xx:32, ERd
-								setFlagsSUB(*Rd.ptr, cdef, 32);
-								*Rd.ptr -= cdef;
-								printf("%04x - SUB.l 0x%04x, ER%d\n", pc, cdef,  Rd.idx); 
-							}break;
-							case 0x4:{ // OR.l #xx:32, ERd
-								uint32_t newValue = cdef | *Rd.ptr;
-								setFlagsMOV(newValue, 32);
-								*Rd.ptr = newValue;
-								printf("%04x - OR.l 0x%04x, ER%d\n", pc, cdef,  Rd.idx); 
-							}break;
-							case 0x5:{ // XOR.l #xx:32, ERd
-								uint32_t newValue = cdef ^ *Rd.ptr;
-								setFlagsMOV(newValue, 32);
-								*Rd.ptr = newValue;
-								printf("%04x - XOR.l 0x%04x, ER%d\n", pc, cdef,  Rd.idx); 
-							}break;
-							case 0x6:{ // AND.l #xx:32, ERd
-								uint32_t newValue = cdef & *Rd.ptr;
-								setFlagsMOV(newValue, 32);
-								*Rd.ptr = newValue;
-								printf("%04x - AND.l 0x%04x, ER%d\n", pc, cdef,  Rd.idx); 
-							}break;
-						}
-						printRegistersState();
-						pc+=4;
-					}break;
-					case 0xB:{
-						printf("%04x - EEPMOV\n", pc);
-					}break;
-					case 0xC:{
-						uint8_t mostSignificantBit = dH >> 7;
-						switch(c){
-							case 0x77:{
-								// BLD #xx:3, @ERd
-								struct RegRef32 Rd = getRegRef32(bH);		
-								int bitToLoad = dH;
-								printf("%04x - BLD #%d, @ER%d\n", pc, bitToLoad, Rd.idx);
-								flags.C = getMemory8(*Rd.ptr) & (1 << bitToLoad);
-								printRegistersState();
-								pc+=2;
-
-							}break;
-
-						}
-
-
-
-					} break;
-					case 0xE:{
-						// Here bH is the "register designation field" dont know what that is, so ignorign it for now
-						// togetherwith bL it can also be "aa" which is the "absolute address field"
-						if (cH == 0x6){
-							switch(cL){
-								case 0x3:{
-									printf("%04x - BTST\n", pc);
-								}break;
-							}
-						}else if (cH == 0x7){
-							uint8_t mostSignificantBit = dH >> 7;
-							switch(cL){
-								case 0x3:{
-									printf("%04x - BTST\n", pc);
-								}break;
-								case 0x4:{
-									if (mostSignificantBit == 0x1){
-										printf("%04x - BIOR\n", pc);
-									}else{
-										printf("%04x - BOR\n", pc);
-									}
-								}break;
-								case 0x5:{
-									if (mostSignificantBit == 0x1){
-										printf("%04x - BXOR\n", pc);
-									}else{
-										printf("%04x - BIXOR\n", pc);
-									}
-								}break;
-								case 0x6:{
-									if (mostSignificantBit == 0x1){
-										printf("%04x - BIAND\n", pc);
-									}else{
-										printf("%04x - BAND\n", pc);
-									}
-								}break;
-								case 0x7:{
-									if (mostSignificantBit == 0x1){
-										printf("%04x - BILD\n", pc);
-									}else{ // BLD #xx:3, @ERd
-										int bitToLoad = dH;
-										uint32_t address = (0x00FFFF00) | b;
-										printf("%04x - BLD #%d, @0x%x:8\n", pc, bitToLoad, address);
-										flags.C =  getMemory8(address) & (1 << bitToLoad);
-									}
-								}break;
-							}
-
-
-						}
-						pc+=2; 
-					}break;
-					case 0xD:{
-						struct RegRef32 Rd = getRegRef32(bH);		
-						switch(c){
-							case 0x70:{ // BSET #xx:3, @ERd
-								int bitToSet = dH;
-								printf("%04x - BSET #%d, @ER%d\n", pc, bitToSet, Rd.idx);
-								setMemory8(*Rd.ptr, getMemory8(*Rd.ptr) | (1 << bitToSet));
-							}break;
-							case 0x60:{ // BSET Rn, @ERd
-								struct RegRef8 Rn = getRegRef8(dH);		
-								int bitToSet = *Rn.ptr;
-								printf("%04x - BSET r%d%c, @ER%d\n", pc, Rn.idx, Rn.loOrHiReg, Rd.idx);
-								setMemory8(*Rd.ptr, getMemory8(*Rd.ptr) | (1 << bitToSet));
-							}break;
-							case 0x72:{ // BCLR #xx:3, @ERd
-								int bitToClear = dH;
-								printf("%04x - BCLR #%d, @ER%d\n", pc, bitToClear, Rd.idx);
-								setMemory8(*Rd.ptr, getMemory8(*Rd.ptr) & ~(1 << bitToClear));
-							}break;
-							case 0x62:{ // BCLR Rn, @ERd
-								struct RegRef8 Rn = getRegRef8(dH);		
-								int bitToClear = *Rn.ptr;
-								printf("%04x - BCLR r%d%c, @ER%d\n", pc, Rn.idx, Rn.loOrHiReg, Rd.idx);
-								setMemory8(*Rd.ptr, getMemory8(*Rd.ptr) & ~(1 << bitToClear));
-							}break;
-						}
-						printMemory(*Rd.ptr, 1);
-						printRegistersState();
-						pc+=2;
-					}break;
-					case 0xF:{
-						uint32_t address = (0x00FFFF00) | b;
-						switch(c){
-							case 0x70:{ // BSET #xx:3, @aa:8
-								int bitToSet = dH;
-								printf("%04x - BSET #%d, @0x%x:8\n", pc, bitToSet, address);
-								setMemory8(address, getMemory8(address) | (1 << bitToSet));
-							}break;
-							case 0x60:{ // BSET Rn, @aa:8
-								struct RegRef8 Rn = getRegRef8(dH);		
-								int bitToSet = *Rn.ptr;
-								printf("%04x - BSET r%d%c, @0x%x:8\n", pc, Rn.idx, Rn.loOrHiReg, address);
-								setMemory8(address, getMemory8(address) | (1 << bitToSet));
-							}break;
-							case 0x72:{ // BCLR #xx:3, @aa:8
-								int bitToClear = dH;
-								printf("%04x - BCLR #%d, @0x%x:8\n", pc, bitToClear, address);
-								setMemory8(address, getMemory8(address) & ~(1 << bitToClear));
-							}break;
-							case 0x62:{ // BCLR Rn, @aa:8
-								struct RegRef8 Rn = getRegRef8(dH);		
-								int bitToClear = *Rn.ptr;
-								printf("%04x - BCLR r%d%c, @0x%x:8\n", pc, Rn.idx, Rn.loOrHiReg, address);
-								setMemory8(address, getMemory8(address) & ~(1 << bitToClear));
-							}break;
-						}
-						printMemory(address, 1);
-						pc+=2;
-					} break;
-						/*
-						// Here bH is the "register designation field" dont know what that is, so ignorign it for now
-						// togetherwith bL it can also be "aa" which is the "absolute address field"
-						if (cH == 0x6){
-							uint8_t mostSignificantBit = dH >> 7;
-
-							if (cL == 0x7){
-								if (mostSignificantBit == 0x1){
-									printf("%04x - BIST\n", pc);
-								}else{
-									printf("%04x - BST\n", pc);
-							}						}
-						}
-						if (cH == 0x6 || cH == 0x7){
-							switch(cL){
-								case 0:{
-									printf("%04x - BSET\n", pc);
-								}break;
-								case 1:{
-									printf("%04x - BNOT\n", pc);
-								}break;
-								case 2:{
-									printf("%04x - BCLR\n", pc);
-								}break;
-
-							}
-						}
-						pc+=2;
-					*/
-				}
-			}break;
-			case 0x8:{ // ADD.B #xx:8, Rd
-				struct RegRef8 Rd = getRegRef8(aL);
+			mov8(value);
+			*Rd.ptr = value;
+		}break;
+		case OP_MOV_B_R_PREDEC:{ // MOV.B Rs, @-ERd
+			struct RegRef32 Rd = getRegRef32(bH);
+			struct RegRef8 Rs = getRegRef8(bL);
 
-				uint8_t value = (bH << 4) | bL;
+			*Rd.ptr -= 1;
 
-				setFlagsADD(*Rd.ptr, value, 8);
-				*Rd.ptr += value;
+			uint8_t value = *Rs.ptr;
+			setMemory8(*Rd.ptr, value);
+			mov8(value);
+		}break;
+		case OP_MOV_W_POSTINC_R:{ // MOV.w @ERs+, Rd
+			struct RegRef32 Rs = getRegRef32(bH);
+			struct RegRef16 Rd = getRegRef16(bL);
 
-				printf("%04x - ADD.b 0x%x,R%d%c\n", pc, value, Rd.idx, Rd.loOrHiReg); //Note: Dmitry's dissasembler sometimes outputs address in decimal (0xdd) not sure why
-				printRegistersState();
-			}break;
-			case 0x9:{
-				printf("%04x - ADDX\n", pc);
-			}break;
+			uint16_t value = getMemory16(*Rs.ptr);
 
-			case 0xA:{ // CMP.B #xx:8, Rd
-				struct RegRef8 Rd = getRegRef8(aL);
+			*Rs.ptr += 2;
 
-				uint8_t value = (bH << 4) | bL;
+			mov16(value);
+			*Rd.ptr = value;
+		}break;
+		case OP_MOV_W_R_PREDEC:{ // MOV.w Rs, @-ERd
+			struct RegRef32 Rd = getRegRef32(bH);
+			struct RegRef16 Rs = getRegRef16(bL);
 
-				setFlagsSUB(*Rd.ptr, value, 8);
+			*Rd.ptr -= 2;
 
-				printf("%04x - CMP.b 0x%x,R%d%c\n", pc, value, Rd.idx, Rd.loOrHiReg); 
-				printRegistersState();
+			uint16_t value = *Rs.ptr;
+			setMemory16(*Rd.ptr, value);
+			mov16(value);
+		}break;
+		case OP_MOV_B_DISP16_R:{ // MOV.B @(d:16, ERs), Rd
+			struct RegRef32 Rs = getRegRef32(bH);
+			struct RegRef8 Rd = getRegRef8(bL);
+			uint32_t signExtendedDisp = (int16_t)cd;
+
+			uint8_t value = getMemory8(*Rs.ptr + signExtendedDisp);
+			*Rd.ptr = value;
+			mov8(value);
+		}break;
+		case OP_MOV_B_R_DISP16:{ // MOV.B Rs, @(d:16, ERd)
+			struct RegRef32 Rd = getRegRef32(bH);
+			struct RegRef8 Rs = getRegRef8(bL);
+			uint32_t signExtendedDisp = (int16_t)cd;
+
+			uint8_t value = *Rs.ptr;
+			mov8(value);
+			setMemory8(*Rd.ptr + signExtendedDisp, value);
+		}break;
+		case OP_MOV_W_DISP16_R:{ // MOV.W @(d:16, ERs), Rd
+			struct RegRef32 Rs = getRegRef32(bH);
+			struct RegRef16 Rd = getRegRef16(bL);
+			uint32_t signExtendedDisp = (int16_t)cd;
+
+			uint16_t value = getMemory16(*Rs.ptr + signExtendedDisp);
+			*Rd.ptr = value;
+			mov16(value);
+		}break;
+		case OP_MOV_W_R_DISP16:{ // MOV.W Rs, @(d:16, ERd)
+			struct RegRef32 Rd = getRegRef32(bH);
+			struct RegRef16 Rs = getRegRef16(bL);
+			uint32_t signExtendedDisp = (int16_t)cd;
+
+			uint16_t value = *Rs.ptr;
+			mov16(value);
+			setMemory16(*Rd.ptr + signExtendedDisp, value);
+		}break;
 
-			}break;
+		// Bit instructions, see bitOp in alu.c
+		BIT_REGISTER_CASES(BSET, BIT_SET)
+		BIT_REGISTER_CASES(BNOT, BIT_NOT)
+		BIT_REGISTER_CASES(BCLR, BIT_CLR)
+		BIT_REGISTER_CASES(BTST, BIT_TST)
+		BIT_CASES(BST, BIT_ST)
+		BIT_CASES(BIST, BIT_IST)
+		BIT_CASES(BLD, BIT_LD)
+		BIT_CASES(BILD, BIT_ILD)
+		BIT_CASES(BAND, BIT_AND)
+		BIT_CASES(BIAND, BIT_IAND)
+		BIT_CASES(BOR, BIT_OR)
+		BIT_CASES(BIOR, BIT_IOR)
+		BIT_CASES(BXOR, BIT_XOR)
+		BIT_CASES(BIXOR, BIT_IXOR)
+
+		default:{ // Not implemented yet, these only show up in the trace and the coverage report
+			if (coveredPcs){
+				unimplementedHits[id]++;
+			}
+			if (logWanted(LOG_CPU, LOG_INFO)){
+				logInstruction(LOG_UNIMPLEMENTED, pc, instruction);
+			}
+			if (stopOnUnimplemented){ // It didn't run, pc and the counts stay where they are
+				stopReason = "unimplemented instruction";
+				return;
+			}
+		} break;
+	}
+	if (fusionTable[id] & FUSE_WITH_BRANCH){
+		nextPc = fuseBranch(id, nextPc);
+	}
+	if (trace){
+		if (logging){
+			logInstruction(LOG_INSTRUCTION, pc, instruction);
+		} else{
+			printRegistersState();
+		}
+	}
+	if (historyRing){
+		recordHistory(id, pc, nextPc & ADDRESS_MASK);
+	}
+	if (coveredPcs){
+		recordCoverage(id, pc, nextPc & ADDRESS_MASK);
+	}
 
-			case 0xB:{
-				printf("%04x - SUBX\n", pc);
-			}break;
+	serviceSSU();
 
-			case 0xC:{ // OR.b #xx:8, Rd
-				struct RegRef8 Rd = getRegRef8(aL);
+	pc = nextPc & ADDRESS_MASK;
+	cycles += instructionTable[id].states;
+	instructions++;
+}
 
-				uint8_t value = b;
-				uint8_t newValue = value | *Rd.ptr;
-				setFlagsMOV(newValue, 8);
-				*Rd.ptr = newValue;
+#include "lanes.c"
+#include "aot.c"
 
-				printf("%04x - OR.b 0x%x,R%d%c\n", pc, value, Rd.idx, Rd.loOrHiReg); 
-				printRegistersState();
-			}break;
-	
-			case 0xD:{ // XOR.b #xx:8, Rd
-				struct RegRef8 Rd = getRegRef8(aL);
+void allocateRegisters(){
+	for(int i=0; i < 8;i++){
+		ER[i] = malloc(4);
+		R[i] = (uint16_t*) ER[i];
+		E[i] = (uint16_t*) ER[i] + 1;
+		RL[i] = (uint8_t*) R[i];
+		RH[i] = (uint8_t*) R[i] + 1;
+	}
+	SP = ER[7];
+}
 
-				uint8_t value = b;
-				uint8_t newValue = value ^ *Rd.ptr;
-				setFlagsMOV(newValue, 8);
-				*Rd.ptr = newValue;
+// Puts the CPU, the serial unit and the devices that keep their state in memory back to how they come out of reset.
+// Memory, the device models' own state and the counters are up to the caller (libpoke.c resets those too).
+void resetMachine(uint32_t entry){
+	memset(accel_memory, 0, 29);
+	accel_memory[0] = 0x2; // Chip id
 
-				printf("%04x - XOR.b 0x%x,R%d%c\n", pc, value, Rd.idx, Rd.loOrHiReg); 
-				printRegistersState();
-			}break;
+	// Init SSU registers
+	mapSSURegisters();
+	SSU.SSTRSR = 0x0; 
 
-			case 0xE:{ // AND #xx:8, Rd
-				struct RegRef8 Rd = getRegRef8(aL);
+	*SSU.SSRDR = 0x0; 
+	*SSU.SSTDR = 0x0;
+	*SSU.SSER = 0x0; 
+	*SSU.SSSR = 0x4; // TDRE = 1 (Transmit data empty) 
+	
+	memset(ssuBuffer, 0xFF, 2);
+	initPorts();
+	initRtc();
+	initWatchdog();
+	// Init general purpose registers
+	for(int i=0; i < 8;i++){
+		*ER[i] = 0;
+	}
+	flags = (struct Flags){0};
+	deferredCompare.bits = 0;
+	pc = entry;
+}
 
-				uint8_t value = b;
-				uint8_t newValue = value & *Rd.ptr;
-				setFlagsMOV(newValue, 8);
-				*Rd.ptr = newValue;
+#ifndef POKE_LIBRARY // libpoke.c brings its own entry points
+int main(int argc, char** argv){
+	//int entry = 0x02C4;
+	int entry = 0x0;
+	const char* romPath = "roms/shar.bin";
+	mode = RUN;
 
-				printf("%04x - AND.b 0x%x,R%d%c\n", pc, value, Rd.idx, Rd.loOrHiReg); 
-				printRegistersState();
-			}break;
+	// 0x0000 - 0xBFFF - ROM 
+	// 0xF020 - 0xF0FF - MMIO
+	// 0xF780 - 0xFF7F - RAM 
+	// 0xFF80 - 0xFFFF - MMIO
+	memory = calloc(BLOCK_SIZE + BLOCK_PADDING, 1);
+	mapMemory();
+	initDecoder();
+	initFusion();
+
+	// poke [options] [rom]
+	// -b addr: breakpoint, -r addr / -w addr: read / write watchpoint, -g port: wait for gdb on that port
+	// -e addr: entry point, -s addr: stop when reaching addr, -n count / -c count: stop after that many instructions / states
+	// -d: print a listing of the ROM and exit, -u: stop on unimplemented instructions, -q: no trace, -p: start in step mode
+	// -R file: record external inputs to file, -P file: replay them from file, -H count: rewind buffer, checkpoint every count instructions
+	// -L file: sweep, run once per input journal listed in file, side by side, -A file: render the buzzer to a WAV file
+	// -W seconds: move the real time clock forward that far before starting (0 for the next midnight)
+	// -T count: when the watchdog expires, stop and report the last count instructions and the call stack
+	// -l file / -B file: send the trace and the device logs to file, as text / binary records, through a writer thread
+	// -D file: print a binary log as text and exit (see log.c)
+	// -F filter: log levels per subsystem for -l, like cpu:info,ssu:debug,memory:off
+	// -M: count the accesses to each I/O register and print them when the run stops
+	// -C file: write which code ran, which ways the branches went and which handlers ran (unimplemented ones too) to file
+	// -X file.c: translate the ROM to C and exit, build with -DAOT_SOURCE=\"file.c\" to run it (see aot.c)
+	int gdbPort = 0;
+	const char* lanesPath = NULL;
+	const char* translatePath = NULL;
+	bool listRom = false;
+	bool warp = false;
+	uint64_t warpSeconds = 0;
+	for(int i = 1; i < argc; i++){
+		if (argv[i][0] != '-'){
+			romPath = argv[i];
+			continue;
+		} else if (strcmp(argv[i], "-d") == 0){
+			listRom = true;
+			continue;
+		} else if (strcmp(argv[i], "-u") == 0){
+			stopOnUnimplemented = true;
+			continue;
+		} else if (strcmp(argv[i], "-q") == 0){
+			trace = false;
+			continue;
+		} else if (strcmp(argv[i], "-p") == 0){
+			mode = STEP;
+			continue;
+		} else if (strcmp(argv[i], "-M") == 0){
+			enableMmioProfile();
+			continue;
+		}
+		if (i + 1 == argc){
+			break;
+		}
+		if (strcmp(argv[i], "-R") == 0 || strcmp(argv[i], "-P") == 0){
+			bool record = argv[i][1] == 'R';
+			const char* path = argv[++i];
+			if (!(record ? startInputRecord(path) : startInputReplay(path))){
+				printf("Can't open input journal %s\n", path);
+				return 1;
+			}
+			continue;
+		} else if (strcmp(argv[i], "-l") == 0 || strcmp(argv[i], "-B") == 0){
+			bool binary = argv[i][1] == 'B';
+			if (!openLog(argv[++i], binary)){
+				printf("Can't open log file %s\n", argv[i]);
+				return 1;
+			}
+			continue;
+		} else if (strcmp(argv[i], "-D") == 0){
+			if (!printBinaryLog(argv[++i])){
+				printf("Can't read binary log %s\n", argv[i]);
+				return 1;
+			}
+			return 0;
+		} else if (strcmp(argv[i], "-F") == 0){
+			if (!setLogFilter(argv[++i])){
+				printf("Bad log filter %s\n", argv[i]);
+				return 1;
+			}
+			continue;
+		} else if (strcmp(argv[i], "-C") == 0){
+			enableCoverage(argv[++i]);
+			continue;
+		} else if (strcmp(argv[i], "-X") == 0){
+			translatePath = argv[++i];
+			continue;
+		} else if (strcmp(argv[i], "-L") == 0){
+			lanesPath = argv[++i];
+			continue;
+		} else if (strcmp(argv[i], "-A") == 0){
+			if (!startAudio(argv[++i])){
+				printf("Can't open audio file %s\n", argv[i]);
+				return 1;
+			}
+			continue;
+		}
+		uint64_t count = strtoull(argv[++i], NULL, 0);
+		uint32_t address = count;
+		if (strcmp(argv[i - 1], "-b") == 0){
+			addBreakpoint(address);
+		} else if (strcmp(argv[i - 1], "-r") == 0){
+			addWatchpoint(address, true, false);
+		} else if (strcmp(argv[i - 1], "-w") == 0){
+			addWatchpoint(address, false, true);
+		} else if (strcmp(argv[i - 1], "-g") == 0){
+			gdbPort = address;
+		} else if (strcmp(argv[i - 1], "-e") == 0){
+			entry = address & ADDRESS_MASK;
+		} else if (strcmp(argv[i - 1], "-s") == 0){
+			stopAtPc = address & ADDRESS_MASK;
+		} else if (strcmp(argv[i - 1], "-n") == 0){
+			instructionLimit = count;
+		} else if (strcmp(argv[i - 1], "-c") == 0){
+			cycleLimit = count;
+		} else if (strcmp(argv[i - 1], "-H") == 0){
+			enableRewind(count);
+		} else if (strcmp(argv[i - 1], "-T") == 0){
+			enableHangReport(count);
+		} else if (strcmp(argv[i - 1], "-W") == 0){
+			warpSeconds = count;
+			warp = true;
+		}
+	}
 
-			case 0xF:{ // MOV.B #xx:8, Rd
-				struct RegRef8 Rd = getRegRef8(aL);
+	accel_memory = malloc(29);
 
-				uint8_t value = b;
+	FILE* romFile = fopen(romPath,"rb");
+	if(!romFile){
+		printf("Can't find rom %s\n", romPath);
+		return 1;
+	}
 
-				setFlagsMOV(value, 8);
-				*Rd.ptr = value;
+	fseek (romFile , 0 , SEEK_END);
+	int romSize = ftell (romFile);
+	rewind (romFile);
 
-				printf("%04x - MOV.b 0x%x,R%d%c\n", pc, value, Rd.idx, Rd.loOrHiReg); 
-				printRegistersState();
-			}break;
+	if (romSize > ADDRESS_SPACE - BLOCK_SIZE){ // The top block is the on-chip memory again
+		printf("Rom %s doesn't fit in the address space\n", romPath);
+		fclose(romFile);
+		return 1;
+	}
+	// The first 64KB go to the on-chip memory, the rest to the off-chip blocks they land in. The listing, the
+	// translation and the check that a translation matches the image only cover the on-chip part.
+	int onChipSize = (romSize < BLOCK_SIZE) ? romSize : BLOCK_SIZE;
+	fread(memory,1,onChipSize ,romFile);
+	for(int loaded = onChipSize; loaded < romSize; loaded += BLOCK_SIZE){
+		int count = (romSize - loaded < BLOCK_SIZE) ? romSize - loaded : BLOCK_SIZE;
+		fread(backingMemory(loaded, true), 1, count, romFile);
+	}
+	imageEnd = romSize;
+	addStopBreakpoints();
 
-			default:{
-				printf("???\n");
-			} break;
+	if (listRom){
+		disassembleRom(memory, onChipSize);
+		fclose(romFile);
+		return 0;
+	}
+	if (translatePath){
+		bool written = translateRom(memory, onChipSize, entry, romPath, translatePath);
+		if (!written){
+			printf("Can't write %s\n", translatePath);
 		}
+		fclose(romFile);
+		return written ? 0 : 1;
+	}
 
-		// SSU
-		if ((*SSU.SSER & 0xC0) == 0xC0){ // TE and RE flags. Transmission and recieve enabled
-			if(*SSU.SSTDR != 0){ // When we write data to SSTDR
-				*SSU.SSSR = clearBit8(*SSU.SSSR, 1); // RDRF = 0. Clear Receive Data Register Full.  
-				// Here we'll start the transmission that'll take 8 cycles. But for now it happens instantly.
-				// Accelerometer
-				if(~(getMemory8(0xFFDC)) & 0x1){ // Pin 9 low
-					if(ssuBuffer[0] == 0xFF){
-						ssuBuffer[0] = *SSU.SSTDR & 0x0F; // We'll store the address here. The "&" removes 0x80 (RW flag, not part of the address)
-						ssuBuffer[1] = 0; // And the offset here
-					} else{
-						*SSU.SSRDR = accel_memory[(ssuBuffer[0]) + ssuBuffer[1]]; 
-						ssuBuffer[1] += 1;
-					}					
-				}
-				*SSU.SSTDR = 0;
-				*SSU.SSSR = *SSU.SSSR | (1<<1); // // RDRF = 1. Receive Data Register Full
-				*SSU.SSSR = *SSU.SSSR | (1<<3); // TEND = 1. Transmit Data End. 
+	allocateRegisters();
+	resetMachine(entry);
+	if (trace && !lanesPath){
+		printRegistersState();
+	}
+
+	if (lanesPath){
+		int result = runLanes(lanesPath, entry);
+		fclose(romFile);
+		return result;
+	}
+	startLog();
+	if (logging && logLevels[LOG_CPU] < LOG_TRACE){
+		trace = false; // Nowhere for it to go
+	}
+	if (gdbPort){
+		gdbWaitForConnection(gdbPort);
+	}
+	startConsole();
+	if (warp){
+		inputRtcWarp(warpSeconds);
+	}
+	serviceEvents(); // Inputs journaled before the first instruction, and the first deadline
+	runAheadOfTime(memory, onChipSize);
+	while(!stopReason){
+		if (testBit(breakpoints, pc)){
+			if (pc == stopAtPc || pc == imageEnd){
+				stopReason = (pc == stopAtPc) ? "stop address" : "end of image";
+				break;
 			}
-		}
-		else if (*SSU.SSER & 0x80){ // TE flag. Transmission enabled
-			if(*SSU.SSTDR != 0){ // When we write data to SSTDR
-				*SSU.SSSR = clearBit8(*SSU.SSSR, 2); // TDRE = 0. Transmit Data Empty.  
-				//SSU.SSTRSR = *SSU.SSTDR;
-				// Accelerometer
-				if(~(getMemory8(0xFFDC)) & 0x1){ // Pin 9 low
-					if(ssuBuffer[0] == 0xFF){
-						ssuBuffer[0] = *SSU.SSTDR;
-					} else if (ssuBuffer[1] == 0xFF){
-						ssuBuffer[1] = *SSU.SSTDR;
-						accel_memory[ssuBuffer[0]] = ssuBuffer[1];
-						memset(ssuBuffer, 0xFF, 2);
-					} 	
-				}
-				*SSU.SSTDR = 0;
-				*SSU.SSSR = *SSU.SSSR | (1<<2); // TDRE = 1. Transmit Data Empty. (TODO: optimize away)
-				if (*SSU.SSER & 0b100){
-					// generate TX1. Maybe doesnt happen in the ROM
+			if (mode == GDB_RUN || mode == GDB_STEP){ // The debugger has the CPU, the console doesn't get to stop it
+				if (instructions != gdbResumedAt){ // Not the instruction gdb just let us go from
+					gdbStopped(GDB_SIGTRAP);
 				}
-				// Here we'll start the transmission that'll take 8 cycles. But for now it happens instantly.
-				*SSU.SSSR = *SSU.SSSR | (1<<3); // TEND = 1. Transmit Data End. 
-			}
-		}
-		else if (*SSU.SSER & 0x40){ // RE flag. Recieve enabled. 
-			return 1; //TODO: Check if this mode is used in the ROM
-			if(*SSU.SSRDR != 0){ // When we write data to SSRDR
-				*SSU.SSSR = *SSU.SSSR | (1<<1); // // RDRF = 1. Receive Data Register Full
-				SSU.SSTRSR = *SSU.SSRDR; // Manual says this doesnt happen, SSTRSR isnt used in recieves.
-				*SSU.SSRDR = 0;
-
-				*SSU.SSSR = clearBit8(*SSU.SSSR, 1); // RDRF = 0. Receive Data Register not Full   
-				// Here we'll start the transmission that'll take 8 cycles. But for now it happens instantly.
-				*SSU.SSER = clearBit8(*SSU.SSSR, 6); // RE = 0. 
-				*SSU.SSSR = clearBit8(*SSU.SSSR, 5); // RSSTP = 0. Receive single stop
+			} else if (pauseAtInstruction == UINT64_MAX){ // Not while running forward after a rewind
+				printf("BREAKPOINT - 0x%04x\n", pc);
+				printRegistersState();
+				stopAndWaitForInput();
 			}
 		}
-		
-		if((getMemory8(0xFFDC)) & 0x1){ // Pin 9 high
-			*SSU.SSRDR = 0;
-			memset(ssuBuffer, 0xFF, 2);
+		executeInstruction();
+		if (cycles >= nextEventCycle){
+			serviceEvents();
 		}
-
-		pc+=2;
 		if (mode == RUN){
 			continue;
 		} else if(mode == STEP){
 			if (instructionsToStep == 0){
-				scanf(" %d", &instructionsToStep);
+				waitForConsole();
 			}
 			instructionsToStep--;
+		} else if(mode == GDB_RUN){
+			if (--gdbPollCountdown == 0){
+				gdbPoll();
+			}
+		} else if(mode == GDB_STEP){
+			gdbStopped(GDB_SIGTRAP);
 		}
 	}
+	stopInputRecord();
+	stopAudio();
+	stopLog();
+	printf("STOP - %s at 0x%04x after %llu instructions, %llu states, state hash %016llx\n", stopReason, pc, (unsigned long long)instructions, (unsigned long long)cycles, (unsigned long long)stateHash());
+	if (!trace){
+		printRegistersState();
+	}
+	if (coveredPcs){
+		writeCoverageReport(romPath);
+	}
+	if (profileMmio){
+		printMmioReport();
+	}
+	if (mode == GDB_RUN || mode == GDB_STEP){
+		gdbExited(0);
+	}
 	fclose(romFile);
+	return (strcmp(stopReason, "watchdog expired") == 0) ? 1 : 0; // Batch runs can tell a hang apart
 }
+#endif
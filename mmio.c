@@ -0,0 +1,119 @@
+// I/O register profile, -M. Counts the reads and writes the program makes to each on-chip I/O register (0xF020 -
+// 0xF0FF and 0xFF80 - 0xFFFF) and how many states go by between them, and prints them busiest first when the run stops,
+// so it's clear which device models get polled the hardest and would gain the most from a fast path.
+// The pages with I/O registers on them go through the slow path while it's on (see mmioPages), the rest of memory
+// doesn't pay anything. Reads the device models make themselves go through peekMemory8 and aren't counted.
+
+#define MMIO_BASE 0xF000 // Registers are counted from here to the end of the on-chip memory
+
+struct MmioCounters{
+	uint64_t reads;
+	uint64_t writes;
+	uint64_t lastAccess; // State count
+	uint64_t gapTotal; // States between one access and the next, added up
+	uint64_t shortestGap;
+};
+
+struct MmioName{
+	uint16_t address;
+	const char* name;
+};
+
+static struct MmioCounters mmioCounters[BLOCK_SIZE - MMIO_BASE];
+static bool profileMmio;
+
+static const struct MmioName mmioNames[] = {
+	{RTCFLG, "RTCFLG"}, {RSECDR, "RSECDR"}, {RMINDR, "RMINDR"}, {RHRDR, "RHRDR"}, {RWKDR, "RWKDR"},
+	{RTCCR1, "RTCCR1"}, {RTCCR2, "RTCCR2"},
+	{0xF0E0, "SSCRH"}, {0xF0E1, "SSCRL"}, {0xF0E2, "SSMR"}, {0xF0E3, "SSER"}, {0xF0E4, "SSSR"},
+	{0xF0E9, "SSRDR"}, {0xF0EB, "SSTDR"},
+	{TMRW, "TMRW"}, {TCRW, "TCRW"}, {TCNT, "TCNT"}, {GRA, "GRA"}, {GRA + 2, "GRB"}, {GRA + 4, "GRC"}, {GRA + 6, "GRD"},
+	{TCSRWD1, "TCSRWD1"}, {TCSRWD2, "TCSRWD2"}, {TCWD, "TCWD"}, {TMWD, "TMWD"},
+	{0xFFD4, "PDR1"}, {0xFFD6, "PDR3"}, {0xFFD8, "PDR5"}, {0xFFDB, "PDR8"}, {0xFFDC, "PDR9"}, {0xFFDE, "PDRB"},
+	{0xFFE4, "PCR1"}, {0xFFE6, "PCR3"}, {0xFFE8, "PCR5"}, {0xFFEB, "PCR8"}, {0xFFEC, "PCR9"},
+	{IENR1, "IENR1"}, {IWPR, "IWPR"}
+};
+
+bool isMmioAddress(uint16_t address){
+	return (address >= 0xF020 && address < 0xF100) || address >= 0xFF80;
+}
+
+void setMmioPageBit(uint32_t address, bool onRead, bool onWrite){
+	setBit(mmioPages, address >> PAGE_SHIFT);
+	mapPage(address >> PAGE_SHIFT);
+}
+
+void enableMmioProfile(){
+	profileMmio = true;
+	forEachAlias(0xF000, true, true, setMmioPageBit);
+	forEachAlias(0xF080, true, true, setMmioPageBit);
+	forEachAlias(0xFF80, true, true, setMmioPageBit);
+}
+
+// Called by the slow paths for accesses to the I/O register pages, address is the 16 bit one
+void countMmioAccess(uint16_t address, bool write){
+	if (!isMmioAddress(address)){
+		return;
+	}
+	struct MmioCounters* counters = &mmioCounters[address - MMIO_BASE];
+	if (counters->reads + counters->writes){
+		uint64_t gap = cycles - counters->lastAccess;
+		counters->gapTotal += gap;
+		counters->shortestGap = (gap < counters->shortestGap) ? gap : counters->shortestGap;
+	} else{
+		counters->shortestGap = UINT64_MAX;
+	}
+	counters->lastAccess = cycles;
+	if (write){
+		counters->writes++;
+	} else{
+		counters->reads++;
+	}
+}
+
+const char* mmioName(uint16_t address){
+	for(int i = 0; i < sizeof(mmioNames) / sizeof(mmioNames[0]); i++){
+		if (mmioNames[i].address == address){
+			return mmioNames[i].name;
+		}
+	}
+	return "";
+}
+
+static uint64_t mmioAccesses(int index){
+	return mmioCounters[index].reads + mmioCounters[index].writes;
+}
+
+int compareMmioAccesses(const void* a, const void* b){
+	uint64_t accessesA = mmioAccesses(*(const int*)a);
+	uint64_t accessesB = mmioAccesses(*(const int*)b);
+	return (accessesA < accessesB) - (accessesA > accessesB); // Most first
+}
+
+void printMmioReport(){
+	int order[BLOCK_SIZE - MMIO_BASE];
+	int count = 0;
+	for(int i = 0; i < BLOCK_SIZE - MMIO_BASE; i++){
+		if (mmioAccesses(i)){
+			order[count++] = i;
+		}
+	}
+	qsort(order, count, sizeof(int), compareMmioAccesses);
+	printf("MMIO - %d registers accessed in %llu states, busiest first:\n", count, (unsigned long long)cycles);
+	printf("  address  name      reads       writes      states apart (average, shortest)\n");
+	for(int i = 0; i < count; i++){
+		const struct MmioCounters* counters = &mmioCounters[order[i]];
+		uint64_t accesses = counters->reads + counters->writes;
+		printf("  0x%04x   %-8s  %-10llu  %-10llu  ", MMIO_BASE + order[i], mmioName(MMIO_BASE + order[i]), (unsigned long long)counters->reads, (unsigned long long)counters->writes);
+		if (accesses > 1){
+			printf("%.1f, %llu\n", (double)counters->gapTotal / (accesses - 1), (unsigned long long)counters->shortestGap);
+		} else{
+			printf("-\n");
+		}
+	}
+	// How long the program waits on the serial unit for each byte it sends
+	uint64_t transfers = mmioCounters[0xF0EB - MMIO_BASE].writes;
+	if (transfers){
+		printf("MMIO - SSU, %.1f SSSR reads per SSTDR write\n", (double)mmioCounters[0xF0E4 - MMIO_BASE].reads / transfers);
+	}
+}
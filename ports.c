@@ -0,0 +1,97 @@
+// I/O ports. Each one has a data register (PDR) and a direction register (PCR, a 1 bit makes the pin an output).
+// Reading the data register gives the latched value on output pins and the outside level on input pins. Memory
+// always holds that mix, it's redone whenever the firmware writes either register or something outside moves a pin.
+// Falling edges on port 5 raise the matching wakeup request (WKP0 - WKP7). The walker's three buttons sit on port 5
+// and pull their pin low while pressed.
+
+struct Port{
+	uint16_t data;
+	uint16_t direction; // 0 for input only ports
+	uint8_t latch; // Last value the firmware wrote
+	uint8_t pins; // Level from outside, unconnected pins are pulled high
+};
+
+#define PORT_COUNT 6
+#define WAKEUP_PORT 2 // Port 5
+
+static struct Port ports[PORT_COUNT] = {
+	{0xFFD4, 0xFFE4, 0, 0xFF}, // Port 1
+	{0xFFD6, 0xFFE6, 0, 0xFF}, // Port 3
+	{0xFFD8, 0xFFE8, 0, 0xFF}, // Port 5
+	{0xFFDB, 0xFFEB, 0, 0xFF}, // Port 8
+	{0xFFDC, 0xFFEC, 0, 0xFF}, // Port 9, bit 0 is the accelerometer chip select
+	{0xFFDE, 0, 0, 0xFF}, // Port B
+};
+
+enum Button{
+	BUTTON_ENTER,
+	BUTTON_LEFT,
+	BUTTON_RIGHT,
+	BUTTON_COUNT
+};
+static const uint8_t buttonPins[BUTTON_COUNT] = {0x01, 0x04, 0x10}; // Port 5 bits
+
+// Journaled like any other write, so the rewind buffer gets the registers back along with the rest of memory
+void updatePort(struct Port* port){
+	uint8_t outputs = port->direction ? memory[port->direction] : 0;
+	pokeMemory8(port->data, (port->latch & outputs) | (port->pins & ~outputs));
+}
+
+struct Port* findPort(uint16_t address){
+	for(int i = 0; i < PORT_COUNT; i++){
+		if (ports[i].data == address || (ports[i].direction && ports[i].direction == address)){
+			return &ports[i];
+		}
+	}
+	return NULL;
+}
+
+// Called by deviceWrite, returns false if address isn't a port register
+bool portWrite(uint16_t address, uint8_t value){
+	struct Port* port = findPort(address);
+	if (!port){
+		return false;
+	}
+	if (address == port->data){
+		port->latch = value;
+	}
+	updatePort(port);
+	return true;
+}
+
+// Something outside drives the pins of the port whose data register is at address. Anything else there is plain memory.
+void setPortPins(uint16_t address, uint8_t pins){
+	struct Port* port = findPort(address);
+	if (!port || address != port->data){
+		pokeMemory8(address, pins);
+		return;
+	}
+	uint8_t falling = port->pins & ~pins;
+	port->pins = pins;
+	updatePort(port);
+	if (port == &ports[WAKEUP_PORT] && falling){
+		pokeMemory8(IWPR, memory[IWPR] | falling);
+		checkInterrupts();
+	}
+}
+
+void setButton(uint8_t button, bool pressed){
+	if (button >= BUTTON_COUNT){
+		return;
+	}
+	struct Port* port = &ports[WAKEUP_PORT];
+	setPortPins(port->data, pressed ? (port->pins & ~buttonPins[button]) : (port->pins | buttonPins[button]));
+}
+
+// Hooks up the registers and puts the pins at their reset levels
+void initPorts(){
+	for(int i = 0; i < PORT_COUNT; i++){
+		addDeviceRegisters(ports[i].data, 1);
+		if (ports[i].direction){
+			addDeviceRegisters(ports[i].direction, 1);
+		}
+		updatePort(&ports[i]);
+	}
+	addDeviceRegisters(IENR1, 1);
+	addDeviceRegisters(IWPR, 1);
+}
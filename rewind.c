@@ -0,0 +1,233 @@
+// Rewind buffer, -H count turns it on with a checkpoint every count instructions.
+// The oldest checkpoint has a full copy of memory, the later ones only keep CPU and device state and their position in
+// a journal of memory writes. Going back restores the nearest checkpoint before the target (base copy plus the journal
+// up to it) and runs forward from there. Entering a negative number while stepping goes back that many instructions.
+// While it's on every write page is left unmapped so writes take the slow path, where they get journaled.
+// Check for a full journal: roms/rewindfull.bin idles through a few checkpoints with no writes, then writes a byte ring
+// (summing what it overwrites in R3L) until the journal wraps. Step 16000000, rewind -11000000, then c:
+//   poke -q -p -H 1000000 roms/rewindfull.bin
+// must stop with the same state hash as running it straight through, 84647e6ac5c67503.
+#define REWIND_CHECKPOINTS 64
+#define REWIND_JOURNAL_SIZE (1 << 20) // In writes, 4 bytes each
+
+struct Checkpoint{
+	uint32_t registers[8];
+	uint8_t ccr;
+	int pc;
+	uint64_t cycles;
+	uint64_t instructions;
+	uint8_t accel[29];
+	uint8_t ssuBuffer[2];
+	uint8_t ssuRegisters[12]; // 0xF0E0 - 0xF0EB, the SSU writes these through its own pointers, not through the journal
+	uint8_t ssuShift;
+	struct Port ports[PORT_COUNT]; // Latches and pin levels, the registers themselves are journaled
+	bool sleeping;
+	struct Rtc rtc;
+	struct Watchdog watchdog;
+	uint64_t journalPosition;
+	size_t inputHistoryPosition;
+	long replayPosition;
+	uint64_t nextReplayCycle;
+};
+
+static struct Checkpoint checkpoints[REWIND_CHECKPOINTS];
+static int checkpointCount;
+static uint64_t checkpointInterval;
+static uint64_t nextCheckpointInstruction = UINT64_MAX;
+static uint8_t* baseBlocks[ADDRESS_SPACE >> BLOCK_SHIFT]; // Memory as of checkpoints[0]
+
+static uint32_t* journal; // Address in the low 24 bits, value in the top 8. Entry n lives at n % REWIND_JOURNAL_SIZE
+static uint64_t journalStart; // checkpoints[0].journalPosition
+static uint64_t journalEnd;
+static bool journalOverflowed; // Too many writes since the only checkpoint, history starts over at the next instruction
+
+static uint64_t pauseAtInstruction = UINT64_MAX; // Where running forward after a rewind stops
+static bool pausedTrace;
+
+// The on-chip memory is mapped twice but only journaled and copied once, as block 0
+int uniqueBlock(uint32_t address){
+	int block = address >> BLOCK_SHIFT;
+	return (blocks[block] == memory) ? 0 : block;
+}
+
+void applyJournal(uint8_t** target, uint64_t from, uint64_t to){
+	for(uint64_t i = from; i < to; i++){
+		uint32_t entry = journal[i % REWIND_JOURNAL_SIZE];
+		int block = uniqueBlock(entry & ADDRESS_MASK);
+		if (!target[block]){
+			target[block] = calloc(BLOCK_SIZE, 1);
+		}
+		target[block][entry & (BLOCK_SIZE - 1)] = entry >> 24;
+	}
+}
+
+// Folds the oldest checkpoint into the base copy of memory, the next one becomes the oldest
+void dropOldestCheckpoint(){
+	applyJournal(baseBlocks, checkpoints[0].journalPosition, checkpoints[1].journalPosition);
+	journalStart = checkpoints[1].journalPosition;
+
+	size_t droppedInputs = checkpoints[1].inputHistoryPosition;
+	memmove(inputHistory, inputHistory + droppedInputs, (inputHistoryCount - droppedInputs) * sizeof(struct InputEvent));
+	inputHistoryCount -= droppedInputs;
+	inputHistoryCursor -= droppedInputs;
+
+	checkpointCount--;
+	memmove(checkpoints, checkpoints + 1, checkpointCount * sizeof(struct Checkpoint));
+	for(int i = 0; i < checkpointCount; i++){
+		checkpoints[i].inputHistoryPosition -= droppedInputs;
+	}
+}
+
+void journalWrite(uint32_t address, uint8_t value){
+	if (journalOverflowed){
+		return;
+	}
+	while(journalEnd - journalStart >= REWIND_JOURNAL_SIZE){ // Checkpoints with no writes between them free nothing
+		if (checkpointCount < 2){
+			journalOverflowed = true;
+			nextEventCycle = 0; // Start over as soon as this instruction is done
+			return;
+		}
+		dropOldestCheckpoint();
+	}
+	journal[journalEnd++ % REWIND_JOURNAL_SIZE] = address | ((uint32_t)value << 24);
+}
+
+void takeCheckpoint(){
+	if (checkpointCount == REWIND_CHECKPOINTS){
+		dropOldestCheckpoint();
+	}
+	if (checkpointCount == 0){
+		for(int i = 0; i < (ADDRESS_SPACE >> BLOCK_SHIFT); i++){
+			if (blocks[i] && uniqueBlock(i << BLOCK_SHIFT) == i){
+				if (!baseBlocks[i]){
+					baseBlocks[i] = malloc(BLOCK_SIZE);
+				}
+				memcpy(baseBlocks[i], blocks[i], BLOCK_SIZE);
+			}
+		}
+		journalStart = journalEnd;
+	}
+	struct Checkpoint* checkpoint = &checkpoints[checkpointCount++];
+	for(int i = 0; i < 8; i++){
+		checkpoint->registers[i] = *ER[i];
+	}
+	checkpoint->ccr = getCCR();
+	checkpoint->pc = pc;
+	checkpoint->cycles = cycles;
+	checkpoint->instructions = instructions;
+	memcpy(checkpoint->accel, accel_memory, 29);
+	memcpy(checkpoint->ssuBuffer, ssuBuffer, 2);
+	memcpy(checkpoint->ssuRegisters, memory + 0xF0E0, 12);
+	checkpoint->ssuShift = SSU.SSTRSR;
+	memcpy(checkpoint->ports, ports, sizeof(ports));
+	checkpoint->sleeping = sleeping;
+	checkpoint->rtc = rtc;
+	checkpoint->watchdog = watchdog;
+	checkpoint->journalPosition = journalEnd;
+	checkpoint->inputHistoryPosition = inputHistoryCursor;
+	checkpoint->replayPosition = replayPosition;
+	checkpoint->nextReplayCycle = nextReplayCycle;
+	nextCheckpointInstruction = instructions + checkpointInterval;
+}
+
+void restoreCheckpoint(int index){
+	struct Checkpoint* checkpoint = &checkpoints[index];
+	for(int i = 0; i < (ADDRESS_SPACE >> BLOCK_SHIFT); i++){
+		if (blocks[i] && uniqueBlock(i << BLOCK_SHIFT) == i){
+			if (baseBlocks[i]){
+				memcpy(blocks[i], baseBlocks[i], BLOCK_SIZE);
+			} else{
+				memset(blocks[i], 0, BLOCK_SIZE); // Nothing had been written there yet
+			}
+		}
+	}
+	applyJournal(blocks, journalStart, checkpoint->journalPosition);
+	journalEnd = checkpoint->journalPosition;
+
+	for(int i = 0; i < 8; i++){
+		*ER[i] = checkpoint->registers[i];
+	}
+	setCCR(checkpoint->ccr);
+	pc = checkpoint->pc;
+	cycles = checkpoint->cycles;
+	instructions = checkpoint->instructions;
+	memcpy(accel_memory, checkpoint->accel, 29);
+	memcpy(ssuBuffer, checkpoint->ssuBuffer, 2);
+	memcpy(memory + 0xF0E0, checkpoint->ssuRegisters, 12);
+	SSU.SSTRSR = checkpoint->ssuShift;
+	memcpy(ports, checkpoint->ports, sizeof(ports));
+	sleeping = checkpoint->sleeping;
+	rtc = checkpoint->rtc;
+	watchdog = checkpoint->watchdog;
+	inputHistoryCursor = checkpoint->inputHistoryPosition;
+	replayPosition = checkpoint->replayPosition;
+	nextReplayCycle = checkpoint->nextReplayCycle;
+
+	checkpointCount = index + 1;
+	nextCheckpointInstruction = instructions + checkpointInterval;
+	nextEventCycle = 0; // The deadlines were for the future we just left, get them rescheduled after this instruction
+}
+
+void enableRewind(uint64_t interval){
+	checkpointInterval = interval ? interval : 1;
+	nextCheckpointInstruction = 0;
+	journal = malloc(REWIND_JOURNAL_SIZE * sizeof(uint32_t));
+	journalWrites = true;
+	keepInputHistory = true;
+	for(int i = 0; i < (ADDRESS_SPACE >> BLOCK_SHIFT); i++){
+		if (blocks[i]){
+			mapBlock(i, blocks[i]);
+		}
+	}
+}
+
+// Goes back count instructions, or as far as the oldest checkpoint allows.
+// Returns true if it has to run forward from the checkpoint to get there, that ends in serviceRewind.
+bool rewindBy(uint64_t count){
+	if (!checkpointCount){
+		printf("REWIND - not enabled, use -H\n");
+		return false;
+	}
+	uint64_t target = (count > instructions) ? 0 : instructions - count;
+	int index = checkpointCount - 1;
+	while(index > 0 && checkpoints[index].instructions > target){
+		index--;
+	}
+	if (checkpoints[index].instructions > target){
+		target = checkpoints[index].instructions;
+	}
+	restoreCheckpoint(index);
+	if (instructions == target){
+		printf("REWIND - instruction %llu\n", (unsigned long long)instructions);
+		printRegistersState();
+		return false;
+	}
+	pauseAtInstruction = target;
+	pausedTrace = trace;
+	trace = false;
+	mode = RUN;
+	return true;
+}
+
+// Called from serviceEvents
+void serviceRewind(){
+	if (journalOverflowed){
+		journalOverflowed = false;
+		checkpointCount = 0;
+		inputHistoryCount = inputHistoryCursor = 0;
+		takeCheckpoint();
+	}
+	if (instructions >= pauseAtInstruction){
+		pauseAtInstruction = UINT64_MAX;
+		trace = pausedTrace;
+		inputHistoryCount = inputHistoryCursor; // What came after this point didn't happen anymore
+		mode = STEP;
+		instructionsToStep = 0;
+		printf("REWIND - instruction %llu\n", (unsigned long long)instructions);
+		printRegistersState();
+	}
+	if (instructions >= nextCheckpointInstruction){
+		takeCheckpoint();
+	}
+}
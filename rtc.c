@@ -0,0 +1,150 @@
+// Real time clock. It counts in quarter seconds off the state clock: every tick is an event on the scheduler, so it
+// costs nothing between ticks and a SLEEP waiting on it skips straight there. The counters are kept here and copied to
+// the BCD registers on every change, a write to the registers (the firmware setting the clock) reads them back.
+// Every tick raises the periodic flags in RTCFLG, the interrupt is taken for any flag that's also enabled in RTCCR2.
+// Time warps move the counters forward in bulk without running anything, raising the flags for every boundary they
+// cross once, like a long stop that got the flags coalesced. They're inputs, so they get journaled and replayed.
+// 24 hour mode only, the 12 hour bit in RTCCR1 is ignored.
+// Timing check: roms/rtcweek.bin starts the clock, sleeps, and counts midnights in R1L from the day interrupt.
+//   poke -q -c 2229538406400 roms/rtcweek.bin    (a week and a second of states)
+// ends with ER1 = 7 after 49 instructions in a fraction of a second, stdin open or not.
+
+// RTCFLG and RTCCR2 are in interrupts.c
+#define RSECDR 0xF068
+#define RMINDR 0xF069
+#define RHRDR 0xF06A
+#define RWKDR 0xF06B // Day of the week, 0 - 6
+#define RTCCR1 0xF06C // RUN in bit 7, RST in bit 4
+#define RTC_REGISTERS 7
+#define RTC_TICK_STATES (STATES_PER_SECOND / 4)
+
+// RTCFLG bits
+#define RTC_QUARTER 0x01
+#define RTC_HALF 0x02
+#define RTC_SECOND 0x04
+#define RTC_MINUTE 0x08
+#define RTC_HOUR 0x10
+#define RTC_DAY 0x20
+#define RTC_WEEK 0x40
+
+struct Rtc{
+	bool running;
+	uint8_t quarter;
+	uint8_t seconds;
+	uint8_t minutes;
+	uint8_t hours;
+	uint8_t weekday;
+	uint64_t nextTick;
+};
+static struct Rtc rtc = {.nextTick = UINT64_MAX};
+
+uint8_t toBcd(uint8_t value){
+	return ((value / 10) << 4) | (value % 10);
+}
+
+uint8_t fromBcd(uint8_t value){
+	return (value >> 4) * 10 + (value & 0xF);
+}
+
+void publishRtc(uint8_t raised){
+	pokeMemory8(RSECDR, toBcd(rtc.seconds));
+	pokeMemory8(RMINDR, toBcd(rtc.minutes));
+	pokeMemory8(RHRDR, toBcd(rtc.hours));
+	pokeMemory8(RWKDR, rtc.weekday);
+	if (raised){
+		pokeMemory8(RTCFLG, memory[RTCFLG] | raised);
+		checkInterrupts();
+	}
+}
+
+// Returns the RTCFLG bits for the boundaries crossed
+uint8_t advanceRtc(uint64_t seconds){
+	if (!seconds){
+		return 0;
+	}
+	uint8_t crossed = RTC_SECOND;
+	uint64_t carry = rtc.seconds + seconds;
+	rtc.seconds = carry % 60;
+	carry /= 60;
+	crossed |= carry ? RTC_MINUTE : 0;
+	carry += rtc.minutes;
+	rtc.minutes = carry % 60;
+	carry /= 60;
+	crossed |= carry ? RTC_HOUR : 0;
+	carry += rtc.hours;
+	rtc.hours = carry % 24;
+	carry /= 24;
+	crossed |= carry ? RTC_DAY : 0;
+	carry += rtc.weekday;
+	rtc.weekday = carry % 7;
+	crossed |= (carry / 7) ? RTC_WEEK : 0;
+	return crossed;
+}
+
+// unit is what an INPUT_RTC_WARP index means: seconds, minutes, hours or days to skip, or RTC_WARP_MIDNIGHT
+enum RtcWarp{
+	RTC_WARP_SECONDS,
+	RTC_WARP_MINUTES,
+	RTC_WARP_HOURS,
+	RTC_WARP_DAYS,
+	RTC_WARP_MIDNIGHT
+};
+
+void warpRtc(uint8_t unit, uint8_t count){
+	static const uint32_t unitSeconds[] = {1, 60, 3600, 86400};
+	uint64_t seconds;
+	if (unit == RTC_WARP_MIDNIGHT){
+		seconds = 86400 - (rtc.hours * 3600 + rtc.minutes * 60 + rtc.seconds);
+		rtc.quarter = 0;
+	} else if (unit < RTC_WARP_MIDNIGHT){
+		seconds = (uint64_t)count * unitSeconds[unit];
+	} else{
+		return;
+	}
+	publishRtc(advanceRtc(seconds));
+}
+
+// Called from serviceEvents
+void serviceRtc(){
+	while(rtc.nextTick <= cycles){
+		uint8_t raised = RTC_QUARTER;
+		rtc.quarter = (rtc.quarter + 1) & 0x3;
+		raised |= (rtc.quarter & 0x1) ? 0 : RTC_HALF;
+		raised |= rtc.quarter ? 0 : advanceRtc(1);
+		publishRtc(raised);
+		rtc.nextTick += RTC_TICK_STATES;
+	}
+}
+
+// Called on any write to the RTC registers
+void rtcWrite(uint16_t address, uint8_t value){
+	switch(address){
+		case RTCFLG:
+		case RTCCR2:{
+			checkInterrupts();
+		}break;
+		case RTCCR1:{
+			if (value & 0x10){ // Reset
+				rtc = (struct Rtc){.nextTick = UINT64_MAX};
+				publishRtc(0);
+				pokeMemory8(RTCCR1, value & ~0x10);
+			}
+			bool running = value & 0x80;
+			if (running != rtc.running){
+				rtc.running = running;
+				rtc.nextTick = running ? cycles + RTC_TICK_STATES : UINT64_MAX;
+				scheduleAtCycle(rtc.nextTick);
+			}
+		}break;
+		default:{
+			rtc.seconds = fromBcd(memory[RSECDR]) % 60;
+			rtc.minutes = fromBcd(memory[RMINDR]) % 60;
+			rtc.hours = fromBcd(memory[RHRDR]) % 24;
+			rtc.weekday = memory[RWKDR] % 7;
+		}break;
+	}
+}
+
+void initRtc(){
+	addDeviceRegisters(RTCFLG, RTC_REGISTERS);
+}
@@ -0,0 +1,69 @@
+// Watchdog timer. TCWD counts up at the rate TMWD selects and resets the chip when it overflows, the firmware keeps
+// it from getting there by writing TCWD every so often. The counter isn't stepped: a write works out the state the
+// overflow lands on and that's an event on the scheduler, so a running watchdog costs nothing between writes.
+// Reads of TCWD give the last value written, not the live count.
+// The reset only covers the CPU (vector 0, interrupts masked) and the watchdog itself, WRST tells the firmware why.
+// With -T count the expiry stops the run instead and prints a hang report (see hang.c).
+
+#define TCSRWD1 0xFFB0 // Control: WDON in bit 2, WRST in bit 0, each bit only written if the bit above it is written 0
+#define TCSRWD2 0xFFB1
+#define TCWD 0xFFB2
+#define TMWD 0xFFB3 // Clock select in bits 3 - 0: 8 - F for the system clock / 64 to / 8192, the rest the internal oscillator
+#define WATCHDOG_REGISTERS 4
+#define WATCHDOG_OSCILLATOR_STATES (STATES_PER_SECOND / 10000) // One count of the 10kHz internal oscillator
+
+struct Watchdog{
+	uint8_t control; // TCSRWD1
+	uint64_t expiry;
+};
+static struct Watchdog watchdog = {.expiry = UINT64_MAX};
+static bool stopOnWatchdog; // -T, report and stop instead of resetting
+
+uint32_t watchdogCountStates(){
+	uint8_t select = memory[TMWD] & 0xF;
+	return (select & 0x8) ? (64 << (select & 0x7)) : WATCHDOG_OSCILLATOR_STATES;
+}
+
+void restartWatchdog(){
+	bool enabled = watchdog.control & 0x04;
+	watchdog.expiry = enabled ? cycles + (uint64_t)(256 - memory[TCWD]) * watchdogCountStates() : UINT64_MAX;
+	scheduleAtCycle(watchdog.expiry);
+}
+
+// Called on any write to the watchdog registers
+void watchdogWrite(uint16_t address, uint8_t value){
+	if (address == TCSRWD1){
+		for(int bit = 0; bit < 8; bit += 2){
+			if (!(value & (2 << bit))){ // Write inhibit bit clear, this one takes the new value
+				watchdog.control = (watchdog.control & ~(1 << bit)) | (value & (1 << bit));
+			}
+		}
+		pokeMemory8(TCSRWD1, watchdog.control | 0xAA); // Write inhibit bits read as 1
+	}
+	restartWatchdog();
+}
+
+// Called from serviceEvents
+void serviceWatchdog(){
+	if (watchdog.expiry > cycles){
+		return;
+	}
+	if (stopOnWatchdog){
+		watchdog.expiry = UINT64_MAX;
+		stopReason = "watchdog expired";
+		printHangReport();
+		return;
+	}
+	printf("WATCHDOG - reset at 0x%04x after %llu instructions\n", pc, (unsigned long long)instructions);
+	watchdog = (struct Watchdog){0x01, UINT64_MAX}; // WRST
+	pokeMemory8(TCSRWD1, watchdog.control | 0xAA);
+	pokeMemory8(TCWD, 0);
+	setCCR(0x80);
+	sleeping = false;
+	pc = getMemory16(0);
+}
+
+void initWatchdog(){
+	addDeviceRegisters(TCSRWD1, WATCHDOG_REGISTERS);
+	pokeMemory8(TCSRWD1, 0xAA);
+}